@@ -17,12 +17,74 @@ __Startup__ proc ()
         call	SndPlaySystemSound(#sndError)
         moveq   #-1,d0
         bra.s   .2f
-.1	movea.l pappi(a6),a0
+.1
+	if	__Segments__>1
+	movea.l	pappi(a6),a0
+	move.w	SysAppInfoType.launchFlags(a0),d0
+	andi.w	#sysAppLaunchFlagNewGlobals,d0
+	beq.s	.3f
+	call	__LoadSegments__()
+.3
+	endif
+	movea.l pappi(a6),a0
         call	PilotMain(SysAppInfoType.cmd(a0), SysAppInfoType.cmdPBP(a0), SysAppInfoType.launchFlags(a0))
+	if	__Segments__>1
+	movea.l	pappi(a6),a0
+	move.w	SysAppInfoType.launchFlags(a0),d0
+	andi.w	#sysAppLaunchFlagNewGlobals,d0
+	beq.s	.4f
+	call	__UnloadSegments__()
+.4
+	endif
         call	SysAppExit(pappi(a6), prevGlobals(a6), globalsPtr(a6))
         moveq   #0,d0
 .2	endproc
 
+	if	__Segments__>1
+; With more than one code segment (see the segment directive) the code
+; resources 1..__Segments__ stay locked while the application runs (code
+; #1 is locked anyway, but calls from other segments go to it, too). Each
+; jump table entry below a5 starts out as "dc.w segment, dc.l offset,
+; dc.w 0" and is turned into "jmp address" here. Only launches with
+; globals have a jump table.
+
+__LoadSegments__ proc ()
+	beginproc
+	movem.l	d3-d4/a2,-(a7)
+	moveq	#1,d3			; segment
+.1	call	DmGetResource(#'code', d3)
+	call	MemHandleLock(a0)
+	move.l	a0,d4			; where the segment starts
+	movea.l	a5,a2
+	suba.w	#8*__JumpTableEntries__,a2
+.2	cmp.w	(a2),d3			; entry for this segment?
+	bne.s	.3f
+	move.w	#$4EF9,(a2)		; jmp xxx.l
+	add.l	d4,2(a2)
+.3	addq.l	#8,a2
+	cmpa.l	a5,a2
+	bcs.s	.2b
+	addq.w	#1,d3
+	cmpi.w	#__Segments__,d3
+	bls.s	.1b
+	movem.l	(a7)+,d3-d4/a2
+	endproc
+
+__UnloadSegments__ proc ()
+	beginproc
+	movem.l	d3/a2,-(a7)
+	moveq	#1,d3			; segment
+.1	call	DmGetResource(#'code', d3)
+	movea.l	a0,a2
+	call	MemHandleUnlock(a2)
+	call	DmReleaseResource(a2)
+	addq.w	#1,d3
+	cmpi.w	#__Segments__,d3
+	bls.s	.1b
+	movem.l	(a7)+,d3/a2
+	endproc
+	endif
+
         data
         ds.l    8 ; Palm OS uses the first 32 bytes of (a5) for itself
         code
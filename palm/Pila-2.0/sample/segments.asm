@@ -0,0 +1,67 @@
+; Segments.asm
+;
+; A minimal application whose code is split into three code resources with
+; the segment directive. PilotMain in code #1 calls Chime in code #2, which
+; calls Beep in code #3. Both calls go through the jump table below A5 that
+; the startup code fills in when the application is launched with globals.
+;
+; The file ends inside the last segment on purpose: no "end" or other
+; block is needed after it.
+;
+; Formatted for 8-space tabs. Assemble with "pila segments.asm".
+;
+
+        Appl    "Segments", 'sEgm'
+
+        include "PalmOS.inc"
+
+        include "startup.asm"
+
+        code
+
+; ---------------------------------------------------------------------------
+; UInt32 PilotMain(UInt16 cmd, void *cmdPBP, UInt16 launchflags)
+
+PilotMain proc (cmd.UInt16, cmdPBP.void*, launchFlags.UInt16).UInt32
+        beginproc
+        tst.w   cmd(a6)                 ;sysAppLaunchCmdNormalLaunch is 0
+        bne.s   PmReturn                ;only that one has the jump table
+
+        call    Chime(#2)
+
+PmReturn
+        moveq   #0,d0
+        endproc
+
+; ---------------------------------------------------------------------------
+; Code #2
+
+        segment
+
+; void Chime(UInt16 times)
+
+Chime   proc (times.UInt16)
+        beginproc
+        move.w  d3,-(a7)
+        move.w  times(a6),d3
+        bra.s   ChDone
+
+ChLoop
+        call    Beep()
+
+ChDone
+        dbra    d3,ChLoop
+        move.w  (a7)+,d3
+        endproc
+
+; ---------------------------------------------------------------------------
+; Code #3
+
+        segment
+
+; void Beep()
+
+Beep    proc ()
+        beginproc
+        call    SndPlaySystemSound(#sndInfo)
+        endproc
@@ -19,6 +19,7 @@
 #define __ASM_H__
 
 #include "symbol.h"
+#include "srccache.h"
 
 /* global flags */
 #define CASE_SENSITIVE
@@ -65,6 +66,20 @@ typedef struct _instruction
                                   /* Routine to be called if parseFlag is FALSE */
 } instruction;
 
+/* Structure to remember the pass independent part of parsing a source line.
+   It is filled in the first time assemble() gets to the instruction of
+   a line read from a file and reused on the following passes. */
+
+typedef struct _LineInfo
+{
+    instruction *inst;      /* Instruction found (NULL = not parsed yet) */
+    int labelStart;         /* Offset of the label in the line */
+    int labelLen;           /* Length of the label (0 = no label) */
+    int opStart;            /* Offset of the text following the mnemonic */
+    char size;              /* Size code following the mnemonic */
+    struct _ExprCache *exprs; /* Constant expressions of the line (see eval.c) */
+} LineInfo;
+
 
 /* Addressing mode codes/bitmasks */
 
@@ -99,6 +114,7 @@ typedef struct _instruction
 
 #define NORMAL       0
 #define CONTINUATION 1
+#define FAILURE      2
 
 //
 
@@ -110,31 +126,36 @@ typedef int BlockType;  // bt
 
 // Global variables
 
-extern BlockType gbt;       // type of block (code, data, etc) being assembled
-extern long gulCodeLoc;     // output location for next code byte
-extern long gulDataLoc;     // output location for next data byte
-extern long gulResLoc;      // output location for next resource byte
-extern long gcbResTotal;    // total size of all resources
-
-#define kcbCodeMax      (0x10000)
-#define kcbDataMax      (0x10000)
-#define kcbResMax       (0x40000)
-
-extern unsigned char *gpbCode;
-extern unsigned char *gpbData;
-extern unsigned char *gpbResource;
-extern unsigned char *gpbOutput;
-
-extern unsigned long gfcResType;
-extern long gidRes;
+extern PILA_STATE BlockType gbt;       // type of block (code, data, etc) being assembled
+extern PILA_STATE long gulCodeLoc;     // output location for next code byte
+extern PILA_STATE long gulCodeBase;    // location of the current code segment (see segment.h)
+extern PILA_STATE long gulDataLoc;     // output location for next data byte
+extern PILA_STATE long gulResLoc;      // output location for next resource byte
+extern PILA_STATE long gcbResTotal;    // total size of all resources
+
+// The code, data and resource buffers grow as they are written (see
+// OutputReserve). PalmOS keeps every resource in a memory chunk, which
+// holds less than 64K, and nothing bigger than the 68000's 16M address
+// space can be used at all.
+#define kcbOutputChunk  (0x1000)        // initial size of each buffer
+#define kcbChunkMax     (0x10000)       // warned about beyond this
+#define kcbBlockMax     (0x1000000)     // refused beyond this
+
+extern PILA_STATE unsigned char *gpbCode;
+extern PILA_STATE unsigned char *gpbData;
+extern PILA_STATE unsigned char *gpbResource;
+extern PILA_STATE unsigned char *gpbOutput;
+
+extern PILA_STATE unsigned long gfcResType;
+extern PILA_STATE long gidRes;
 
 struct SourceStackEntry {
     int iLineNum;
     char szFile[_MAX_PATH];
-    FILE *pfil;
+    SourceFile *psrc;
 };
 
-extern struct SourceStackEntry *gpsseCur;
+extern PILA_STATE struct SourceStackEntry *gpsseCur;
 
 /* function prototype definitions */
 #include "proto.h"
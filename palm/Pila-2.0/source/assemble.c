@@ -27,6 +27,11 @@
  *      found. If parseFlag is FALSE, it passes pointers to the
  *      label and operands to the specified routine for
  *      processing.
+ *      Label and instruction of a line read from a source
+ *      file are remembered in the file's LineInfo array on
+ *      the first pass, so the following passes only have to
+ *      parse and evaluate the operands again (and not even that
+ *      for constant expressions, see eval.c).
  *
  *   Usage: processFile()
  *
@@ -56,40 +61,48 @@
 #include "libiberty.h"
 #include "safe-ctype.h"
 #include "insttabl.h"
+#include "options.h"
+#include "segment.h"
+#include "procgraph.h"
 
-extern long gulOutLoc;      /* The assembler's location counter */
-extern int giPass;          /* Flag set during second pass */
-extern boolean endFlag;     /* Flag set when the END directive is encountered */
-extern char gszAppName[];   /* application name set by APPL directive */
+extern PILA_STATE long gulOutLoc;      /* The assembler's location counter */
+extern PILA_STATE int giPass;          /* Flag set during second pass */
+extern PILA_STATE int giPassRun;       /* Number of passes run so far */
+extern PILA_STATE boolean endFlag;     /* Flag set when the END directive is encountered */
+extern PILA_STATE char gszAppName[];   /* application name set by APPL directive */
+
+#define kMaxRelaxRuns 8      /* Runs of pass 1 before all branches are made long */
+PILA_STATE int giRelaxRuns;            /* Number of times pass 1 was run */
+PILA_STATE boolean gfRelaxLong;        /* Branches without size are made long */
 
 int processFile(char *szFile)
 {
-    FILE *pfilInput;
+    SourceFile *psrcInput;
 	char *line;
+	boolean fDropped;
 
-    // Allocate temporary buffers used for code, data, and resources.
-    gpbCode = (unsigned char *)xmalloc(kcbCodeMax);
-    gpbData = (unsigned char *)xmalloc(kcbDataMax);
-    gpbResource = (unsigned char *)xmalloc(kcbResMax);
-
-    if (gpbCode == NULL || gpbData == NULL || gpbResource == NULL)
+    giRelaxRuns = 0;
+    gfRelaxLong = false;
+    for (giPass = 0, giPassRun = 0; giPass<=2; giPass++, giPassRun++)
 	{
-        printf("Failed to allocate necessary assembly buffers!\n");
-        exit(0);
-    }
+		// Allocate temporary buffers used for code, data, and resources.
+		// Each pass starts out with empty ones, so whatever a pass skips
+		// (align, ds) is zero.
+		OutputInitialize();
 
-    for (giPass = 0; giPass<=2; giPass++)
-	{
 		gulOutLoc = gulCodeLoc = gulDataLoc = gulResLoc = 0;
+		SymbolResetChangeCount();
+		SegmentStartPass();
+		ProcGraphStartPass();
 
 		gbt = kbtCode;      // block is code unless otherwise specified
 		gpbOutput = gpbCode;
 
-		pfilInput = PushSourceFile(szFile);
-		if (pfilInput == NULL || pfilInput == (FILE *)-1)
+		psrcInput = PushSourceFile(szFile);
+		if (psrcInput == NULL)
 		{
-			fputs("Input file not found\n", stdout);
-			exit(0);
+			fputs("Input file not found\n", gpfilMsg);
+			return FAILURE;
 		}
 		
 		endFlag = false;
@@ -105,21 +118,66 @@ int processFile(char *szFile)
 			while (!endFlag && (line=ExpandGetLine())!=NULL)
 			{
                 ErrorStatusReset();
+                ErrorStartLine(ExpandGetLineNum()==0 ? line : NULL);
                 ListPutLocation(gulOutLoc);
-				ListPutSourceLine(line,gpsseCur->iLineNum);
+				ListPutSourceLine(line,ExpandGetLineNum()==0 ? gpsseCur->iLineNum : 0);
                 assemble(line);
+                ErrorEndLine();
 				ListWriteLine();
 			}
 		} while (PopSourceFile());
 
-        if (gszAppName[0]=='\0')
+		// Without an "end" the last block is still open. Close it, so
+		// gulCodeLoc (and gulDataLoc) take in what it holds.
+		EndBlock();
+
+        if (gszAppName[0]=='\0' && !OPTION(precompile) && !OPTION(object))
 			Error(MISSING_APPL,NULL);
+
+		// Pass 1 is repeated as long as labels keep moving. Branches only
+		// ever grow from short to long on each run (see branch()), so this
+		// usually settles quickly. Should it take more than kMaxRelaxRuns
+		// runs, every branch without a size is made long, after which no
+		// branch changes any more. Pass 2 then finds the same addresses
+		// again. Pass 1 is also repeated once what nothing uses is known,
+		// so it can be left out (see procgraph.h).
+		fDropped = ProcGraphEndPass();
+		if (giPass==1)
+		{
+			giRelaxRuns++;
+			if (SymbolGetChangeCount()>0 || fDropped)
+			{
+				if (giRelaxRuns>=kMaxRelaxRuns)
+					gfRelaxLong = true;
+				if (giRelaxRuns<2*kMaxRelaxRuns)
+					giPass--;
+			}
+		}
     }
 
+	// code #1 goes into gpbCode again
+	SegmentFinish();
+
     return NORMAL;
 }
 
 
+/* Returns the LineInfo of the current source line or NULL if the line
+   did not come from a source file but from ExpandGetLine()'s queue. */
+static LineInfo *LineInfoLookup()
+{
+    SourceFile *file = gpsseCur->psrc;
+
+    if (ExpandGetLineNum()!=0)
+        return NULL;
+
+    if (file->lineInfo==NULL)
+        file->lineInfo = xcalloc(file->lineCount, sizeof(LineInfo));
+
+    return &file->lineInfo[gpsseCur->iLineNum-1];
+}
+
+
 int assemble(char *line)
 {
     instruction *tablePtr;
@@ -128,67 +186,97 @@ int assemble(char *line)
     char *p, *start, label[SIGCHARS+1], size, f;
     boolean sourceParsed, destParsed;
     unsigned short mask;
+    LineInfo *lineInfo;
 
     p = start = skipSpace(line);
+    EvalSetLine(NULL, line);
 
     // Comments start with '*' or ';'
     if (*p && *p!='*' &&  *p!=';')
     {
       if (!DirectiveContinuation(p))
       {
-        label[0] = '\0';
-        
-        if (*p=='.') // could be a temporary label!
+        lineInfo = LineInfoLookup();
+        if (lineInfo && lineInfo->inst)
         {
-          if ((*(p+1)>='1' && *(p+1)<='9') &&
-              (ISSPACE(*(p+2)) || *(p+2)==':') &&
-              (gbt==kbtCode))
-          {
-            // it IS a temporary label
-            SymbolCreateTempLabel(*(p+1));
-            if ((*p+2)==':')
-              p++;
-            p = start = skipSpace(p+2);
-            // check if we are at the end of this line already
-            if (!*p || *p=='*' || *p==';')
-                return NORMAL; // yep... no further processing needed for this line
-          }
+          // The line was parsed on an earlier pass already. Label and
+          // instruction can't have changed since then.
+          memcpy(label, line+lineInfo->labelStart, lineInfo->labelLen);
+          label[lineInfo->labelLen] = '\0';
+          tablePtr = lineInfo->inst;
+          size = lineInfo->size;
+          p = line+lineInfo->opStart;
         }
-        else // if there is no temporary label then look for a normal one
+        else
         {
-          // Get a word (alphanum string including '_', '$', '?', '@')
-          // May be a label or instruction
-          p = ParseId(p,label);
-        }
+          label[0] = '\0';
         
-        // Is this a label? (must be at the start of a line and end in a colon)
-        if (*label && ((ISSPACE(*p) && start==line) || *p==':'))
-        {
-          if (*p==':')
-            p++;
-          p = skipSpace(p);
+          if (*p=='.') // could be a temporary label!
+          {
+            if ((*(p+1)>='1' && *(p+1)<='9') &&
+                (ISSPACE(*(p+2)) || *(p+2)==':') &&
+                (gbt==kbtCode))
+            {
+              // it IS a temporary label
+              SymbolCreateTempLabel(*(p+1));
+              // (it has to be created on every pass, so don't remember the line)
+              lineInfo = NULL;
+              if ((*p+2)==':')
+                p++;
+              p = start = skipSpace(p+2);
+              // check if we are at the end of this line already
+              if (!*p || *p=='*' || *p==';')
+                  return NORMAL; // yep... no further processing needed for this line
+            }
+          }
+          else // if there is no temporary label then look for a normal one
+          {
+            // Get a word (alphanum string including '_', '$', '?', '@')
+            // May be a label or instruction
+            p = ParseId(p,label);
+          }
+        
+          // Is this a label? (must be at the start of a line and end in a colon)
+          if (*label && ((ISSPACE(*p) && start==line) || *p==':'))
+          {
+            if (*p==':')
+              p++;
+            p = skipSpace(p);
 
-          // Look for a comment again.
-          if (*p=='*' || *p==';' || !*p)
+            // Look for a comment again.
+            if (*p=='*' || *p==';' || !*p)
+            {
+                SymbolCreate(label, symbolKindLabel, NULL, gulOutLoc);
+                return NORMAL;
+            }
+          }
+          else
           {
-              SymbolCreate(label, symbolKindLabel, NULL, gulOutLoc);
+            // Not a label, reset to start of line to begin getting the
+            // instruction.
+            p = start;
+            label[0] = '\0';
+          }
+
+          // Parse an instruction
+          p = instLookup(p, &tablePtr, &size);
+          if (ErrorStatusIsSevere())
               return NORMAL;
+
+          // Remember the result for the next pass (unless there was something
+          // to complain about, which has to be reported again on pass 2)
+          if (lineInfo && ErrorStatusIsOK())
+          {
+            lineInfo->inst       = tablePtr;
+            lineInfo->labelStart = start-line;
+            lineInfo->labelLen   = strlen(label);
+            lineInfo->opStart    = p-line;
+            lineInfo->size       = size;
           }
         }
-        else
-        {
-          // Not a label, reset to start of line to begin getting the
-          // instruction.
-          p = start;
-          label[0] = '\0';
-        }
-
-        // Parse an instruction
-        p = instLookup(p, &tablePtr, &size);
-        if (ErrorStatusIsSevere())
-            return NORMAL;
 
         // Parse the instruction's operands
+        EvalSetLine(lineInfo, line);
         p = skipSpace(p);
         if (tablePtr->parseFlag)
         {
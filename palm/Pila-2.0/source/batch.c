@@ -0,0 +1,237 @@
+/**********************************************************************************
+ *
+ *      BATCH.C
+ *
+ *      Assembling a whole list of files on a pool of threads.
+ *
+ *      See batch.h for a description of the functions.
+ *
+ *********************************************************************************/
+
+#include "pila.h"
+#include "prc.h"
+#include "srccache.h"
+#include "libiberty.h"
+#include "libpila.h"
+#include "batch.h"
+
+// One input file and what became of it
+typedef struct _BatchJob
+{
+  char *fileName;
+  int   rc;			// what PilaAssemble returned
+  int   cErrors;
+  int   cWarnings;
+  long  cbOut;			// bytes of PRC or number of symbols written
+  boolean fUpToDate;		// nothing to do (--if-changed)
+  char  szOutName[_MAX_PATH];
+} BatchJob;
+
+typedef struct _Batch
+{
+  BatchJob *jobs;
+  int       count;
+  int       next;		// index of the next job to be started
+  options  *opts;
+  FILE     *pfilOut;		// where the messages go (stderr with -M, see DEPENDS_TO_STDOUT)
+  PilaLock  lock;		// guards next, stdout and pfilOut
+} Batch;
+
+
+/* assembles one file and writes its PRC, printing the messages to pfilMsg
+   (after the name of the file if fName is set) */
+static void BatchRun(BatchJob *job, PilaContext *ctx, options *opts, FILE *pfilMsg,
+                     boolean fName)
+{
+  if (fName)
+    fprintf(pfilMsg, "Assembling %s\n", job->fileName);
+
+  ctx->pfilMsg = pfilMsg;
+  job->rc = PilaAssemble(ctx, job->fileName, opts);
+  if (job->rc < 0)
+    return;
+
+  job->cErrors   = ctx->cErrors;
+  job->cWarnings = ctx->cWarnings;
+  strcpy(job->szOutName, ctx->szOutName);
+
+  job->fUpToDate = ctx->fUpToDate;
+  if (ctx->fUpToDate)
+  {
+    fprintf(pfilMsg, "%s is up to date\n", ctx->szOutName);
+    return;
+  }
+  if (opts->precompile)
+    job->cbOut = ctx->cSymbols;
+  else if (ctx->cErrors == 0 && !opts->depends_only)
+  {
+    // If no errors, write the PRC (or object) file.
+    job->cbOut = ctx->pbPrc ? WritePrc(ctx->szOutName, ctx->pbPrc, ctx->cbPrc) : 0;
+    if (opts->object)
+      fprintf(pfilMsg, "Code: %ld bytes\nData: %ld bytes\nRes:  %ld bytes\n"
+              "Object: %ld bytes\n", ctx->cbCode, ctx->cbData, ctx->cbRes, job->cbOut);
+    else
+      fprintf(pfilMsg, "Code: %ld bytes\nData: %ld bytes (%ld compressed)\n"
+              "Res:  %ld bytes\nPRC:  %ld bytes\n",
+              ctx->cbCode, ctx->cbData, ctx->cbDataCompressed, ctx->cbRes, job->cbOut);
+  }
+
+  fputs(ctx->szErrors, pfilMsg);
+}
+
+
+/* copies the messages (or make rule) collected in pfil to pfilTo */
+static void BatchPrintMessages(FILE *pfil, FILE *pfilTo)
+{
+  char   buffer[4096];
+  size_t cb;
+
+  rewind(pfil);
+  while ((cb = fread(buffer, 1, sizeof(buffer), pfil)) > 0)
+    fwrite(buffer, 1, cb, pfilTo);
+  fflush(pfilTo);
+}
+
+
+#ifdef unix
+static void *BatchWorker(void *arg)
+#else
+static DWORD WINAPI BatchWorker(LPVOID arg)
+#endif
+{
+  Batch       *batch = (Batch *)arg;
+  PilaContext *ctx = PilaCreateContext();
+  FILE        *pfilMsg, *pfilDepends;
+  int          i;
+
+  for (;;)
+  {
+    PilaLockEnter(&batch->lock);
+    i = batch->next < batch->count ? batch->next++ : -1;
+    PilaLockLeave(&batch->lock);
+    if (i < 0)
+      break;
+
+    // without a temporary file the messages go out as they come
+    pfilMsg = tmpfile();
+    pfilDepends = DEPENDS_TO_STDOUT(batch->opts) ? tmpfile() : NULL;
+    ctx->pfilDepends = pfilDepends;
+    BatchRun(&batch->jobs[i], ctx, batch->opts, pfilMsg ? pfilMsg : batch->pfilOut,
+             batch->count > 1);
+    if (pfilMsg || pfilDepends)
+    {
+      PilaLockEnter(&batch->lock);
+      if (pfilMsg)
+        BatchPrintMessages(pfilMsg, batch->pfilOut);
+      if (pfilDepends)
+        BatchPrintMessages(pfilDepends, stdout);
+      PilaLockLeave(&batch->lock);
+    }
+    if (pfilMsg)
+      fclose(pfilMsg);
+    if (pfilDepends)
+      fclose(pfilDepends);
+  }
+
+  PilaDestroyContext(ctx);
+  return 0;
+}
+
+
+int BatchAssemble(char **files, int count, int jobs, options *opts)
+{
+  static PilaLock lockInit = PILA_LOCK_INIT;
+  Batch        batch;
+  BatchJob    *job;
+  PilaContext *ctx;
+  int          i, rc;
+
+  batch.jobs  = xcalloc(count, sizeof(BatchJob));
+  batch.count = count;
+  batch.next  = 0;
+  batch.opts  = opts;
+  batch.pfilOut = DEPENDS_TO_STDOUT(opts) ? stderr : stdout;
+  batch.lock  = lockInit;
+  for (i = 0; i < count; i++)
+    batch.jobs[i].fileName = files[i];
+
+  if (jobs > count)
+    jobs = count;
+  if (count > 1)
+    SourceCacheShare(true);
+
+  if (jobs <= 1)
+  {
+    // one after the other in this thread, printing messages right away
+    ctx = PilaCreateContext();
+    for (i = 0; i < count; i++)
+      BatchRun(&batch.jobs[i], ctx, opts, batch.pfilOut, count > 1);
+    PilaDestroyContext(ctx);
+  }
+  else
+  {
+#ifdef unix
+    pthread_t *threads = xmalloc(jobs * sizeof(pthread_t));
+
+    for (i = 0; i < jobs; i++)
+      if (pthread_create(&threads[i], NULL, BatchWorker, &batch) != 0)
+        break;
+    if (i == 0)
+      BatchWorker(&batch);	// no thread at all - do it ourselves
+    while (--i >= 0)
+      pthread_join(threads[i], NULL);
+#else
+    HANDLE *threads = xmalloc(jobs * sizeof(HANDLE));
+
+    for (i = 0; i < jobs; i++)
+      if ((threads[i] = CreateThread(NULL, 0, BatchWorker, &batch, 0, NULL)) == NULL)
+        break;
+    if (i == 0)
+      BatchWorker(&batch);	// no thread at all - do it ourselves
+    while (--i >= 0)
+    {
+      WaitForSingleObject(threads[i], INFINITE);
+      CloseHandle(threads[i]);
+    }
+#endif
+    free(threads);
+  }
+
+  if (count > 1)
+  {
+    SourceCacheShare(false);
+    fprintf(batch.pfilOut, "\nSummary of %d files:\n", count);
+  }
+
+  rc = 0;
+  for (i = 0, job = batch.jobs; i < count; i++, job++)
+  {
+    if (count > 1)
+    {
+      if (job->rc < 0)
+        fprintf(batch.pfilOut, "%s: not assembled\n", job->fileName);
+      else if (job->fUpToDate)
+        fprintf(batch.pfilOut, "%s: %s is up to date\n", job->fileName, job->szOutName);
+      else
+      {
+        fprintf(batch.pfilOut, "%s: %d error%s, %d warning%s", job->fileName,
+                job->cErrors,   (job->cErrors!=1)   ? "s" : "",
+                job->cWarnings, (job->cWarnings!=1) ? "s" : "");
+        if (job->rc == 0)
+          fprintf(batch.pfilOut, ", %s (%ld %s)", job->szOutName, job->cbOut,
+                  opts->precompile ? "symbols" : "bytes");
+        fputc('\n', batch.pfilOut);
+      }
+    }
+    // one file returns its error count as before, several the number
+    // of files that failed (a sum of error counts could wrap to 0 in the
+    // 8 bits an exit code keeps)
+    if (count == 1)
+      rc = job->rc < 0 ? 1 : job->rc;
+    else if (job->rc != 0)
+      rc++;
+  }
+
+  free(batch.jobs);
+  return rc > 255 ? 255 : rc;
+}
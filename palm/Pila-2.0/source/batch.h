@@ -0,0 +1,29 @@
+/**********************************************************************************
+ *
+ *      BATCH.H
+ *
+ *      Assembling a whole list of files in one go (pila -j N a.asm b.asm ...).
+ *
+ *      BatchAssemble(char **files, int count, int jobs, options *opts)
+ *        Assembles each of the files with the given options and writes its
+ *        PRC file. Up to jobs files are assembled at the same time, each on
+ *        a thread of its own. The messages of a file are collected while it
+ *        is assembled and printed in one piece when it is done, so they
+ *        don't get mixed up with those of the other files. If there is more
+ *        than one file, the include files are read only once for all of
+ *        them (see SourceCacheShare) and a summary line for each file is
+ *        printed at the end. With -M (and no -MF) the messages go to stderr
+ *        and stdout only gets the make rules.
+ *        Returns the exit code for pila: the error count of a single
+ *        file or the number of files that failed, at most 255 either way.
+ *
+ *********************************************************************************/
+
+#ifndef _BATCH_H_
+#define _BATCH_H_
+
+#include "options.h"
+
+int BatchAssemble(char **files, int count, int jobs, options *opts);
+
+#endif
@@ -0,0 +1,552 @@
+/**********************************************************************************
+ *
+ *      BITMAP.C
+ *
+ *      Conversion of BMP files into PalmOS bitmaps and bitmap families.
+ *
+ *      See bitmap.h for a description of the functions.
+ *
+ *********************************************************************************/
+
+#include "pila.h"
+#include "asm.h"
+#include "prc.h"
+#include "options.h"
+#include "libiberty.h"
+#include "bitmap.h"
+
+// BitmapType flags and compression types (see Bitmap.h of the PalmOS SDK)
+#define kfBmpCompressed     0x8000
+#define kfBmpHasColorTable  0x4000
+#define kfBmpDirectColor    0x0400
+
+#define kbBmpScanLine       0
+#define kbBmpRLE            1
+#define kbBmpPackBits       2
+#define kbBmpNoCompression  0xFF
+
+#define kcbBmpHeaders       54          // BITMAPFILEHEADER and BITMAPINFOHEADER
+#define kcBmpDepths         5           // 1, 2, 4, 8 and 16 bits per pixel
+
+typedef struct _BmpImage
+{
+  int   cx, cy;
+  int   cBits;            // bits per pixel
+  int   cbRow;            // of the PalmOS bitmap (word aligned)
+  byte *pbPixels;         // cbRow * cy bytes, top row first
+  byte *pbColors;         // the RGBQUADs of the BMP (8 bits per pixel only)
+  int   cColors;
+  byte *pbComp;           // the compressed pixels (NULL: not compressed)
+  long  cbComp;
+  int   bCompression;
+  int   version;
+} BmpImage;
+
+typedef struct _BmpOut
+{
+  byte *pb;
+  long  cb;
+  long  cbAlloc;
+} BmpOut;
+
+
+// BMP files are little-endian, whatever the host is
+
+static ulong BitmapGetLong(byte *pb)
+{
+  return pb[0] | (pb[1] << 8) | ((ulong)pb[2] << 16) | ((ulong)pb[3] << 24);
+}
+
+static int BitmapGetWord(byte *pb)
+{
+  return pb[0] | (pb[1] << 8);
+}
+
+
+// PalmOS bitmaps are big-endian
+
+static void BitmapPutByte(BmpOut *pout, int b)
+{
+  if (pout->cb == pout->cbAlloc)
+  {
+    pout->cbAlloc = 2 * pout->cbAlloc + 1024;
+    pout->pb = xrealloc(pout->pb, pout->cbAlloc);
+  }
+  pout->pb[pout->cb++] = (byte)b;
+}
+
+static void BitmapPutWord(BmpOut *pout, int w)
+{
+  BitmapPutByte(pout, w >> 8);
+  BitmapPutByte(pout, w);
+}
+
+static void BitmapPut(BmpOut *pout, byte *pb, long cb)
+{
+  if (pout->cb + cb > pout->cbAlloc)
+  {
+    pout->cbAlloc = 2 * pout->cbAlloc + cb;
+    pout->pb = xrealloc(pout->pb, pout->cbAlloc);
+  }
+  memcpy(pout->pb + pout->cb, pb, cb);
+  pout->cb += cb;
+}
+
+
+/* inverts a row of a 1 bit bitmap a word at a time (the bits are in the
+   same order in a BMP and a PalmOS bitmap, only black is 0 in one and 1
+   in the other) */
+static void BitmapInvertRow(byte *pbDst, byte *pbSrc, int cb)
+{
+  ulong ul;
+  int   i;
+
+  for (i = 0; i + (int)sizeof(ulong) <= cb; i += sizeof(ulong))
+  {
+    memcpy(&ul, pbSrc + i, sizeof(ulong));
+    ul = ~ul;
+    memcpy(pbDst + i, &ul, sizeof(ulong));
+  }
+  for (; i < cb; i++)
+    pbDst[i] = ~pbSrc[i];
+}
+
+
+/* fills abMap with what each byte of a 2 or 4 bit BMP row becomes: the
+   gray levels of its pixels (0 is white in PalmOS) */
+static void BitmapGrayMap(byte *abMap, int cBits, byte *pbColors, int cColors)
+{
+  byte abGray[16];
+  int  maxLevel = (1 << cBits) - 1;
+  int  i, v, shift, lum;
+
+  for (i = 0; i <= maxLevel; i++)
+  {
+    if (i < cColors)
+    {
+      // RGBQUADs are blue, green, red
+      lum = (pbColors[4*i+2] * 30 + pbColors[4*i+1] * 59 + pbColors[4*i] * 11) / 100;
+      abGray[i] = ((255 - lum) * maxLevel + 127) / 255;
+    }
+    else
+      abGray[i] = 0;
+  }
+
+  for (v = 0; v < 256; v++)
+  {
+    abMap[v] = 0;
+    for (shift = 8 - cBits; shift >= 0; shift -= cBits)
+      abMap[v] |= abGray[(v >> shift) & maxLevel] << shift;
+  }
+}
+
+
+/* reads the BMP file at pb (with cb bytes left in the resource) into pimg;
+   returns its size or 0 if it can't be converted */
+static long BitmapRead(byte *pb, long cb, BmpImage *pimg)
+{
+  byte  abMap[256];
+  byte *pbBits, *pbSrc, *pbDst;
+  long  cbFile, cbInfo, ibBits, cbSrcRow;
+  int   cyFile, compression, cBitsUsed, x, y, pixel;
+  boolean fFiveFive = true;
+
+  if (cb < kcbBmpHeaders || pb[0] != 'B' || pb[1] != 'M')
+    return 0;
+
+  cbFile       = BitmapGetLong(pb + 2);
+  ibBits       = BitmapGetLong(pb + 10);
+  cbInfo       = BitmapGetLong(pb + 14);
+  pimg->cx     = (int)BitmapGetLong(pb + 18);
+  cyFile       = (int)BitmapGetLong(pb + 22);
+  pimg->cBits  = BitmapGetWord(pb + 28);
+  compression  = (int)BitmapGetLong(pb + 30);
+  pimg->cColors = (int)BitmapGetLong(pb + 46);
+
+  if (cbFile < kcbBmpHeaders || cbFile > cb)
+    cbFile = cb;
+  if (cbInfo < 40 || BitmapGetWord(pb + 26) != 1 ||
+      pimg->cx <= 0 || pimg->cx > 0x7FFF || cyFile == 0 || abs(cyFile) > 0x7FFF)
+    return 0;
+  if (pimg->cBits!=1 && pimg->cBits!=2 && pimg->cBits!=4 && pimg->cBits!=8 && pimg->cBits!=16)
+    return 0;
+
+  // a 16 bit BMP is 5-5-5 unless its color masks say 5-6-5
+  if (compression == 3 && pimg->cBits == 16 && cbFile >= kcbBmpHeaders + 12)
+  {
+    if (BitmapGetLong(pb + 54) == 0xF800 && BitmapGetLong(pb + 58) == 0x07E0 &&
+        BitmapGetLong(pb + 62) == 0x001F)
+      fFiveFive = false;
+    else if (BitmapGetLong(pb + 54) != 0x7C00 || BitmapGetLong(pb + 58) != 0x03E0 ||
+             BitmapGetLong(pb + 62) != 0x001F)
+      return 0;
+  }
+  else if (compression != 0)
+    return 0;
+
+  if (pimg->cBits <= 8)
+  {
+    if (pimg->cColors <= 0 || pimg->cColors > (1 << pimg->cBits))
+      pimg->cColors = 1 << pimg->cBits;
+    if (14 + cbInfo + 4 * pimg->cColors > cbFile)
+      return 0;
+    pimg->pbColors = pb + 14 + cbInfo;
+  }
+  else
+    pimg->cColors = 0;
+
+  // BMP rows are long aligned and the bottom row comes first unless the
+  // height is negative
+  pimg->cy    = abs(cyFile);
+  cbSrcRow    = ((pimg->cx * pimg->cBits + 31) & ~31) / 8;
+  pimg->cbRow = ((pimg->cx * pimg->cBits + 15) & ~15) / 8;
+  if (ibBits < kcbBmpHeaders || ibBits + cbSrcRow * pimg->cy > cbFile)
+    return 0;
+  pbBits = pb + ibBits;
+
+  if (pimg->cBits == 2 || pimg->cBits == 4)
+    BitmapGrayMap(abMap, pimg->cBits, pimg->pbColors, pimg->cColors);
+
+  pimg->pbPixels = xmalloc(pimg->cbRow * pimg->cy);
+  cBitsUsed = pimg->cx * pimg->cBits;
+  for (y = 0; y < pimg->cy; y++)
+  {
+    pbSrc = pbBits + cbSrcRow * (cyFile > 0 ? pimg->cy - 1 - y : y);
+    pbDst = pimg->pbPixels + pimg->cbRow * y;
+
+    switch (pimg->cBits)
+    {
+    case 1:
+      BitmapInvertRow(pbDst, pbSrc, pimg->cbRow);
+      break;
+    case 2:
+    case 4:
+      for (x = 0; x < pimg->cbRow; x++)
+        pbDst[x] = abMap[pbSrc[x]];
+      break;
+    case 8:
+      memcpy(pbDst, pbSrc, pimg->cbRow);
+      break;
+    case 16:
+      for (x = 0; x < pimg->cx; x++)
+      {
+        pixel = BitmapGetWord(pbSrc + 2 * x);
+        if (fFiveFive)
+          pixel = ((pixel & 0x7FE0) << 1) | ((pixel & 0x0200) >> 4) | (pixel & 0x001F);
+        pbDst[2*x]   = pixel >> 8;
+        pbDst[2*x+1] = pixel;
+      }
+      break;
+    }
+
+    // the bits beyond the right edge are 0
+    if (cBitsUsed & 7)
+      pbDst[cBitsUsed >> 3] &= 0xFF << (8 - (cBitsUsed & 7));
+    memset(pbDst + (cBitsUsed + 7) / 8, 0, pimg->cbRow - (cBitsUsed + 7) / 8);
+  }
+
+  return cbFile;
+}
+
+
+/* each row as groups of up to 8 bytes, led by a byte with a bit for each
+   of them that differs from the row above (the first row has all) */
+static long BitmapScanLine(byte *pb, int cbRow, int cy, byte *pbOut)
+{
+  byte *pbStart = pbOut, *pbFlags;
+  int   x, y, i;
+
+  for (y = 0; y < cy; y++, pb += cbRow)
+  {
+    for (x = 0; x < cbRow; x += 8)
+    {
+      pbFlags = pbOut++;
+      *pbFlags = 0;
+      for (i = 0; i < 8 && x + i < cbRow; i++)
+      {
+        if (y == 0 || pb[x+i] != pb[x+i-cbRow])
+        {
+          *pbFlags |= 0x80 >> i;
+          *pbOut++ = pb[x+i];
+        }
+      }
+    }
+  }
+  return pbOut - pbStart;
+}
+
+
+/* the bytes as pairs of count (1..255) and byte */
+static long BitmapRLE(byte *pb, long cb, byte *pbOut)
+{
+  byte *pbStart = pbOut;
+  long  i, run;
+
+  for (i = 0; i < cb; i += run)
+  {
+    for (run = 1; i + run < cb && run < 255 && pb[i+run] == pb[i]; run++)
+      ;
+    *pbOut++ = (byte)run;
+    *pbOut++ = pb[i];
+  }
+  return pbOut - pbStart;
+}
+
+
+/* each row PackBits compressed: a count n followed by n+1 bytes (0..127)
+   or by a byte repeated 1-n times (-127..-1) */
+static long BitmapPackBits(byte *pb, int cbRow, int cy, byte *pbOut)
+{
+  byte *pbStart = pbOut;
+  int   i, y, run, lit;
+
+  for (y = 0; y < cy; y++, pb += cbRow)
+  {
+    for (i = 0; i < cbRow; )
+    {
+      for (run = 1; i + run < cbRow && run < 128 && pb[i+run] == pb[i]; run++)
+        ;
+      if (run > 1)
+      {
+        *pbOut++ = (byte)(257 - run);
+        *pbOut++ = pb[i];
+        i += run;
+        continue;
+      }
+
+      // up to the next run of equal bytes
+      for (lit = 1; i + lit < cbRow && lit < 128 &&
+                    !(i + lit + 1 < cbRow && pb[i+lit] == pb[i+lit+1]); lit++)
+        ;
+      *pbOut++ = (byte)(lit - 1);
+      memcpy(pbOut, pb + i, lit);
+      pbOut += lit;
+      i += lit;
+    }
+  }
+  return pbOut - pbStart;
+}
+
+
+/* compresses the pixels of pimg with the scheme that saves the most (if
+   any does, counting the size word in front of them) */
+static void BitmapCompress(BmpImage *pimg)
+{
+  byte *pbTry, *pbT;
+  long  cb, cbMax, cbTry;
+  int   b;
+
+  cb    = (long)pimg->cbRow * pimg->cy;
+  cbMax = 2 * cb + (long)pimg->cy * (pimg->cbRow / 8 + 2) + 16;
+  pbTry = xmalloc(cbMax);
+  pimg->pbComp = xmalloc(cbMax);
+  pimg->cbComp = cb - 2;
+  pimg->bCompression = kbBmpNoCompression;
+
+  for (b = kbBmpScanLine; b <= kbBmpPackBits; b++)
+  {
+    if (b == kbBmpScanLine)
+      cbTry = BitmapScanLine(pimg->pbPixels, pimg->cbRow, pimg->cy, pbTry);
+    else if (b == kbBmpRLE)
+      cbTry = BitmapRLE(pimg->pbPixels, cb, pbTry);
+    else if (pimg->cBits == 8)
+      cbTry = BitmapPackBits(pimg->pbPixels, pimg->cbRow, pimg->cy, pbTry);
+    else
+      continue;
+
+    if (cbTry < pimg->cbComp)
+    {
+      pbT = pimg->pbComp;
+      pimg->pbComp = pbTry;
+      pbTry = pbT;
+      pimg->cbComp = cbTry;
+      pimg->bCompression = b;
+    }
+  }
+
+  free(pbTry);
+  if (pimg->bCompression == kbBmpNoCompression)
+  {
+    free(pimg->pbComp);
+    pimg->pbComp = NULL;
+  }
+}
+
+
+/* appends the PalmOS bitmap of pimg to pout (followed by padding up to the
+   next bitmap of the family unless fLast) */
+static void BitmapWrite(BmpOut *pout, BmpImage *pimg, boolean fLast)
+{
+  long ibStart = pout->cb, ibNext = -1;
+  int  flags = 0, i;
+
+  if (pimg->pbComp)
+    flags |= kfBmpCompressed;
+  if (pimg->cBits == 8)
+    flags |= kfBmpHasColorTable;
+  if (pimg->cBits == 16)
+    flags |= kfBmpDirectColor;
+
+  BitmapPutWord(pout, pimg->cx);
+  BitmapPutWord(pout, pimg->cy);
+  BitmapPutWord(pout, pimg->cbRow);
+  BitmapPutWord(pout, flags);
+  if (pimg->version == 0)
+  {
+    for (i = 0; i < 8; i++)
+      BitmapPutByte(pout, 0);
+  }
+  else
+  {
+    BitmapPutByte(pout, pimg->cBits);
+    BitmapPutByte(pout, pimg->version);
+    ibNext = pout->cb;
+    BitmapPutWord(pout, 0);         // nextDepthOffset, see below
+    if (pimg->version == 1)
+    {
+      BitmapPutWord(pout, 0);
+      BitmapPutWord(pout, 0);
+    }
+    else
+    {
+      BitmapPutByte(pout, 0);       // transparentIndex
+      BitmapPutByte(pout, pimg->bCompression);
+      BitmapPutWord(pout, 0);
+    }
+  }
+
+  if (flags & kfBmpHasColorTable)
+  {
+    BitmapPutWord(pout, pimg->cColors);
+    for (i = 0; i < pimg->cColors; i++)
+    {
+      BitmapPutByte(pout, i);
+      BitmapPutByte(pout, pimg->pbColors[4*i+2]);
+      BitmapPutByte(pout, pimg->pbColors[4*i+1]);
+      BitmapPutByte(pout, pimg->pbColors[4*i]);
+    }
+  }
+  if (flags & kfBmpDirectColor)
+  {
+    // red, green and blue bits, reserved, transparent color (index, r, g, b)
+    BitmapPutByte(pout, 5);
+    BitmapPutByte(pout, 6);
+    BitmapPutByte(pout, 5);
+    for (i = 0; i < 5; i++)
+      BitmapPutByte(pout, 0);
+  }
+
+  if (pimg->pbComp)
+  {
+    // the size of the compressed data includes the size word itself
+    BitmapPutWord(pout, pimg->cbComp + 2);
+    BitmapPut(pout, pimg->pbComp, pimg->cbComp);
+  }
+  else
+    BitmapPut(pout, pimg->pbPixels, (long)pimg->cbRow * pimg->cy);
+
+  if (!fLast && ibNext >= 0)
+  {
+    // the offset to the next bitmap is counted in longs
+    while ((pout->cb - ibStart) & 3)
+      BitmapPutByte(pout, 0);
+    pout->pb[ibNext]   = (byte)((pout->cb - ibStart) / 4 >> 8);
+    pout->pb[ibNext+1] = (byte)((pout->cb - ibStart) / 4);
+  }
+}
+
+
+boolean BitmapConvert(byte *pbResData, ResourceMapEntry *prme)
+{
+  BmpImage  aimg[kcBmpDepths], imgT;
+  BmpOut    out;
+  long      ib, cb;
+  int       cImages, i;
+  boolean   fOk = true;
+
+  memset(aimg, 0, sizeof(aimg));
+  cImages = 0;
+  for (ib = 0; fOk && ib < (long)prme->cbData; ib += cb)
+  {
+    if (cImages == kcBmpDepths)
+    {
+      Error(BITMAP_DEPTH_TWICE, NULL);
+      fOk = false;
+      break;
+    }
+
+    cb = BitmapRead(pbResData + ib, prme->cbData - ib, &aimg[cImages]);
+    if (cb == 0)
+    {
+      Error(INV_BITMAP, NULL);
+      fOk = false;
+      break;
+    }
+    if (prme->usId == 0x7FFE && (aimg[cImages].cx != 32 || aimg[cImages].cy != 32))
+    {
+      Error(ICON_NOT_32X32, NULL);
+      fOk = false;
+    }
+
+    // a family goes from the lowest depth to the highest
+    for (i = cImages++; i > 0 && aimg[i-1].cBits >= aimg[i].cBits; i--)
+    {
+      if (aimg[i-1].cBits == aimg[i].cBits)
+      {
+        Error(BITMAP_DEPTH_TWICE, NULL);
+        fOk = false;
+        break;
+      }
+      imgT = aimg[i-1];
+      aimg[i-1] = aimg[i];
+      aimg[i] = imgT;
+    }
+  }
+  if (fOk && cImages == 0)
+  {
+    Error(INV_BITMAP, NULL);
+    fOk = false;
+  }
+
+  memset(&out, 0, sizeof(out));
+  for (i = 0; fOk && i < cImages; i++)
+  {
+    if (OPTION(compress_bitmaps))
+      BitmapCompress(&aimg[i]);
+    if (aimg[i].pbComp || aimg[i].cBits >= 8)
+      aimg[i].version = 2;
+    else if (aimg[i].cBits > 1 || cImages > 1)
+      aimg[i].version = 1;
+    else
+      aimg[i].version = 0;
+    BitmapWrite(&out, &aimg[i], i == cImages - 1);
+  }
+
+  for (i = 0; i < kcBmpDepths; i++)
+  {
+    free(aimg[i].pbPixels);
+    free(aimg[i].pbComp);
+  }
+
+  if (!fOk)
+  {
+    free(out.pb);
+    prme->pbData = NULL;
+    prme->cbData = 0;
+    return false;
+  }
+
+  prme->pbData = out.pb;
+  prme->cbData = out.cb;
+
+  // Special case: if bitmap id is 7FFE, make it the app icon
+  if (prme->usId == 0x7FFE)
+  {
+    prme->fcType = MAKE4CC('t','A','I','B');
+    prme->usId = 1000;
+  }
+  else
+    prme->fcType = MAKE4CC('T','b','m','p');
+
+  return true;
+}
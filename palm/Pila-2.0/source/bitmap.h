@@ -0,0 +1,40 @@
+/**********************************************************************************
+ *
+ *      BITMAP.H
+ *
+ *      Turning Windows bitmaps ('WBMP' resources) into PalmOS bitmaps
+ *      ('Tbmp', or 'tAIB' for the application icon with id 0x7FFE).
+ *
+ *      The resource holds one BMP file or several of them one after the
+ *      other (say a res block with an incbin for each). They have to be
+ *      uncompressed with 1, 2, 4, 8 or 16 bits per pixel, and of different
+ *      depths. Several BMPs make up a bitmap family, ordered by depth, from
+ *      which PalmOS picks the one that fits the screen best.
+ *
+ *      A 1 bit bitmap is inverted (white pixels become the background),
+ *      and 2 and 4 bit ones become gray levels by the brightness of their
+ *      colors. 8 bit bitmaps keep their colors in a color table, and 16 bit
+ *      ones are written as 5-6-5 direct color.
+ *
+ *      The version of each bitmap is the lowest that can hold it: a single
+ *      1 bit bitmap is version 0 like it always was, 1 bit ones of a family
+ *      and 2 or 4 bit ones version 1 and 8 or 16 bit ones version 2 (PalmOS
+ *      3.5). With --compress-bitmaps each bitmap is compressed with the
+ *      scanline, RLE or (8 bit only) PackBits scheme, whichever is smallest,
+ *      and written as version 2 if that saves anything.
+ *
+ *      BitmapConvert(byte *pbResData, ResourceMapEntry *prme)
+ *        Converts the prme->cbData bytes at pbResData and stores the result
+ *        in prme (data, size and type). Reports what it can't convert with
+ *        Error() and returns false then.
+ *
+ *********************************************************************************/
+
+#ifndef _BITMAP_H_
+#define _BITMAP_H_
+
+#include "prc.h"
+
+boolean BitmapConvert(byte *pbResData, ResourceMapEntry *prme);
+
+#endif
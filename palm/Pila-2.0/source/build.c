@@ -50,9 +50,10 @@
 #include "asm.h"
 #include "insttabl.h"
 #include "guard.h"
+#include "objfile.h"
 
-extern long gulOutLoc;
-extern int  giPass;
+extern PILA_STATE long gulOutLoc;
+extern PILA_STATE int  giPass;
 
 
 /***********************************************************************
@@ -507,30 +508,50 @@ int trap(int mask, int size, opDescriptor *source, opDescriptor *dest)
  *
  ***********************************************************************/
 
+PILA_STATE long branchShortCount = 0;  /* short branches generated on pass 2 */
+PILA_STATE long branchLongCount  = 0;  /* long branches generated on pass 2 */
+PILA_STATE long branchBytesSaved = 0;  /* bytes saved by making branches without size short */
+
 int branch(int mask, int size, opDescriptor *source, opDescriptor *dest)
 {
-    long    disp;
-
-    if (source->data.kind==symbolKindUndefined)
-		disp = 32000;		// ensure long jump if target is undefined
-	else
-		disp = source->data.value-gulOutLoc-2;
-
-											// make a short branch if
-    if ((size==SHORT								// 'short' was given as size
-         || (size!=LONG								// or 'long' wasn't given
-		     && disp >= -128 && disp <= 127 && disp)// and the distance is short
-        )
-        && (giPass<2 || GuardGet(0)==GUARD_SHORT_BRANCH) // and no long branch was used in pass 1
-       )
+    long    disp = source->data.value-gulOutLoc-2;
+    boolean fits = source->data.kind!=symbolKindUndefined
+                   && disp >= -128 && disp <= 127 && disp;
+    boolean isShort;
+    extern PILA_STATE boolean gfRelaxLong;
+
+    if (size==SHORT)                // 'short' was given as size
+        isShort = true;
+    else if (size==LONG)            // 'long' was given as size
+        isShort = false;
+    else if (giPass==0)             // be optimistic about forward references
+        isShort = fits || source->data.kind==symbolKindUndefined;
+    else if (giPass==1)             // a branch that had to be made long on an earlier
+                                    // run of pass 1 stays long (sizes only grow), and
+                                    // all are long if they don't settle (see processFile)
+        isShort = fits && !gfRelaxLong && GuardPeek(0,GUARD_SHORT_BRANCH)==GUARD_SHORT_BRANCH;
+    else                            // use what pass 1 found out
+        isShort = GuardGet(0)==GUARD_SHORT_BRANCH;
+
+    if (giPass==1)
+        Guard(isShort ? GUARD_SHORT_BRANCH : GUARD_LONG_BRANCH,0);
+
+    if (isShort)
     {
-		if (giPass==1)
-			Guard(GUARD_SHORT_BRANCH,0); // remember using short branch
-		else if (giPass==2)
+		if (giPass==2)
 		{
+			if (size!=SHORT && !fits) // labels moved after the last run of pass 1
+			{
+				Error(UNSUCCESSFULL_SHORT_BRANCH,NULL);
+				gulOutLoc += 2;
+				return NORMAL;
+			}
 			output((long) (mask | (disp & 0xFF)), WORD);
-			if (disp < -128 || disp > 127 || !disp)
+			if (!fits)
 				Error(INV_BRANCH_DISP,NULL);
+			branchShortCount++;
+			if (size!=SHORT)
+				branchBytesSaved += 2;
 		}
 		gulOutLoc += 2;
 	}
@@ -538,32 +559,49 @@ int branch(int mask, int size, opDescriptor *source, opDescriptor *dest)
     {
 		if (giPass==2)
 		{
-			if (GuardGet(0)!=GUARD_LONG_BRANCH) // if we used a short branch in pass 1 we have a problem
-			{
-				Error(UNSUCCESSFULL_SHORT_BRANCH,NULL);
-				gulOutLoc += 2;
-			}
-			else
-			{
-				output((long) (mask), WORD);
-				gulOutLoc += 2;
-				output((long) (disp), WORD);
-				gulOutLoc += 2;
-				if (disp < -32768 || disp > 32767)
-					Error(INV_BRANCH_DISP,NULL);
-			}
+			output((long) (mask), WORD);
+			gulOutLoc += 2;
+			if (ObjectRelocate(gulOutLoc, WORD, &source->data, kRelocPc))
+				disp = 0;
+			output((long) (disp), WORD);
+			gulOutLoc += 2;
+			if (disp < -32768 || disp > 32767)
+				Error(INV_BRANCH_DISP,NULL);
+			branchLongCount++;
 		}
 		else
-		{
-			if (giPass==1)
-				Guard(GUARD_LONG_BRANCH,0); // remember using a long branch
 			gulOutLoc += 4;
-		}
 	}    
     return NORMAL;
 }
 
 
+/***********************************************************************
+ *
+ *  Function BranchPrintStatistics prints how many branches were
+ *  generated short and long and how often pass 1 had to be run
+ *  until the sizes of all branches were settled.
+ *
+ ***********************************************************************/
+
+void BranchResetStatistics()
+{
+    branchShortCount = 0;
+    branchLongCount  = 0;
+    branchBytesSaved = 0;
+}
+
+void BranchPrintStatistics(FILE *pfil)
+{
+    extern PILA_STATE int giRelaxRuns;
+
+    fprintf(pfil, "Branches: %ld short, %ld long (%ld bytes saved by short branches)\n",
+            branchShortCount, branchLongCount, branchBytesSaved);
+    fprintf(pfil, "Branches: pass 1 was run %d time%s\n",
+            giRelaxRuns, giRelaxRuns!=1 ? "s" : "");
+}
+
+
 /***********************************************************************
  *
  *  Function moveq builds the MOVEQ instruction.
@@ -658,6 +696,9 @@ int dbcc(int mask, int size, opDescriptor *source, opDescriptor *dest)
     if (giPass==2) {
         output((long) (mask | source->reg), WORD);
         gulOutLoc += 2;
+        if (ObjectRelocate(gulOutLoc, WORD, &dest->data, kRelocPc)) {
+            disp = 0;
+        }
         output(disp, WORD);
         gulOutLoc += 2;
         if (disp < -32768 || disp > 32767) {
@@ -0,0 +1,385 @@
+/**********************************************************************************
+ *
+ *      CACHE.C
+ *
+ *      Keeping the results of assemblies around for the next time.
+ *
+ *      See cache.h for a description of the functions.
+ *
+ *********************************************************************************/
+
+#include "pila.h"
+#include "prc.h"
+#include "libiberty.h"
+#include "cache.h"
+#include "options.h"
+
+#ifdef unix
+#include <unistd.h>
+#include <sys/stat.h>
+#define CacheMakeDir(dir)   mkdir(dir, 0777)
+#define CacheProcessId()    ((long)getpid())
+#else
+#include <direct.h>
+#define CacheMakeDir(dir)   _mkdir(dir)
+#define CacheProcessId()    ((long)GetCurrentProcessId())
+#endif
+
+#define CACHE_VERSION "Pila 2.0 Beta ("__DATE__" "__TIME__")"
+
+// Numbers the temporary files of this process (all threads)
+static PilaLock lockTemp = PILA_LOCK_INIT;
+static long     cTemp = 0;
+
+// The list of inputs while it is put together for CacheStore
+typedef struct _CacheText
+{
+  char *text;
+  long  size;
+  long  alloc;
+} CacheText;
+
+
+static InputHash CacheHashString(InputHash hash, char *psz)
+{
+  if (!psz)
+    psz = "";
+  return InputHashData(hash, psz, strlen(psz) + 1);
+}
+
+
+InputHash CacheKey(char *fileName, char *outName, char *lisName)
+{
+  InputHash hash = INPUT_HASH_INIT;
+  long      lTime = 0;
+  char      szOptions[80];
+
+  // everything that ends up in the PRC, the listing or the messages
+  // without coming from one of the input files
+  hash = CacheHashString(hash, CACHE_VERSION);
+  hash = CacheHashString(hash, fileName);
+  hash = CacheHashString(hash, outName);
+  hash = CacheHashString(hash, lisName);
+  hash = CacheHashString(hash, getenv("PILAINC"));
+
+  if (!PrcGetTimestamp(&lTime))
+    lTime = -1;		// whenever the PRC was made
+  sprintf(szOptions, "%s %d%d%d%d%d%d%d%d%d%d%d %d %ld", OPTION(database_type),
+          OPTION(const_expanded), OPTION(resources_only), OPTION(emit_proc_symbols),
+          OPTION(listing), OPTION(verbose), OPTION(statistics), OPTION(object),
+          OPTION(gc_procs), OPTION(binary_listing), OPTION(json_errors),
+          OPTION(compress_bitmaps), OPTION(warn_limit), lTime);
+  return CacheHashString(hash, szOptions);
+}
+
+
+static void CachePath(char *path, char *dir, InputHash hash, char *ext)
+{
+  sprintf(path, "%s/%016llx%s", dir, hash, ext);
+}
+
+
+/* copies what is left of pfilFrom to pfilTo */
+static boolean CacheCopy(FILE *pfilFrom, FILE *pfilTo)
+{
+  char   buffer[4096];
+  size_t cb;
+
+  while ((cb = fread(buffer, 1, sizeof(buffer), pfilFrom)) > 0)
+    if (fwrite(buffer, 1, cb, pfilTo) != cb)
+      return false;
+  return !ferror(pfilFrom);
+}
+
+
+/* writes the cb bytes at pb (or the contents of pfilFrom) to path */
+static boolean CacheWrite(char *path, void *pb, long cb, FILE *pfilFrom)
+{
+  char    pathTemp[_MAX_PATH + 32];
+  FILE   *pfil;
+  boolean fOk;
+  long    iTemp;
+
+  PilaLockEnter(&lockTemp);
+  iTemp = cTemp++;
+  PilaLockLeave(&lockTemp);
+
+  sprintf(pathTemp, "%s.%ld-%ld.tmp", path, CacheProcessId(), iTemp);
+  pfil = fopen(pathTemp, "wb");
+  if (pfil == NULL)
+    return false;
+
+  if (pfilFrom)
+  {
+    rewind(pfilFrom);
+    fOk = CacheCopy(pfilFrom, pfil);
+  }
+  else
+    fOk = fwrite(pb, 1, cb, pfil) == (size_t)cb;
+  if (fclose(pfil) != 0)
+    fOk = false;
+
+#ifndef unix
+  if (fOk)
+    remove(path);	// rename doesn't replace files here
+#endif
+  if (!fOk || rename(pathTemp, path) != 0)
+  {
+    remove(pathTemp);
+    return false;
+  }
+  return true;
+}
+
+
+/* reads a whole file (the terminating zero is not counted in *pcb) */
+static char *CacheRead(char *path, long *pcb)
+{
+  FILE *pfil;
+  char *pb;
+  long  cb;
+
+  pfil = fopen(path, "rb");
+  if (pfil == NULL)
+    return NULL;
+
+  fseek(pfil, 0, SEEK_END);
+  cb = ftell(pfil);
+  rewind(pfil);
+  if (cb < 0)
+  {
+    fclose(pfil);
+    return NULL;
+  }
+  pb = xmalloc(cb + 1);
+  if (fread(pb, 1, cb, pfil) != (size_t)cb)
+  {
+    free(pb);
+    fclose(pfil);
+    return NULL;
+  }
+  pb[cb] = 0;
+  fclose(pfil);
+  *pcb = cb;
+  return pb;
+}
+
+
+/* checks each "hash size name" line of the list of inputs and notes
+   the files (see InputRecord) while they are the same */
+static boolean CacheInputsUnchanged(char *text)
+{
+  InputHash hashList, hash;
+  long      cbList, cb;
+  char     *pszLine, *pszEnd;
+  int       cchPrefix;
+
+  for (pszLine = text; *pszLine; pszLine = pszEnd + 1)
+  {
+    pszEnd = strchr(pszLine, '\n');
+    if (pszEnd == NULL)
+      return false;
+    *pszEnd = 0;
+    cchPrefix = 0;
+    sscanf(pszLine, "%llx %ld %n", &hashList, &cbList, &cchPrefix);
+    if (cchPrefix == 0 ||
+        !InputHashFile(pszLine + cchPrefix, &hash, &cb) ||
+        hash != hashList || cb != cbList)
+    {
+      *pszEnd = '\n';
+      return false;
+    }
+    InputRecordHash(pszLine + cchPrefix, hash, cb);
+    *pszEnd = '\n';
+  }
+  return true;
+}
+
+
+boolean CacheFetch(char *dir, InputHash key, char *lisName, PilaContext *ctx)
+{
+  char      path[_MAX_PATH + 32];
+  char     *text;
+  long      cbText, cbPrc;
+  InputHash result;
+  FILE     *pfilFrom, *pfilTo;
+  boolean   fOk;
+  int       cFields;
+
+  CachePath(path, dir, key, ".inputs");
+  text = CacheRead(path, &cbText);
+  if (text == NULL)
+    return false;
+  fOk = CacheInputsUnchanged(text);
+  result = InputHashData(key, text, cbText);
+  free(text);
+  if (!fOk)
+    return false;
+
+  CachePath(path, dir, result, ".info");
+  pfilFrom = fopen(path, "r");
+  if (pfilFrom == NULL)
+    return false;
+  cFields = fscanf(pfilFrom, "%ld %ld %ld %ld %ld %d", &cbPrc, &ctx->cbCode,
+                   &ctx->cbData, &ctx->cbDataCompressed, &ctx->cbRes, &ctx->cWarnings);
+  fclose(pfilFrom);
+  if (cFields != 6)
+    return false;
+
+  CachePath(path, dir, result, ".prc");
+  ctx->pbPrc = (unsigned char *)CacheRead(path, &ctx->cbPrc);
+  if (ctx->pbPrc == NULL || ctx->cbPrc != cbPrc)
+    return false;
+
+  if (lisName)
+  {
+    CachePath(path, dir, result, ".lis");
+    pfilFrom = fopen(path, "rb");
+    if (pfilFrom == NULL)
+      return false;
+    pfilTo = fopen(lisName, "wb");
+    fOk = pfilTo && CacheCopy(pfilFrom, pfilTo);
+    if (pfilTo && fclose(pfilTo) != 0)
+      fOk = false;
+    fclose(pfilFrom);
+    if (!fOk)
+      return false;
+  }
+
+  CachePath(path, dir, result, ".msg");
+  pfilFrom = fopen(path, "rb");
+  if (pfilFrom == NULL)
+    return false;
+  CacheCopy(pfilFrom, gpfilMsg);
+  fclose(pfilFrom);
+  return true;
+}
+
+
+/* checks that fileName still is what the stamp says */
+static boolean CacheOutputUnchanged(char *fileName, InputHash hashStamp, long cbStamp)
+{
+  InputHash hash;
+  long      cb;
+
+  return InputHashFile(fileName, &hash, &cb) && hash == hashStamp && cb == cbStamp;
+}
+
+
+boolean CacheUpToDate(InputHash key, char *outName, char *lisName)
+{
+  char      path[_MAX_PATH + 32];
+  char     *text, *pszInputs;
+  long      cbText, cbOut, cbLis;
+  InputHash keyStamp, hashOut, hashLis;
+  boolean   fOk;
+
+  sprintf(path, "%s.inputs", outName);
+  text = CacheRead(path, &cbText);
+  if (text == NULL)
+    return false;
+
+  pszInputs = strchr(text, '\n');
+  fOk = pszInputs &&
+        sscanf(text, "%llx %llx %ld %llx %ld", &keyStamp, &hashOut, &cbOut,
+               &hashLis, &cbLis) == 5 &&
+        keyStamp == key &&
+        CacheOutputUnchanged(outName, hashOut, cbOut) &&
+        (!lisName || CacheOutputUnchanged(lisName, hashLis, cbLis)) &&
+        CacheInputsUnchanged(pszInputs + 1);
+  free(text);
+  return fOk;
+}
+
+
+static void CacheAddInput(char *fileName, InputHash hash, long size, void *data)
+{
+  CacheText *list = (CacheText *)data;
+  long       cch = strlen(fileName) + 40;
+
+  if (list->size + cch > list->alloc)
+  {
+    list->alloc = 2 * list->alloc + cch;
+    list->text = xrealloc(list->text, list->alloc);
+  }
+  list->size += sprintf(list->text + list->size, "%016llx %ld %s\n", hash, size, fileName);
+}
+
+
+boolean CacheStamp(InputHash key, char *outName, unsigned char *pbOut, long cbOut,
+                   char *lisName)
+{
+  char      path[_MAX_PATH + 32];
+  CacheText list = { NULL, 0, 0 };
+  InputHash hashOut, hashLis = 0;
+  long      cbLis = 0;
+  boolean   fOk;
+
+  // the PRC is hashed as it is going to be written
+  if (pbOut)
+    hashOut = InputHashData(INPUT_HASH_INIT, pbOut, cbOut);
+  else if (!InputHashFile(outName, &hashOut, &cbOut))
+    return false;
+  if (lisName && !InputHashFile(lisName, &hashLis, &cbLis))
+    return false;
+
+  list.alloc = 100;
+  list.text = xmalloc(list.alloc);
+  list.size = sprintf(list.text, "%016llx %016llx %ld %016llx %ld\n",
+                      key, hashOut, cbOut, hashLis, cbLis);
+  InputForEach(CacheAddInput, &list);
+
+  sprintf(path, "%s.inputs", outName);
+  fOk = CacheWrite(path, list.text, list.size, NULL);
+  free(list.text);
+  return fOk;
+}
+
+
+boolean CacheStore(char *dir, InputHash key, char *lisName, PilaContext *ctx,
+                   FILE *pfilMsgs)
+{
+  char      path[_MAX_PATH + 32];
+  char      szInfo[100];
+  CacheText list = { NULL, 0, 0 };
+  InputHash result;
+  FILE     *pfilLis;
+  boolean   fOk;
+
+  CacheMakeDir(dir);	// fails if it already exists, which is fine
+
+  InputForEach(CacheAddInput, &list);
+  result = InputHashData(key, list.text, list.size);
+
+  // the list of inputs comes last, so it never leads to missing results
+  CachePath(path, dir, result, ".prc");
+  fOk = CacheWrite(path, ctx->pbPrc, ctx->cbPrc, NULL);
+  if (fOk && lisName)
+  {
+    pfilLis = fopen(lisName, "rb");
+    CachePath(path, dir, result, ".lis");
+    fOk = pfilLis && CacheWrite(path, NULL, 0, pfilLis);
+    if (pfilLis)
+      fclose(pfilLis);
+  }
+  if (fOk)
+  {
+    CachePath(path, dir, result, ".msg");
+    fOk = CacheWrite(path, NULL, 0, pfilMsgs);
+  }
+  if (fOk)
+  {
+    sprintf(szInfo, "%ld %ld %ld %ld %ld %d\n", ctx->cbPrc, ctx->cbCode,
+            ctx->cbData, ctx->cbDataCompressed, ctx->cbRes, ctx->cWarnings);
+    CachePath(path, dir, result, ".info");
+    fOk = CacheWrite(path, szInfo, strlen(szInfo), NULL);
+  }
+  if (fOk)
+  {
+    CachePath(path, dir, key, ".inputs");
+    fOk = CacheWrite(path, list.text, list.size, NULL);
+  }
+
+  free(list.text);
+  return fOk;
+}
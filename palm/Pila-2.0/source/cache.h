@@ -0,0 +1,67 @@
+/**********************************************************************************
+ *
+ *      CACHE.H
+ *
+ *      The build cache (pila --cache DIR). The results of an assembly are
+ *      kept in DIR under a key made from the options and the contents of
+ *      every file the assembly read (see inputs.h). As long as none of
+ *      them changes the next assembly of the same file just copies the
+ *      results out of the cache.
+ *
+ *      A result takes two steps to find. CacheKey hashes what is known
+ *      before the assembly: the options, the names of the output files and
+ *      $PILAINC. DIR/<key>.inputs lists the files the last assembly with
+ *      that key read and their hashes. If all of them are still the same,
+ *      their hashes together with key give the name of the result files
+ *      DIR/<result>.prc, .lis, .msg (the messages) and .info (the sizes
+ *      and the number of warnings).
+ *
+ *      CacheKey(char *fileName, char *outName, char *lisName)
+ *        Returns the key for assembling fileName with the current options
+ *        into outName (and the listing lisName, NULL if none).
+ *
+ *      CacheFetch(char *dir, InputHash key, char *lisName, PilaContext *ctx)
+ *        Looks for the results of key in dir. If they are there, puts the
+ *        PRC and the sizes into ctx, copies the listing to lisName, prints
+ *        the messages to gpfilMsg and notes the inputs by InputRecord.
+ *        Returns false if the results are not there or any of the inputs
+ *        changed.
+ *
+ *      CacheStore(char *dir, InputHash key, char *lisName, PilaContext *ctx, FILE *pfilMsgs)
+ *        Keeps the results of an assembly (without errors) in dir: the PRC
+ *        in ctx, the listing lisName and the messages in pfilMsgs, all
+ *        under the files noted by InputRecord. Each file is written under
+ *        a temporary name first and then renamed, so several pilas can use
+ *        the same directory. Returns false if anything could not be written.
+ *
+ *      The same kind of list next to the output file (outName.inputs) lets
+ *      --if-changed find out whether there is anything to do at all.
+ *
+ *      CacheUpToDate(InputHash key, char *outName, char *lisName)
+ *        Returns true if outName.inputs says outName (and lisName, NULL if
+ *        there is no listing) were made with key and neither they nor any
+ *        of the inputs changed since. The inputs are noted by InputRecord
+ *        while they are checked.
+ *
+ *      CacheStamp(InputHash key, char *outName, unsigned char *pbOut, long cbOut, char *lisName)
+ *        Writes outName.inputs for the files noted by InputRecord. pbOut
+ *        holds what is going to be written to outName (NULL if it is there
+ *        already).
+ *
+ *********************************************************************************/
+
+#ifndef _CACHE_H_
+#define _CACHE_H_
+
+#include "inputs.h"
+#include "libpila.h"
+
+InputHash CacheKey(char *fileName, char *outName, char *lisName);
+boolean   CacheFetch(char *dir, InputHash key, char *lisName, PilaContext *ctx);
+boolean   CacheStore(char *dir, InputHash key, char *lisName, PilaContext *ctx,
+                     FILE *pfilMsgs);
+boolean   CacheUpToDate(InputHash key, char *outName, char *lisName);
+boolean   CacheStamp(InputHash key, char *outName, unsigned char *pbOut, long cbOut,
+                     char *lisName);
+
+#endif
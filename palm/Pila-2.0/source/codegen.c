@@ -54,9 +54,10 @@
 
 #include "pila.h"
 #include "asm.h"
+#include "objfile.h"
 
-extern long gulOutLoc;
-extern int  giPass;
+extern PILA_STATE long gulOutLoc;
+extern PILA_STATE int  giPass;
 extern FILE *gpfilList;
 
 int output(long data, int size)
@@ -106,7 +107,7 @@ int effAddr(opDescriptor *operand)
     if (operand->mode == Immediate) {
         return 0x3C;
     }
-    printf("INVALID EFFECTIVE ADDRESSING MODE!\n");
+    fputs("INVALID EFFECTIVE ADDRESSING MODE!\n", gpfilMsg);
     exit (0);
 }
 
@@ -125,10 +126,13 @@ int extWords(opDescriptor *op, int size)
                op->mode == PCDisp) {
         if (giPass==2) {
             disp = op->data.value;
-            if (op->mode == PCDisp) {
+            if (ObjectRelocate(gulOutLoc, WORD, &op->data,
+                               op->mode == PCDisp ? kRelocPc : kRelocDisp)) {
+                disp = 0;
+            } else if (op->mode == PCDisp) {
                 disp -= gulOutLoc;
             }
-            else if (op->data.type!=NULL && size!=0)
+            if (op->mode != PCDisp && op->data.type!=NULL && size!=0)
             {
               int typeSize = SymbolGetSize(op->data.type);
               if (typeSize>0 && typeSize<=4 && typeSize!=size)
@@ -144,10 +148,14 @@ int extWords(opDescriptor *op, int size)
                op->mode == PCIndex) {
         if (giPass==2) {
             disp = op->data.value;
-            if (op->mode == PCIndex) {
+            // the displacement is the low byte of the extension word
+            if (ObjectRelocate(gulOutLoc + 1, BYTE, &op->data,
+                               op->mode == PCIndex ? kRelocPc : kRelocDisp)) {
+                disp = 0;
+            } else if (op->mode == PCIndex) {
                 disp -= gulOutLoc;
             }
-            else if (op->data.type!=NULL && size!=0)
+            if (op->mode != PCIndex && op->data.type!=NULL && size!=0)
             {
               int typeSize = SymbolGetSize(op->data.type);
               if (typeSize>0 && typeSize<=4 && typeSize!=size)
@@ -162,6 +170,9 @@ int extWords(opDescriptor *op, int size)
         gulOutLoc += 2;
     } else if (op->mode == AbsShort) {
         if (giPass==2) {
+            if (ObjectRelocate(gulOutLoc, WORD, &op->data, kRelocAbs)) {
+                op->data.value = 0;
+            }
             output(op->data.value & 0xFFFF, WORD);
             if (op->data.value < -32768 || op->data.value > 32767) {
                 Error(INV_ABS_ADDRESS,NULL);
@@ -170,12 +181,18 @@ int extWords(opDescriptor *op, int size)
         gulOutLoc += 2;
     } else if (op->mode == AbsLong) {
         if (giPass==2) {
+            if (ObjectRelocate(gulOutLoc, LONG, &op->data, kRelocAbs)) {
+                op->data.value = 0;
+            }
             output(op->data.value, LONG);
         }
         gulOutLoc += 4;
     } else if (op->mode == Immediate) {
         if (!size || size == WORD) {
             if (giPass==2) {
+                if (ObjectRelocate(gulOutLoc, WORD, &op->data, kRelocAbs)) {
+                    op->data.value = 0;
+                }
                 output(op->data.value & 0xFFFF, WORD);
                 /*
                 if (op->data.value < -32768 || op->data.value > 32767)
@@ -188,6 +205,9 @@ int extWords(opDescriptor *op, int size)
             gulOutLoc += 2;
         } else if (size == BYTE) {
             if (giPass==2) {
+                if (ObjectRelocate(gulOutLoc + 1, BYTE, &op->data, kRelocAbs)) {
+                    op->data.value = 0;
+                }
                 output(op->data.value & 0xFF, WORD);
                 if (op->data.value < -32768 || op->data.value > 32767) {
                     Error(INV_8_BIT_DATA,NULL);
@@ -196,12 +216,15 @@ int extWords(opDescriptor *op, int size)
             gulOutLoc += 2;
         } else if (size == LONG) {
             if (giPass==2) {
+                if (ObjectRelocate(gulOutLoc, LONG, &op->data, kRelocAbs)) {
+                    op->data.value = 0;
+                }
                 output(op->data.value, LONG);
             }
             gulOutLoc += 4;
         }
     } else {
-        printf("INVALID EFFECTIVE ADDRESSING MODE!\n");
+        fputs("INVALID EFFECTIVE ADDRESSING MODE!\n", gpfilMsg);
         exit(0);
     }
 
@@ -2,6 +2,8 @@
 /* Calculation of 32 bit Cyclic Redundancy Checksum */
 /****************************************************/
 
+#include "pila.h"
+
 unsigned long CRC32Table[256] = {
   0x00000000,  0x77073096,  0xEE0E612C,  0x990951BA,  0x076DC419,  0x706AF48F,  0xE963A535,  0x9E6495A3,
   0x0EDB8832,  0x79DCB8A4,  0xE0D5E91E,  0x97D2D988,  0x09B64C2B,  0x7EB17CBD,  0xE7B82D07,  0x90BF1D91,
@@ -36,7 +38,7 @@ unsigned long CRC32Table[256] = {
   0xBDBDF21C,  0xCABAC28A,  0x53B39330,  0x24B4A3A6,  0xBAD03605,  0xCDD70693,  0x54DE5729,  0x23D967BF,
   0xB3667A2E,  0xC4614AB8,  0x5D681B02,  0x2A6F2B94,  0xB40BBE37,  0xC30C8EA1,  0x5A05DF1B,  0x2D02EF8D };
 
-static unsigned long ulCRC = 0xFFFFFFFF;
+static PILA_STATE unsigned long ulCRC = 0xFFFFFFFF;
 
 void CRC32Reset()
 {
@@ -41,30 +41,37 @@
 #include "parse.h"
 #include "guard.h"
 #include "options.h"
+#include "pch.h"
+#include "inputs.h"
+#include "segment.h"
+#include "objfile.h"
+#include "procgraph.h"
 
-extern long gulOutLoc;
-extern int	giPass;
-extern boolean endFlag;
+extern PILA_STATE long gulOutLoc;
+extern PILA_STATE int	giPass;
+extern PILA_STATE int	giPassRun;
+extern PILA_STATE boolean endFlag;
 
 extern char *listPtr;	/* Pointer to buffer where listing line is assembled
 						   (Used to put =XXXXXXXX in the listing for EQU's and SET's */
 #define kcsseMax	50
 
-int gcsse = 0;
-struct SourceStackEntry gasse[kcsseMax];
-struct SourceStackEntry *gpsseCur;
+PILA_STATE int gcsse = 0;
+PILA_STATE struct SourceStackEntry gasse[kcsseMax];
+PILA_STATE struct SourceStackEntry *gpsseCur;
 
-SymbolDef *insideType		= NULL;		// used for struct/union/enum directives
-Value	   nextEnumValue	= {0,symbolKindConst,NULL}; // holds value for next enum member
-int		   bitmapShiftValue = 0;		// used for bitmaps inside structs (shift value of last bitmap member)
-int		   bitmapTypeSize	= 0;		// number of bytes into which last bitmap member was assigned
-SymbolDef *lastLocalSymbol	= NULL;		// last local symbol defined (used to calculate link operand in beginproc)
-boolean	   procedureBegun	= false;		// true between beginproc and endproc
+PILA_STATE SymbolDef *insideType		= NULL;		// used for struct/union/enum directives
+PILA_STATE Value	   nextEnumValue	= {0,symbolKindConst,NULL}; // holds value for next enum member
+PILA_STATE int		   bitmapShiftValue = 0;		// used for bitmaps inside structs (shift value of last bitmap member)
+PILA_STATE int		   bitmapTypeSize	= 0;		// number of bytes into which last bitmap member was assigned
+PILA_STATE SymbolDef *lastLocalSymbol	= NULL;		// last local symbol defined (used to calculate link operand in beginproc)
+PILA_STATE boolean	   procedureBegun	= false;		// true between beginproc and endproc
+PILA_STATE boolean	   procedureDropped = false;		// true while skipping a procedure nothing uses
 
 #define MAX_IF_LEVEL 32
-int		   ifLevel			= 0;		// used for if/else/endif to control code generation
-int		   ifNoGenLevel		= 0;		// used for if/else/endif to control code generation
-boolean	   ifElseFlag[MAX_IF_LEVEL];		// used to control that only one ELSE is specified for each IF
+PILA_STATE int		   ifLevel			= 0;		// used for if/else/endif to control code generation
+PILA_STATE int		   ifNoGenLevel		= 0;		// used for if/else/endif to control code generation
+PILA_STATE boolean	   ifElseFlag[MAX_IF_LEVEL];		// used to control that only one ELSE is specified for each IF
 
 #ifdef ORG_DIRECTIVE
 /***********************************************************************
@@ -128,6 +135,12 @@ int org(int size, char *label, char *op)
 
 void EndBlock()
 {
+	// Whatever was skipped at the end of the block (org, align) is
+	// part of it, too.
+	if (OutputReserve(gulOutLoc, 0) == NULL && gbt == kbtResource) {
+		gulOutLoc = 0;
+	}
+
 	switch (gbt) {
 	case kbtData:
 		gulDataLoc = gulOutLoc;
@@ -141,6 +154,8 @@ void EndBlock()
 		// Write the entire resource out
 		AddResource(gfcResType, (unsigned short)gidRes, gpbResource, 
 					gulOutLoc, false);
+		// the next resource reuses the buffer and expects zeros
+		memset(gpbResource, 0, gulOutLoc);
 		break;
 	}
 
@@ -323,6 +338,8 @@ int dc(int size, char *label, char *op)
 				return NORMAL;
 			}
 			
+			if (ObjectRelocate(gulOutLoc, size, &outVal, kRelocAbs))
+				outVal.value = 0;
 			if (giPass==2)
 				output(outVal.value, size);
 			gulOutLoc += size;
@@ -388,6 +405,10 @@ int dcb(int size, char *label, char *op)
 		Error(INV_LENGTH,NULL);
 		return NORMAL;
 	}
+	if (blockSize.value > (kcbBlockMax - OutputOffset(gulOutLoc)) / size) {
+		Error(BLOCK_TOO_BIG,NULL);
+		return NORMAL;
+	}
 	/* Evaluate the data to put in block */
 	op = evaluate(op+1, &blockVal);
 	if (op && !ErrorStatusIsSevere()) {
@@ -459,6 +480,10 @@ int ds(int size, char *label, char *op)
 		Error(INV_LENGTH,NULL);
 		return NORMAL;
 	}
+	if (blockSize.value > (kcbBlockMax - OutputOffset(gulOutLoc)) / size) {
+		Error(BLOCK_TOO_BIG,NULL);
+		return NORMAL;
+	}
 
 	// Set uninitialized data to zeros.
 	// OK, this seems strange but for now we're pooling 'uninitialized'
@@ -532,12 +557,50 @@ int DataDirective(int size, char *label, char *op)
 //
 //
 
+int SegmentDirective(int size, char *label, char *op)
+{
+	if (size != 0) {
+		Error(INV_SIZE_CODE,NULL);
+	}
+	if (*label) {
+		Error(LABEL_IGNORED,label);
+	}
+	if (SymbolHasCurrentProc()) {
+		Error(SEGMENT_IN_PROC,NULL);
+		return NORMAL;
+	}
+	if (OPTION(object)) {
+		// pila-ld links everything into code #1
+		Error(SEGMENT_IN_OBJECT,NULL);
+		return NORMAL;
+	}
+
+	// Save away important state pertaining to the previous block
+	EndBlock();
+
+	if (!SegmentBegin()) {
+		Error(TOO_MANY_SEGMENTS,NULL);
+		return NORMAL;
+	}
+
+	gpbOutput = gpbCode;
+	gulOutLoc = gulCodeLoc;
+	gbt = kbtCode;
+
+	return NORMAL;
+}
+
+//
+//
+//
+
 int ResDirective(int size, char *label, char *op)
 {
 	char szT[80];
 	char *pch;
 	FILE *pfil;
 	Value val;
+	long cb;
 
 	if (size != 0) {
 		Error(INV_SIZE_CODE,NULL);
@@ -589,15 +652,23 @@ int ResDirective(int size, char *label, char *op)
 			return NORMAL;
 		}
 
-		gulResLoc = fread(gpbResource, 1, kcbResMax, pfil);
-		if (gulResLoc == kcbResMax) {
+		fseek(pfil, 0, SEEK_END);
+		cb = ftell(pfil);
+		rewind(pfil);
+		if (cb < 0 || cb > kcbBlockMax) {
+			fclose(pfil);
 			Error(RESOURCE_TOO_BIG,szT);
 			return NORMAL;
 		}
+		gbt = kbtResource;
+		OutputReserve(0, cb);
+		gulResLoc = fread(gpbResource, 1, cb, pfil);
 		fclose(pfil);
+		InputRecord(szT, gpbResource, gulResLoc);
 
 		AddResource(gfcResType, (unsigned short)gidRes, gpbResource,
 					gulResLoc, false);
+		memset(gpbResource, 0, gulResLoc);
 
 		gbt = kbtCode;
 		gulOutLoc = gulCodeLoc;
@@ -609,7 +680,7 @@ int ResDirective(int size, char *label, char *op)
 	}
 
 	if (OPTION(verbose)) {
-		printf("0x%lx, %ld, %s\n", gfcResType, gidRes, szT);
+		fprintf(gpfilMsg, "0x%lx, %ld, %s\n", gfcResType, gidRes, szT);
 	}
 
 	gulResLoc = 0;
@@ -677,6 +748,8 @@ int IncludeDirective(int size, char *label, char *op)
 
 #ifndef unix
 	int i,i2;
+#else
+	char *pszNext;
 #endif
 
 	if (size) {
@@ -799,12 +872,12 @@ int IncludeDirective(int size, char *label, char *op)
 
 #else
 	pszT = szSearchPath;
-	pszT = strtok(pszT, ":");
+	pszT = strtok_r(pszT, ":", &pszNext);
 	while (pszT != NULL) {
 		if (IsExisting(pszT, szFile)) {
 			break;
 		}
-		pszT = strtok(NULL, ":");
+		pszT = strtok_r(NULL, ":", &pszNext);
 	}
 
 	if (pszT == NULL) {
@@ -814,25 +887,23 @@ int IncludeDirective(int size, char *label, char *op)
 		strcpy(tmpbuf, pszT);
 		strcat(tmpbuf, "/");
 		strcat(tmpbuf, szFile);
+		strcpy(szFile, tmpbuf);
 	}
 #endif
 
 lbPushIt:
-#ifndef unix
+	// a precompiled image of the file takes the place of its text
+	if (PchInclude(szFile)) {
+		return NORMAL;
+	}
+
 	if (PushSourceFile(szFile) == NULL) {
-#else
-	if (PushSourceFile(tmpbuf) == NULL) {
-#endif
 		// PushSourceFile will set the ERROR if there is one
 		return NORMAL;
 	}
 
 	if (OPTION(verbose)) {
-#ifndef unix	
-		printf("include \"%s\"\n", szFile);
-#else
-		printf("include \"%s\"\n", tmpbuf);
-#endif
+		fprintf(gpfilMsg, "include \"%s\"\n", szFile);
 	}
 
 	return NORMAL;
@@ -842,40 +913,98 @@ lbPushIt:
 #define FILE_SYM_PREFIX		":include:"
 #define FILE_SYM_PREFIX_LEN 9
 
-FILE *PushSourceFile(char *pszNextSource)
+// Builds the id of the symbol recording when a source file was included.
+static void SourceFileSymbolName(char *pszSource, char *symbolName)
 {
-	struct SourceStackEntry *psse;
-	char symbolName[_MAX_PATH+1+FILE_SYM_PREFIX_LEN];
-	char *fileName;
-	SymbolDef *sym;
-
 	strcpy(symbolName,FILE_SYM_PREFIX);
-	fileName = symbolName+FILE_SYM_PREFIX_LEN;
-	fileName[_MAX_PATH] = '\0';
+	symbolName[FILE_SYM_PREFIX_LEN+_MAX_PATH] = '\0';
 	
 #ifndef unix
-	GetFullPathName(pszNextSource, _MAX_PATH, fileName, NULL);
+	GetFullPathName(pszSource, _MAX_PATH, symbolName+FILE_SYM_PREFIX_LEN, NULL);
 #else
-	strncpy(fileName, pszNextSource, _MAX_PATH);
+	strncpy(symbolName+FILE_SYM_PREFIX_LEN, pszSource, _MAX_PATH);
 #endif
+}
+
+// Returns the name of a file recorded by the symbol sym or NULL if sym
+// doesn't record an included file.
+char *SourceFileIncludedName(SymbolDef *sym)
+{
+	if (SymbolGetKind(sym)!=symbolKindInclude)
+		return NULL;
+	return SymbolGetId(sym)+FILE_SYM_PREFIX_LEN;
+}
+
+// Returns true if a source file was included before (on any pass run).
+boolean SourceFileIsIncluded(char *pszSource)
+{
+	char symbolName[_MAX_PATH+1+FILE_SYM_PREFIX_LEN];
+
+	SourceFileSymbolName(pszSource, symbolName);
+	return SymbolLookup(symbolName)!=NULL;
+}
+
+// Marks a source file as included during the current pass run. Returns
+// false if it was included already (every file is included only once).
+// On return fileName holds the name the file is known by.
+boolean SourceFileMarkIncluded(char *pszSource, char *fileName)
+{
+	char symbolName[_MAX_PATH+1+FILE_SYM_PREFIX_LEN];
+	SymbolDef *sym;
+
+	SourceFileSymbolName(pszSource, symbolName);
+	strcpy(fileName, symbolName+FILE_SYM_PREFIX_LEN);
 
 	sym = SymbolLookup(symbolName);
 
-	if (sym!=NULL && (SymbolGetValue(sym)==giPass)) // || stricmp(symbolName+strlen(symbolName)-4,".inc")==0))
+	if (sym!=NULL && (SymbolGetValue(sym)==giPassRun)) // || stricmp(symbolName+strlen(symbolName)-4,".inc")==0))
 	{
-	  return NULL;
+	  return false;
 	}
 	else if (sym==NULL)
 	{
-	  SymbolCreate(symbolName,symbolKindInclude,NULL,giPass);
+	  SymbolCreate(symbolName,symbolKindInclude,NULL,giPassRun);
 	}
 	else
 	{
 	  Value value;
-	  value.value = giPass;
+	  value.value = giPassRun;
 	  value.kind  = symbolKindInclude;
 	  SymbolSetValue(sym,&value);
 	}
+	return true;
+}
+
+// Puts the state kept by the directives back to where it is before the
+// first line gets assembled. Needed if an earlier assembly in this thread
+// stopped in the middle of an include file, a type or a procedure.
+
+void DirectiveInitialize()
+{
+	gcsse			= 0;
+	gpsseCur		= NULL;
+	insideType		= NULL;
+	nextEnumValue.value = 0;
+	nextEnumValue.kind	= symbolKindConst;
+	nextEnumValue.type	= NULL;
+	bitmapShiftValue = 0;
+	bitmapTypeSize	= 0;
+	lastLocalSymbol = NULL;
+	procedureBegun	= false;
+	procedureDropped = false;
+	ifLevel			= 0;
+	ifNoGenLevel	= 0;
+}
+
+SourceFile *PushSourceFile(char *pszNextSource)
+{
+	struct SourceStackEntry *psse;
+	char fileName[_MAX_PATH+1];
+
+	if (!SourceFileMarkIncluded(pszNextSource, fileName))
+	{
+	  return NULL;
+	}
 	
 	if (gcsse == kcsseMax) {
 		Error(INCLUDE_NESTED_TOO_DEEP,fileName);
@@ -884,8 +1013,8 @@ FILE *PushSourceFile(char *pszNextSource)
 
 	psse = &gasse[gcsse];
 
-	psse->pfil = fopen(fileName, "r");
-	if (psse->pfil == NULL || psse->pfil == (FILE *)-1) {
+	psse->psrc = SourceCacheOpen(fileName);
+	if (psse->psrc == NULL) {
 		Error(INCLUDE_OPEN_FAILED,fileName);
 		return NULL;
 	}
@@ -895,7 +1024,7 @@ FILE *PushSourceFile(char *pszNextSource)
 	gpsseCur = psse;
 	gcsse++;
 
-	return gpsseCur->pfil;
+	return gpsseCur->psrc;
 }
 
 boolean PopSourceFile()
@@ -904,8 +1033,8 @@ boolean PopSourceFile()
 		return false;
 	}
 
-	// Close the include file.
-	fclose(gpsseCur->pfil);
+	// Nothing to close here - the file stays in the source cache for the
+	// next pass.
 
 	// NOTE: This will underflow when the last file (the main source file) is
 	// popped but that's OK because it isn't used after that (better not be).
@@ -920,8 +1049,8 @@ boolean PopSourceFile()
 
 int ApplDirective(int size, char *label, char *op)
 {
-	extern char gszAppName[dmDBNameLength];
-	extern FourCC gfcCreatorId;
+	extern PILA_STATE char gszAppName[dmDBNameLength];
+	extern PILA_STATE FourCC gfcCreatorId;
    
 	Value val;
 
@@ -1046,6 +1175,7 @@ int IncbinDirective(int size, char *label, char *op)
 	char buf[4096];
 	FILE *in;
 	int bytesread;
+	unsigned char *pb;
 
 	if (size != 0) {
 		Error(INV_SIZE_CODE,NULL);
@@ -1078,11 +1208,16 @@ int IncbinDirective(int size, char *label, char *op)
 		Error(INCLUDE_OPEN_FAILED,szFile);
 		return NORMAL;
 	}
+	InputRecordFile(szFile);
 
 	/* Read 4K at a time */
 	while ((bytesread = fread(buf, 1, 4096, in)) != 0) {
 		if (giPass==2) {
-			memcpy(gpbOutput + gulOutLoc, buf, bytesread);
+			pb = OutputReserve(gulOutLoc, bytesread);
+			if (pb == NULL) {
+				break;
+			}
+			memcpy(pb, buf, bytesread);
 		}
 		gulOutLoc += bytesread;
 	}
@@ -1267,6 +1402,10 @@ int GlobalDirective(int size, char *label, char *op) // global variable
 		Error(EXPECTED_GLOBAL_VAR_ID,op);
 		return NORMAL;
 	}
+
+	// nothing uses it (see procgraph.h), so it takes no room
+	if (ProcGraphIsDropped(SymbolLookup(label)))
+		return NORMAL;
 	
 	op = ParseTypeSpec(op,&varType,lookForDot); // looks for '.' first if there was no label
 	if (!varType)	   /* no valid type found? */
@@ -1280,7 +1419,7 @@ int GlobalDirective(int size, char *label, char *op) // global variable
 	}
 	
 	// create global-symbol
-	SymbolCreate(label,symbolKindData,varType,gulOutLoc);
+	ProcGraphDefine(SymbolCreate(label,symbolKindData,varType,gulOutLoc));
 
 	// Set uninitialized data to zeros.  
 	// OK, this seems strange but for now we're pooling 'uninitialized'
@@ -1377,6 +1516,14 @@ int EntryPointDirective(SymbolKind kind, int size, char *label, char *op)
 	return NORMAL;
   }
 
+  if ((kind==symbolKindProcEntry || kind==symbolKindProxyEntry) &&
+	  ProcGraphIsDropped(SymbolLookup(label)))
+  {
+	// nothing uses it (see procgraph.h), so it is skipped up to its end
+	procedureDropped = true;
+	return NORMAL;
+  }
+
   if (kind==symbolKindProcEntry || kind==symbolKindProxyEntry)
   {
 	if (gulOutLoc&1)
@@ -1455,6 +1602,8 @@ int EntryPointDirective(SymbolKind kind, int size, char *label, char *op)
   }
   
   symbol = SymbolCreate(label,kind,NULL,symValue);
+  if (kind==symbolKindProcEntry || kind==symbolKindProxyEntry)
+	ProcGraphDefine(symbol);
   parms = SymbolGetType(symbol);
   if (!parms)
   {
@@ -1850,7 +1999,7 @@ int CallDirective(int size, char *label, char *op) // call procedure or trap
 	  // declaration therefore the symbol must be considered undefined
 	  Error(UNDEFINED_SYMBOL,targetId);
 	}
-	else
+	else if (!OPTION(object))
 	  Error(DECLARED_BUT_UNDEFINED_PROC,targetId);
   }
   else if (SymbolGetKind(jmpTarget)!=symbolKindProcEntry && 
@@ -1861,6 +2010,7 @@ int CallDirective(int size, char *label, char *op) // call procedure or trap
 	  Error(NOT_A_PROCEDURE_NOR_TRAP,targetId);
 	return NORMAL;
   }
+  ProcGraphReference(jmpTarget);
 
   op = skipSpace(op);
   if (*op!='(')
@@ -1888,11 +2038,24 @@ int CallDirective(int size, char *label, char *op) // call procedure or trap
   // if jmpTarget is NULL (undefined) a trap with 16-bit-selector is generated
   // that is the maximum sized call there is
   if (jmpTarget && (SymbolGetKind(jmpTarget)==symbolKindProcEntry || // is it a JSR we need?
-					SymbolGetKind(jmpTarget)==symbolKindProxyEntry))
+					SymbolGetKind(jmpTarget)==symbolKindProxyEntry ||
+					(OPTION(object) && SymbolGetKind(jmpTarget)==symbolKindProcDef &&
+					 SymbolGetType(jmpTarget))))		// imported (see objfile.h)
   {
-	ExpandString("\tjsr\t");
-	ExpandString(SymbolGetId(jmpTarget));
-	ExpandString("(pc)\n");
+	if (gbt==kbtCode && !OPTION(object) &&
+		SegmentOf(SymbolGetValue(jmpTarget))!=SegmentCurrent())
+	{
+	  // the target is in another code segment: go through the jump table
+	  char sz[24];
+	  sprintf(sz,"%ld(a5)",SegmentJumpEntry(jmpTarget));
+	  ExpandInstruction("jsr",sz,NULL);
+	}
+	else
+	{
+	  ExpandString("\tjsr\t");
+	  ExpandString(SymbolGetId(jmpTarget));
+	  ExpandString("(pc)\n");
+	}
   }
   else // we need to generate a trap call
   {
@@ -2173,15 +2336,38 @@ boolean DirectiveContinuation(char *line)
 {
   char		  symbolId[SIGCHARS+1];
   char		 *op;
-  
-  if (ifNoGenLevel>0)
+  instruction *inst;
+  int		(*exec)(int, char *, char *);
+
+  // the directives are told apart by their entry in the instruction table
+  if (procedureDropped)
+  {
+	// skip everything up to the end of the procedure (the first word
+	// may be a label)
+	op = ParseId(skipSpace(line),symbolId);
+	inst = instFind(symbolId);
+	if (!inst && *symbolId)
+	{
+	  if (*op==':')
+		op++;
+	  ParseId(skipSpace(op),symbolId);
+	  inst = instFind(symbolId);
+	}
+	exec = inst ? inst->exec : NULL;
+	if (exec==EndProcDirective || exec==EndProxyDirective)
+	  procedureDropped = false;
+	return true;
+  }
+  else if (ifNoGenLevel>0)
   {
 	op = ParseId(skipSpace(line),symbolId);
-	if (stricmp(symbolId,"IF")==0 ||
-		stricmp(symbolId,"IFDEF")==0 ||
-		stricmp(symbolId,"IFNDEF")==0 ||
-		stricmp(symbolId,"ELSE")==0 ||
-		stricmp(symbolId,"ENDIF")==0)
+	inst = instFind(symbolId);
+	exec = inst ? inst->exec : NULL;
+	if (exec==IfDirective ||
+		exec==IfDefDirective ||
+		exec==IfNDefDirective ||
+		exec==ElseDirective ||
+		exec==EndIfDirective)
 	  return false;
 	else
 	  return true;
@@ -2202,32 +2388,34 @@ boolean DirectiveContinuation(char *line)
 	  return true;
 	}
 
-	if (stricmp(symbolId,"ENDENUM")==0)
+	inst = instFind(symbolId);
+	exec = inst ? inst->exec : NULL;
+	if (exec==EndEnumDirective)
 	{
 	  if (kind==symbolKindTypeEnum)
 		EndMemberedType(op);
 	  else
 		Error(UNEXPECTED_ENDENUM,NULL);
 	}
-	else if (stricmp(symbolId,"ENDSTRUCT")==0)
+	else if (exec==EndStructDirective)
 	{
 	  if (kind==symbolKindTypeStruct)
 		EndMemberedType(op);
 	  else
 		Error(UNEXPECTED_ENDSTRUCT,NULL);
 	}
-	else if (stricmp(symbolId,"ENDUNION")==0)
+	else if (exec==EndUnionDirective)
 	{
 	  if (kind==symbolKindTypeUnion)
 		EndMemberedType(op);
 	  else
 		Error(UNEXPECTED_ENDUNION,NULL);
 	}
-	else if (stricmp(symbolId,"ENUM")==0)
+	else if (exec==EnumDirective)
 	  Error(UNEXPECTED_ENUM,NULL);
-	else if (stricmp(symbolId,"STRUCT")==0)
+	else if (exec==StructDirective)
 	  Error(UNEXPECTED_STRUCT,NULL);
-	else if (stricmp(symbolId,"UNION")==0)
+	else if (exec==UnionDirective)
 	  Error(UNEXPECTED_UNION,NULL);
 	else
 	{
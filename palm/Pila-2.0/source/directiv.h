@@ -28,13 +28,20 @@ int dcb(int, char *, char *);
 int ds(int, char *, char *);
 
 boolean DirectiveContinuation(char *line);
+void EndBlock();
 int CodeDirective(int size, char *label, char *op);
 int DataDirective(int size, char *label, char *op);
 int ResDirective(int size, char *label, char *op);
+int SegmentDirective(int size, char *label, char *op);
 int IncludeDirective(int size, char *label, char *op);
 int ApplDirective(int size, char *label, char *op);
-FILE *PushSourceFile(char *pszNewSource);
+char *SourceFileIncludedName(SymbolDef *sym);
+boolean SourceFileIsIncluded(char *pszSource);
+boolean SourceFileMarkIncluded(char *pszSource, char *fileName);
+void DirectiveInitialize();
+SourceFile *PushSourceFile(char *pszNewSource);
 boolean PopSourceFile();
+void TruncateDir(char *pszPath);
 int AlignDirective(int size, char *label, char *op);
 int ListDirective(int size, char *label, char *op);
 int IncbinDirective(int size, char *label, char *op);
@@ -31,12 +31,79 @@
 
 #include "pila.h"
 #include "asm.h"
+#include "options.h"
 #include "libiberty.h"
 
-int           maxErrorCode   = OK;
-int           errorCount     = 0;
-int           warningCount   = 0;
-boolean		  writeMessage   = false;
+/* A message waiting for the end of its source line (see error.h) */
+typedef struct _ErrorRecord
+{
+  ErrorCode code;
+  int       file;          // index into errorFiles
+  int       line;
+  int       column;        // of the details in the source line (0: not in it)
+  int       detail;        // offset of the details in errorText (-1: none)
+  int       detailLength;
+} ErrorRecord;
+
+/* How often a warning came up at one place (--warn-limit) */
+typedef struct _ErrorSite
+{
+  ErrorCode code;          // OK: the slot is free
+  int       file;
+  int       line;
+  int       count;
+} ErrorSite;
+
+PILA_STATE int           maxErrorCode   = OK;
+PILA_STATE int           errorCount     = 0;
+PILA_STATE int           warningCount   = 0;
+PILA_STATE boolean		  writeMessage   = false;
+
+static PILA_STATE boolean      errorInLine     = false;
+static PILA_STATE char        *errorSourceLine = NULL;
+static PILA_STATE ErrorRecord *errorRecords    = NULL;
+static PILA_STATE int          errorRecordCount = 0;
+static PILA_STATE int          errorRecordAlloc = 0;
+static PILA_STATE char        *errorText       = NULL;
+static PILA_STATE int          errorTextSize   = 0;
+static PILA_STATE int          errorTextAlloc  = 0;
+static PILA_STATE char       **errorFiles      = NULL;
+static PILA_STATE int          errorFileCount  = 0;
+static PILA_STATE int          errorFileAlloc  = 0;
+static PILA_STATE ErrorSite   *errorSites      = NULL;
+static PILA_STATE int          errorSiteCount  = 0;
+static PILA_STATE int          errorSiteAlloc  = 0;     // a power of 2
+static PILA_STATE int          suppressedCount = 0;
+
+/* forgets the files and warning sites of the last assembly */
+static void ErrorFlush()
+{
+  int i;
+
+  for (i = 0; i < errorFileCount; i++)
+    free(errorFiles[i]);
+  free(errorFiles);
+  free(errorSites);
+  errorFiles = NULL;
+  errorFileCount = errorFileAlloc = 0;
+  errorSites = NULL;
+  errorSiteCount = errorSiteAlloc = 0;
+  errorRecordCount = 0;
+  errorTextSize = 0;
+  errorInLine = false;
+  errorSourceLine = NULL;
+  suppressedCount = 0;
+}
+
+void ErrorInitialize()
+{
+	writeMessage = false;
+	maxErrorCode = OK;
+	errorCount   = 0;
+	warningCount = 0;
+	ErrorFlush();
+}
+
 
 void ErrorStartReporting()
 {
@@ -44,6 +111,7 @@ void ErrorStartReporting()
 	maxErrorCode = OK;
 	errorCount   = 0;
 	warningCount = 0;
+	ErrorFlush();
 }
 
 
@@ -59,48 +127,228 @@ char *ErrorMessage(ErrorCode errCde)
 }
 
 
-char *ErrorLine(ErrorCode errorCode,char *details)
+/* returns the name of the error code as it is written in error.h */
+static char *ErrorName(ErrorCode errCde)
 {
-  char msg[1024];
-  char *pszError = NULL;
-  char *pszType;
-  pszError = ErrorMessage(errorCode);
-  pszType  = errorCode>=MINOR ? "error" : "warning";
-  if (details)
-    sprintf(msg,"%s(%d): %s: %s: %s\n",gpsseCur->szFile,gpsseCur->iLineNum,pszType,pszError,details);
+  switch(errCde)
+  {
+#define ERRCODE(x,y) case x: return #x;
+	ERROR_CODE_LIST
+#undef ERRCODE
+  }
+  return "UNKNOWN";
+}
+
+
+/* returns the id of the current source file, adding its name the first time */
+static int ErrorFileId()
+{
+  int i;
+
+  // most messages come from the same file as the one before
+  for (i = errorFileCount - 1; i >= 0; i--)
+    if (strcmp(errorFiles[i], gpsseCur->szFile) == 0)
+      return i;
+
+  if (errorFileCount == errorFileAlloc)
+  {
+    errorFileAlloc = 2 * errorFileAlloc + 4;
+    errorFiles = xrealloc(errorFiles, errorFileAlloc * sizeof(char *));
+  }
+  errorFiles[errorFileCount] = xstrdup(gpsseCur->szFile);
+  return errorFileCount++;
+}
+
+
+/* counts the warning code at the current place and returns false once
+   it came up more often than --warn-limit allows */
+static boolean ErrorCountSite(ErrorCode code, int file, int line)
+{
+  ErrorSite *site, *oldSites;
+  int        i, oldAlloc;
+  unsigned   hash;
+
+  if (errorSiteCount * 2 >= errorSiteAlloc)
+  {
+    oldSites = errorSites;
+    oldAlloc = errorSiteAlloc;
+    errorSiteAlloc = oldAlloc ? 2 * oldAlloc : 256;
+    errorSites = xcalloc(errorSiteAlloc, sizeof(ErrorSite));
+    for (i = 0; i < oldAlloc; i++)
+    {
+      if (oldSites[i].code == OK)
+        continue;
+      hash = (unsigned)oldSites[i].line * 31u + (unsigned)oldSites[i].file * 17u + oldSites[i].code;
+      site = &errorSites[hash & (errorSiteAlloc - 1)];
+      while (site->code != OK)
+        site = (site == &errorSites[errorSiteAlloc - 1]) ? errorSites : site + 1;
+      *site = oldSites[i];
+    }
+    free(oldSites);
+  }
+
+  hash = (unsigned)line * 31u + (unsigned)file * 17u + code;
+  site = &errorSites[hash & (errorSiteAlloc - 1)];
+  while (site->code != OK &&
+         (site->code != code || site->file != file || site->line != line))
+    site = (site == &errorSites[errorSiteAlloc - 1]) ? errorSites : site + 1;
+
+  if (site->code == OK)
+  {
+    site->code = code;
+    site->file = file;
+    site->line = line;
+    errorSiteCount++;
+  }
+  return ++site->count <= OPTION(warn_limit);
+}
+
+
+/* writes s as a JSON string */
+static void ErrorPutJsonString(char *s, int len, FILE *pfil)
+{
+  int i;
+
+  putc('"', pfil);
+  for (i = 0; i < len; i++)
+  {
+    unsigned char ch = (unsigned char)s[i];
+
+    if (ch == '"' || ch == '\\')
+    {
+      putc('\\', pfil);
+      putc(ch, pfil);
+    }
+    else if (ch == '\t')
+      fputs("\\t", pfil);
+    else if (ch < 0x20 || ch == 0x7f)
+      fprintf(pfil, "\\u%04x", ch);
+    else
+      putc(ch, pfil);
+  }
+  putc('"', pfil);
+}
+
+
+/* writes the message of record to the messages and the listing */
+static void ErrorRender(ErrorRecord *record)
+{
+  char  msg[1024];
+  char *pszError = ErrorMessage(record->code);
+  char *pszType  = record->code>=MINOR ? "error" : "warning";
+  char *pszFile  = errorFiles[record->file];
+
+  if (record->detail >= 0)
+    snprintf(msg,sizeof(msg),"%s(%d): %s: %s: %.*s\n",pszFile,record->line,pszType,pszError,
+             record->detailLength,errorText + record->detail);
   else
-    sprintf(msg,"%s(%d): %s: %s\n",gpsseCur->szFile,gpsseCur->iLineNum,pszType,pszError);
-  return xstrdup(msg);
+    snprintf(msg,sizeof(msg),"%s(%d): %s: %s\n",pszFile,record->line,pszType,pszError);
+  ListWriteError(msg);
+
+  if (!OPTION(json_errors))
+  {
+    fputs(msg,gpfilMsg);
+    return;
+  }
+
+  fputs("{\"file\":",gpfilMsg);
+  ErrorPutJsonString(pszFile,strlen(pszFile),gpfilMsg);
+  fprintf(gpfilMsg,",\"line\":%d,\"column\":%d,\"severity\":\"%s\",\"code\":\"%s\",\"message\":",
+          record->line,record->column,pszType,ErrorName(record->code));
+  ErrorPutJsonString(pszError,strlen(pszError),gpfilMsg);
+  if (record->detail >= 0)
+  {
+    fputs(",\"detail\":",gpfilMsg);
+    ErrorPutJsonString(errorText + record->detail,record->detailLength,gpfilMsg);
+  }
+  fputs("}\n",gpfilMsg);
+}
+
+
+void ErrorStartLine(char *line)
+{
+  errorInLine = writeMessage;
+  errorSourceLine = line;
+}
+
+
+void ErrorEndLine()
+{
+  int i;
+
+  for (i = 0; i < errorRecordCount; i++)
+    ErrorRender(&errorRecords[i]);
+  errorRecordCount = 0;
+  errorTextSize = 0;
+  errorInLine = false;
+  errorSourceLine = NULL;
 }
 
 
 void Error(ErrorCode code,char *details)
 {
-  char *msg;
+  ErrorRecord *record;
+  int          file, len;
  
   if (code>maxErrorCode)
     maxErrorCode = code;
   
-  if (writeMessage)
+  if (!writeMessage)
+    return;
+
+  if (code>=MINOR)
+    errorCount++;
+  else if (code>=WARNING)
+    warningCount++;
+
+  file = ErrorFileId();
+  if (code<MINOR && OPTION(warn_limit)>0 && !ErrorCountSite(code,file,gpsseCur->iLineNum))
   {
-    if (code>=MINOR)
-      errorCount++;
-    else if (code>=WARNING)
-      warningCount++;
+    suppressedCount++;
+    return;
+  }
 
-    msg = ErrorLine(code,details);
-    if (!msg)
-    {
-      printf("memory error: message %d for line no. %d could not be created",code,gpsseCur->iLineNum);
-      exit(16);
-    }
-    else
+  if (errorRecordCount == errorRecordAlloc)
+  {
+    errorRecordAlloc = 2 * errorRecordAlloc + 8;
+    errorRecords = xrealloc(errorRecords, errorRecordAlloc * sizeof(ErrorRecord));
+  }
+  record = &errorRecords[errorRecordCount++];
+  record->code   = code;
+  record->file   = file;
+  record->line   = gpsseCur->iLineNum;
+  record->column = 0;
+  record->detail = -1;
+  record->detailLength = 0;
+
+  if (details)
+  {
+    // details mostly point into the source line, which ends with the
+    // newline; they are copied since the line is gone when the message
+    // is written
+    len = strcspn(details,"\r\n");
+    if (errorSourceLine && details >= errorSourceLine &&
+        details < errorSourceLine + strlen(errorSourceLine))
+      record->column = (int)(details - errorSourceLine) + 1;
+    if (errorTextSize + len > errorTextAlloc)
     {
-      fputs(msg,stdout);
-	  if (ListWriteError(msg)) // returns true if message is not kept
-	      free(msg);
+      errorTextAlloc = 2 * errorTextAlloc + len + 256;
+      errorText = xrealloc(errorText, errorTextAlloc);
     }
+    memcpy(errorText + errorTextSize, details, len);
+    record->detail = errorTextSize;
+    record->detailLength = len;
+    errorTextSize += len;
   }
+
+  // outside of a source line the message is written right away
+  if (!errorInLine)
+    ErrorEndLine();
+}
+
+int ErrorGetSuppressedCount()
+{
+  return suppressedCount;
 }
 
 int ErrorGetErrorCount()
@@ -27,6 +27,7 @@
   ERRCODE(INSTR_AND_OPER_SIZE_MISMATCH,	"mismatch between size of instruction and size of operand") \
   ERRCODE(INTERNAL_ERROR_GUARD_NOT_DEF,	"internal error - guard symbol not found on pass 2") \
   ERRCODE(ALIGNMENT_WARNING,			"implicit alignment to word boundary") \
+  ERRCODE(BLOCK_OVER_64K,				"code, data or resource exceeds 64K (PalmOS may not be able to load it)") \
 										\
   /* Minor errors */ \
   ERRCODE(MINOR,						"minor Error") \
@@ -71,6 +72,10 @@
   ERRCODE(UNMATCHING_TYPE_SIZES,		"unmatching type sizes") \
   ERRCODE(USER_ERROR,					"Error") \
   ERRCODE(TEMP_LABEL_CODE_ONLY,			"temporary labels can only be used for code labels") \
+  ERRCODE(IMPORT_NOT_RELOCATABLE,		"imported symbol can not be used in a resource") \
+  ERRCODE(INV_BITMAP,					"bitmap not an uncompressed BMP with 1, 2, 4, 8 or 16 bits per pixel") \
+  ERRCODE(BITMAP_DEPTH_TWICE,			"two bitmaps of the same depth in one resource") \
+  ERRCODE(ICON_NOT_32X32,				"icon bitmap not 32x32") \
   \
   /* Severe Errors */ \
   ERRCODE(SEVERE,						"severe Error") \
@@ -125,6 +130,11 @@
   ERRCODE(PHASE_ERROR,					"symbol value differs between first and second pass") \
   ERRCODE(RESOURCE_OPEN_FAILED,			"failed to open resource file") \
   ERRCODE(RESOURCE_TOO_BIG,				"resource file too big") \
+  ERRCODE(BLOCK_TOO_BIG,				"code, data or resource exceeds 16M") \
+  ERRCODE(SEGMENT_IN_PROC,				"segment directive within a procedure") \
+  ERRCODE(TOO_MANY_SEGMENTS,			"too many code segments") \
+  ERRCODE(SEGMENT_IN_OBJECT,			"segment directive in an object file") \
+  ERRCODE(TOO_MANY_IMPORTS,				"too many imported symbols") \
   ERRCODE(INCLUDE_OPEN_FAILED,			"failed to open include file") \
   ERRCODE(INCLUDE_NESTED_TOO_DEEP,		"include files neted too deep") \
   ERRCODE(MISSING_TRAP_DEF,				"missing trap definition") \
@@ -156,9 +166,33 @@ typedef enum _ErrorCode
 #undef ERRCODE
 } ErrorCode;
 
+/*
+ * Messages only come out in pass 2. Error() keeps a small record of each
+ * (code, file, line, column of the details and the details themselves),
+ * which is written when the source line is done: as text to the messages
+ * and the listing, or with --json-errors as one JSON object per line to
+ * the messages (the column is 0 if the details are not taken from the
+ * line). Outside of a source line a message is written right away.
+ * With --warn-limit N a warning comes out at most N times for the same
+ * source line (such as the pushes of a call); the rest is only counted.
+ *
+ *   ErrorStartLine(char *line)
+ *     The messages from here on belong to line (for the column).
+ *
+ *   ErrorEndLine()
+ *     Writes the messages of the line.
+ *
+ *   ErrorGetSuppressedCount()
+ *     Returns the number of warnings --warn-limit kept back.
+ */
+
+void ErrorInitialize();
 void ErrorStartReporting();
+void ErrorStartLine(char *line);
+void ErrorEndLine();
 int  ErrorGetWarningCount();
 int  ErrorGetErrorCount();
+int  ErrorGetSuppressedCount();
 int  ErrorStatusIsSevere();
 int  ErrorStatusIsError();
 int  ErrorStatusIsMinor();
@@ -11,6 +11,12 @@
  *      an output argument. A possible error condition is returned
  *      throught the function Error().
  *
+ *      An expression of literals and (not redefineable) constants
+ *      in a line read from a source file comes out the same on
+ *      every pass. Its value is remembered in the line's LineInfo
+ *      and used again until SymbolGetChangeStamp() tells that one
+ *      of the constants changed after all.
+ *
  *   Usage: char *evaluate(p, valuePtr)
  *      char     *p;
  *      Value   **valuePtr;
@@ -43,8 +49,15 @@
 #include "pila.h"
 #include "asm.h"
 #include "parse.h"
+#include "options.h"
+#include "procgraph.h"
 
 #include "safe-ctype.h"
+#include "libiberty.h"
+#include "obstack.h"
+
+#define obstack_chunk_alloc xmalloc
+#define obstack_chunk_free  free
 
 /* Largest number that can be represented in an unsigned int
    - MACHINE DEPENDENT */
@@ -83,6 +96,29 @@ typedef struct _StackEntry
   Operator operator;	// operator following the operand stored in value
 } StackEntry;
 
+// the value of an expression remembered for the next pass
+typedef struct _ExprCache
+{
+  struct _ExprCache *next;	// next expression of the same line
+  int        start;		// offset of the expression in the line
+  int        end;		// offset of the first character behind it
+  SymbolDef *proc;		// procedure the expression was evaluated in
+  long       stamp;		// SymbolGetChangeStamp() at that time
+  Value      value;
+} ExprCache;
+
+static PILA_STATE LineInfo     *evalLineInfo = NULL;	// line being assembled
+static PILA_STATE char         *evalLine = NULL;
+static PILA_STATE size_t        evalLineLength = 0;
+static PILA_STATE int           evalDepth = 0;		// nesting of evaluate()
+static PILA_STATE boolean       evalConst = false;	// nothing but constants so far
+static PILA_STATE struct obstack evalStack;
+static PILA_STATE boolean       evalStackInitialized = false;
+static PILA_STATE long          evalCacheLookups = 0;
+static PILA_STATE long          evalCacheHits = 0;
+
+static char *evaluateExpression(char *p, Value *valuePtr);
+
 char *evaluateOperand(char *p, Value *val)
 {
   long       base;
@@ -124,7 +160,7 @@ char *evaluateOperand(char *p, Value *val)
   else if (*p == '(')
   {
     /* Evaluate parenthesized expressions recursively */
-    p = evaluate(++p, val);
+    p = evaluateExpression(++p, val);
     if (!p || ErrorStatusIsSevere())
       return NULL;
     else if (*p!=')')
@@ -343,6 +379,7 @@ char *evaluateOperand(char *p, Value *val)
         c = *(p+3);
         if (!ISALNUM(c) && c!='.' && c!='_' && c!='$' && c!='?' && c!='@')
         {
+          evalConst = false;
           symbol = SymbolLookupTempLabel(*(p+1),*(p+2));
           if (!symbol)
           {
@@ -388,6 +425,7 @@ char *evaluateOperand(char *p, Value *val)
         {
           Error(UNDEFINED_SYMBOL,start);
           val->kind = symbolKindUndefined;
+          evalConst = false;
         }
         else
         {
@@ -417,6 +455,8 @@ char *evaluateOperand(char *p, Value *val)
     if (symbol)
     {
       SymbolCategory cat = SymbolGetCategory(val->kind);
+      if (cat!=symbolCategoryConst || SymbolGetRedefineable(symbol))
+        evalConst = false;
       if (cat==symbolCategoryNone || cat==symbolCategoryType)
       {
         // since the symbol can not be used in expressions, return error
@@ -428,6 +468,7 @@ char *evaluateOperand(char *p, Value *val)
     {
       Error(UNDEFINED_SYMBOL,symbolStart);
       val->kind = symbolKindUndefined;
+      evalConst = false;
       return p;
     }
   }
@@ -622,6 +663,9 @@ void doOperation(StackEntry *stackFirst, StackEntry *stackSecond)
         stackFirst->value.kind = stackSecond->value.kind;
       else if (cat2!=symbolCategoryConst && cat1!=cat2)
         Error(INV_VALUE_CATEGORY,NULL);
+      else if (cat2==symbolCategoryConst && OPTION(object) &&
+               (cat1==symbolCategoryCode || cat1==symbolCategoryData))
+        ; // still an address the linker has to relocate (see objfile.h)
       else
         stackFirst->value.kind = symbolKindConst;
       break;
@@ -722,7 +766,7 @@ void doOperation(StackEntry *stackFirst, StackEntry *stackSecond)
 }
 
 
-char *evaluate(char *p, Value *valuePtr)
+static char *evaluateExpression(char *p, Value *valuePtr)
 {
   StackEntry stack[MAX_EVAL_STACK];
   int        stackPtr = MAX_EVAL_STACK;
@@ -783,3 +827,93 @@ char *evaluate(char *p, Value *valuePtr)
   Error(EXPR_NESTED_TOO_DEEP,NULL);
   return NULL;
 }
+
+
+char *evaluate(char *p, Value *valuePtr)
+{
+  ExprCache *entry = NULL;
+  boolean    cacheable;
+  int        start = 0;
+  char      *end;
+
+  // Only the expressions starting in a line read from a source file
+  // are remembered, not the ones nested in a symbol (see ParseSymbol).
+  // While the references between procedures are noted, every symbol
+  // has to be looked up again.
+  cacheable = evalDepth==0 && evalLineInfo!=NULL &&
+              p>=evalLine && p<evalLine+evalLineLength &&
+              !ProcGraphIsRecording();
+  if (cacheable)
+  {
+    start = p-evalLine;
+    evalCacheLookups++;
+    for (entry = evalLineInfo->exprs; entry && entry->start!=start; entry = entry->next)
+      ;
+    if (entry && entry->proc==SymbolGetCurrentProc() &&
+        entry->stamp==SymbolGetChangeStamp())
+    {
+      evalCacheHits++;
+      *valuePtr = entry->value;
+      return evalLine+entry->end;
+    }
+  }
+
+  if (evalDepth==0)
+    evalConst = true;
+  evalDepth++;
+  end = evaluateExpression(p, valuePtr);
+  evalDepth--;
+
+  if (cacheable && end && evalConst && ErrorStatusIsOK() &&
+      SymbolGetCategory(valuePtr->kind)==symbolCategoryConst)
+  {
+    if (!entry)
+    {
+      if (!evalStackInitialized)
+      {
+        obstack_init(&evalStack);
+        evalStackInitialized = true;
+      }
+      entry = obstack_alloc(&evalStack, sizeof(ExprCache));
+      entry->start = start;
+      entry->next = evalLineInfo->exprs;
+      evalLineInfo->exprs = entry;
+    }
+    entry->end   = end-evalLine;
+    entry->proc  = SymbolGetCurrentProc();
+    entry->stamp = SymbolGetChangeStamp();
+    entry->value = *valuePtr;
+  }
+  return end;
+}
+
+
+void EvalSetLine(LineInfo *lineInfo, char *line)
+{
+  evalLineInfo   = lineInfo;
+  evalLine       = line;
+  evalLineLength = lineInfo ? strlen(line) : 0;
+}
+
+
+void EvalFlush()
+{
+  // the LineInfo arrays pointing to the entries are gone already
+  // (see SourceCacheFlush)
+  if (evalStackInitialized)
+    obstack_free(&evalStack, NULL);
+  evalStackInitialized = false;
+  evalLineInfo = NULL;
+  evalLine = NULL;
+  evalLineLength = 0;
+  evalDepth = 0;
+  evalCacheLookups = 0;
+  evalCacheHits = 0;
+}
+
+
+void EvalPrintStatistics(FILE *pfil)
+{
+  fprintf(pfil, "Expressions: %ld of %ld taken from the last pass\n",
+          evalCacheHits, evalCacheLookups);
+}
@@ -20,51 +20,83 @@
 #include "libiberty.h"
 #include "expand.h"
 
+/*
+ * The expanded lines are kept in two buffers that are reused for the whole
+ * run: expandText holds the text of all lines back to back and expandLines
+ * holds the offset and length of each line. Lines added while another
+ * expanded line is processed form a new group that has to be read before
+ * the rest of the group that is being read. So the groups are kept as a
+ * stack (expandGroups) and the lines of the topmost group are always at
+ * the end of both buffers. When a group has been read completely it is
+ * simply cut off again.
+ */
+
 // Expanded Line
 typedef struct _ExpandLine
 {
-    struct _ExpandLine *next;
-    char *line;
-	int  capacity;
+  size_t offset;	// offset of the line's text in expandText
+  size_t length;	// length of the line's text
 } ExpandLine;
 
-typedef struct _Expand
+// Group of lines added in one go (its lines go up to the end of expandLines
+// as long as it is the topmost group)
+typedef struct _ExpandGroup
 {
-  struct _Expand *next;
-  ExpandLine     *firstLine;
-  ExpandLine     *lastLine;
-} Expand;
+  size_t firstLine;	// index of the group's first line in expandLines
+  size_t nextLine;	// index of the next line to be read
+} ExpandGroup;
+
+PILA_STATE char  *sourceLine = NULL;		/* source line buffer */
+PILA_STATE size_t sourceLineCapacity = 0;	/* source line buffer length */
+
+PILA_STATE char        *expandText = NULL;		/* text of all expanded lines */
+PILA_STATE size_t       expandTextLength = 0;
+PILA_STATE size_t       expandTextCapacity = 0;
+
+PILA_STATE ExpandLine  *expandLines = NULL;	/* all expanded lines */
+PILA_STATE size_t       expandLineCount = 0;
+PILA_STATE size_t       expandLineCapacity = 0;
+
+PILA_STATE ExpandGroup *expandGroups = NULL;	/* stack of line groups */
+PILA_STATE size_t       expandGroupCount = 0;
+PILA_STATE size_t       expandGroupCapacity = 0;
 
-char  *sourceLine = NULL;		/* source line buffer */
-int    sourceLineCapacity = 0;	/* source line buffer length */
+PILA_STATE boolean      expandGroupOpen = false;	/* can lines be added to the top group? */
+PILA_STATE boolean      expandLineOpen = false;	/* can text be added to the last line? */
 
-Expand *pExpandStack = NULL;
-int    ExpandLineNum = 0;
+PILA_STATE int    ExpandLineNum = 0;
 
 
-void ConcatString(char **target,int *targetCapacity,char *source)
+/* makes sure *buffer has room for needed elements of the given size */
+static void *ExpandReserve(void *buffer,size_t *capacity,size_t needed,size_t elementSize)
 {
-	char *aux = *target;
-	int  len = strlen(source);
+  if (needed>*capacity)
+  {
+    *capacity = *capacity ? 2*(*capacity) : 64;
+    if (*capacity<needed)
+      *capacity = needed;
+    buffer = xrealloc(buffer,*capacity*elementSize);
+  }
+  return buffer;
+}
 
-	if (!aux)
-	{
-		*targetCapacity = len<81 ? 81 : len+1;
-		*target = xmalloc(*targetCapacity);
-		strcpy(*target,source);
-	}
-	else
-	{
-		len += strlen(aux);
-		if (len<*targetCapacity)
-			strcat(aux,source);
-		else
-		{
-			*targetCapacity += len-*targetCapacity+1;
-			*target = xrealloc(aux,*targetCapacity);
-			strcat(*target,source);
-		}
-	}
+void ExpandFlush()
+{
+  free(sourceLine);
+  free(expandText);
+  free(expandLines);
+  free(expandGroups);
+  sourceLine         = NULL;
+  sourceLineCapacity = 0;
+  expandText         = NULL;
+  expandTextLength   = expandTextCapacity  = 0;
+  expandLines        = NULL;
+  expandLineCount    = expandLineCapacity  = 0;
+  expandGroups       = NULL;
+  expandGroupCount   = expandGroupCapacity = 0;
+  expandGroupOpen    = false;
+  expandLineOpen     = false;
+  ExpandLineNum      = 0;
 }
 
 int ExpandGetLineNum()
@@ -74,34 +106,33 @@ int ExpandGetLineNum()
 
 char *ExpandGetLine() // returns pointer to next sourceline
 {
-  if (pExpandStack!=NULL)
+  if (expandGroupCount>0)
   {
-    ExpandLine *expLine;
-
-    // Disable any further additions to THIS Expand. Any newly
-    // created Expand lines will now create a new Expand.
-    pExpandStack->lastLine = NULL;
-    
-    expLine = pExpandStack->firstLine;
-    pExpandStack->firstLine = pExpandStack->firstLine->next;
-	if (sourceLine)
-		*sourceLine = '\0';
-	ConcatString(&sourceLine,&sourceLineCapacity,expLine->line);
-    free(expLine->line);
-	free(expLine);
-    
-    if (pExpandStack->firstLine==NULL)
+    ExpandGroup *group = &expandGroups[expandGroupCount-1];
+    ExpandLine  *line  = &expandLines[group->nextLine++];
+
+    // Disable any further additions to THIS group. Any newly
+    // created lines will now create a new group.
+    expandGroupOpen = false;
+    expandLineOpen  = false;
+
+    sourceLine = ExpandReserve(sourceLine,&sourceLineCapacity,line->length+1,1);
+    memcpy(sourceLine,expandText+line->offset,line->length);
+    sourceLine[line->length] = '\0';
+
+    if (group->nextLine==expandLineCount)
     {
-      Expand *exp = pExpandStack;
-      pExpandStack = pExpandStack->next;
-      free(exp);
+      // the group is done - cut its lines off again
+      expandTextLength = expandLines[group->firstLine].offset;
+      expandLineCount  = group->firstLine;
+      expandGroupCount--;
     }
     ExpandLineNum++;
   }
   else
   {
 	  ExpandLineNum = 0;
-	  if (getline(&sourceLine,&sourceLineCapacity,gpsseCur->pfil)<0)
+	  if (SourceCacheReadLine(gpsseCur->psrc,gpsseCur->iLineNum,&sourceLine,&sourceLineCapacity)<0)
 		  return NULL;
 	  else
 		  gpsseCur->iLineNum++;
@@ -111,42 +142,43 @@ char *ExpandGetLine() // returns pointer to next sourceline
 
 void ExpandString(char *string)
 {
-	Expand    *exp = pExpandStack;
-	ExpandLine *expLine;
-	
-	if (exp==NULL || exp->lastLine==NULL)
+	size_t      length = strlen(string);
+	ExpandGroup *group;
+	ExpandLine  *line;
+
+	if (!expandGroupOpen)
 	{
-		exp = xmalloc((size_t)sizeof(Expand));
-		exp->next = pExpandStack;
-		pExpandStack = exp;
-
-		exp->firstLine = xmalloc((size_t)sizeof(ExpandLine));
-		exp->firstLine->next = NULL;
-		exp->firstLine->line = NULL;
-		exp->firstLine->capacity = 0;
-		exp->lastLine  = exp->firstLine;
+		// start a new group on top of the stack
+		expandGroups = ExpandReserve(expandGroups,&expandGroupCapacity,
+		                             expandGroupCount+1,sizeof(ExpandGroup));
+		group = &expandGroups[expandGroupCount++];
+		group->firstLine = expandLineCount;
+		group->nextLine  = expandLineCount;
+		expandGroupOpen  = true;
+		expandLineOpen   = false;
 	}
-	
-	// now we have a pointer to an Expand (in exp)
-	// with a lastLine pointer that is not NULL and it
-	// is pointing to the line that we have filled so far.
-	expLine = exp->lastLine;
-	
-	// does that line exist and has already been completed?
-	if (expLine->line && strchr(expLine->line,'\n')!=NULL)
+
+	if (!expandLineOpen)
 	{
-		// then we have to allocate a new line that will
-		// absorb the string that was passed in.
-		expLine = xmalloc((size_t)sizeof(ExpandLine));
-		expLine->next = NULL;
-		expLine->line = NULL;
-		expLine->capacity = 0;
-		exp->lastLine->next = expLine;
-		exp->lastLine = expLine;
+		// the last line was completed already (or there is none)
+		// so we need a new line to absorb the string
+		expandLines = ExpandReserve(expandLines,&expandLineCapacity,
+		                            expandLineCount+1,sizeof(ExpandLine));
+		line = &expandLines[expandLineCount++];
+		line->offset   = expandTextLength;
+		line->length   = 0;
+		expandLineOpen = true;
 	}
 
-	// now copy the string into the ExpandLine we have in expLine
-	ConcatString(&(expLine->line),&(expLine->capacity),string);
+	// now append the string to the last line
+	line = &expandLines[expandLineCount-1];
+	expandText = ExpandReserve(expandText,&expandTextCapacity,expandTextLength+length,1);
+	memcpy(expandText+expandTextLength,string,length);
+	expandTextLength += length;
+	line->length     += length;
+
+	if (memchr(string,'\n',length)!=NULL)
+		expandLineOpen = false;
 }
 
 
@@ -16,6 +16,7 @@
 #ifndef _EXPAND_H_
 #define _EXPAND_H_
 
+void  ExpandFlush();
 int   ExpandGetLineNum();
 char *ExpandGetLine();
 void  ExpandString(char *string);
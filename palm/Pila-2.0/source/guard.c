@@ -10,10 +10,13 @@
  *      messages on pass 3 since it is evaluated via trial and
  *      error).
  *
- *      The information is stored in a special symbol. The symbol's
- *      name is built from the current filename, the line number of
- *      the currently processed source line, the number of the
- *      current expand line and a passed in sub-id.
+ *      The information is stored with the source file the line belongs
+ *      to (see srccache.h). All guards of a file are kept in one vector
+ *      and each source line knows where its guards start in there. A
+ *      guard is identified by the number of the current expand line and
+ *      a passed in sub-id. Guards are only created on pass 1 when the
+ *      lines of a file are processed in order, so the guards of a line
+ *      are always next to each other.
  *
  *      Change Log:
  *
@@ -23,32 +26,115 @@
  *********************************************************************/
 #include "pila.h"
 #include "asm.h"
-#include "symbol.h"
 #include "expand.h"
+#include "libiberty.h"
 
-extern int giPass;
+extern PILA_STATE int giPass;
+
+typedef struct _GuardEntry
+{
+  int  expandLine;	// ExpandGetLineNum() of the guarded line
+  int  subId;		// sub-id passed in by the caller
+  long value;		// remembered value
+} GuardEntry;
+
+typedef struct _GuardLine
+{
+  int first;		// index of the first guard of the line in file->guards
+  int count;		// number of guards of the line
+} GuardLine;
+
+
+/* Builds the name of a guard for error messages */
+static char *GuardName(char *buffer,int subId)
+{
+  sprintf(buffer,":guard:%.400s:%d:%d:%d",gpsseCur->szFile,gpsseCur->iLineNum,ExpandGetLineNum(),subId);
+  return buffer;
+}
+
+/* Returns the guard entry of the current line for subId (or NULL) */
+static GuardEntry *GuardFind(SourceFile *file,GuardLine *line,int subId)
+{
+  int expandLine = ExpandGetLineNum();
+  GuardEntry *entry = file->guards+line->first;
+  int i;
+
+  for (i=0; i<line->count; i++, entry++)
+    if (entry->expandLine==expandLine && entry->subId==subId)
+      return entry;
+  return NULL;
+}
+
+/* Returns the guard index of the current line (NULL if there is none yet) */
+static GuardLine *GuardGetLine(boolean create)
+{
+  SourceFile *file = gpsseCur->psrc;
+
+  if (!file->guardLines)
+  {
+    if (!create)
+      return NULL;
+    file->guardLines = xcalloc(file->lineCount,sizeof(GuardLine));
+  }
+  return &file->guardLines[gpsseCur->iLineNum-1];
+}
+
+/* Adds a guard for the current line */
+static void GuardAdd(SourceFile *file,GuardLine *line,int subId,long value)
+{
+  GuardEntry *entry;
+
+  if (file->guardCount+line->count >= file->guardCapacity)
+  {
+    file->guardCapacity = file->guardCapacity ? 2*file->guardCapacity : 256;
+    file->guards = xrealloc(file->guards,file->guardCapacity*sizeof(GuardEntry));
+  }
+
+  // the guards of a line have to stay together
+  if (line->count==0)
+    line->first = file->guardCount;
+  else if (line->first+line->count!=file->guardCount)
+  {
+    memcpy(file->guards+file->guardCount,file->guards+line->first,line->count*sizeof(GuardEntry));
+    line->first = file->guardCount;
+    file->guardCount += line->count;
+  }
+
+  entry = file->guards+line->first+line->count;
+  entry->expandLine = ExpandGetLineNum();
+  entry->subId      = subId;
+  entry->value      = value;
+  line->count++;
+  file->guardCount++;
+}
 
 boolean Guard(long value,int subId)
 {
   boolean ret = false;
   if (giPass)
   {
-    SymbolDef *symbol;
+    SourceFile *file = gpsseCur->psrc;
+    GuardLine  *line = GuardGetLine(giPass<2);
+    GuardEntry *entry = line ? GuardFind(file,line,subId) : NULL;
     char guardId[512];
-    sprintf(guardId,":guard:%s:%d:%d:%d",gpsseCur->szFile,gpsseCur->iLineNum,ExpandGetLineNum(),subId);
+
     if (giPass<2)
-      SymbolCreate(guardId,symbolKindGuard,NULL,value);
+    {
+      if (entry)
+        entry->value = value;
+      else
+        GuardAdd(file,line,subId,value);
+    }
     else
     {
-      symbol = SymbolLookup(guardId);
-      if (!symbol)
+      if (!entry)
       {
-        Error(INTERNAL_ERROR_GUARD_NOT_DEF,guardId);
+        Error(INTERNAL_ERROR_GUARD_NOT_DEF,GuardName(guardId,subId));
         ret = true;
       }
-      else if (SymbolGetValue(symbol)!=value)
+      else if (entry->value!=value)
       {
-        Error(GUARD_ERROR,guardId);
+        Error(GUARD_ERROR,GuardName(guardId,subId));
         ret = true;
       }
     }
@@ -56,21 +142,28 @@ boolean Guard(long value,int subId)
   return ret;
 }
 
+long GuardPeek(int subId,long notFound)
+{
+  GuardLine  *line = GuardGetLine(false);
+  GuardEntry *entry = line ? GuardFind(gpsseCur->psrc,line,subId) : NULL;
+
+  return entry ? entry->value : notFound;
+}
+
 long GuardGet(int subId)
 {
   long ret = 0;
-  SymbolDef *symbol;
+  GuardLine  *line = GuardGetLine(false);
+  GuardEntry *entry = line ? GuardFind(gpsseCur->psrc,line,subId) : NULL;
   char guardId[512];
   
-  sprintf(guardId,":guard:%s:%d:%d:%d",gpsseCur->szFile,gpsseCur->iLineNum,ExpandGetLineNum(),subId);
-  symbol = SymbolLookup(guardId);
-  if (!symbol)
+  if (!entry)
   {
     ret = 0;
-    Error(INTERNAL_ERROR_GUARD_NOT_DEF,guardId);
+    Error(INTERNAL_ERROR_GUARD_NOT_DEF,GuardName(guardId,subId));
   }
   else
-    ret = SymbolGetValue(symbol);
+    ret = entry->value;
 
   return ret;
 }
@@ -1,4 +1,16 @@
 /**********************************************************
+ *
+ *  Guard(value,subId)
+ *    On pass 1 remembers value for the current source line.
+ *    On pass 2 reports an error (and returns true) if value
+ *    differs from what was remembered.
+ *
+ *  GuardGet(subId)
+ *    Returns the remembered value (error if there is none).
+ *
+ *  GuardPeek(subId,notFound)
+ *    Returns the remembered value or notFound if there is
+ *    none (i.e. on the first run of pass 1).
  *
  **********************************************************/
 
@@ -16,5 +28,6 @@
 
 boolean Guard(long value,int subId);
 long    GuardGet(int subId);
+long    GuardPeek(int subId,long notFound);
 
 #endif // __GUARD_H__
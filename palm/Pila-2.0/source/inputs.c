@@ -0,0 +1,170 @@
+/**********************************************************************************
+ *
+ *      INPUTS.C
+ *
+ *      The list of files read by the current assembly.
+ *
+ *      See inputs.h for a description of the functions.
+ *
+ *********************************************************************************/
+
+#include "pila.h"
+#include "libiberty.h"
+#include "inputs.h"
+
+#define INPUT_READ_CHUNK 0x10000
+
+typedef struct _Input
+{
+  struct _Input *next;
+  char          *name;
+  InputHash      hash;
+  long           size;
+} Input;
+
+static PILA_STATE Input  *inputFirst = NULL;	// files in the order they were read
+static PILA_STATE Input **inputLast  = NULL;	// where the next one goes (NULL: &inputFirst)
+
+
+InputHash InputHashData(InputHash hash, void *data, long size)
+{
+  unsigned char *pb = (unsigned char *)data;
+
+  while (size-- > 0)
+  {
+    hash ^= *pb++;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+
+boolean InputHashFile(char *fileName, InputHash *hash, long *size)
+{
+  unsigned char *buffer;
+  FILE          *pfil;
+  size_t         cb;
+
+  pfil = fopen(fileName, "rb");
+  if (pfil == NULL)
+    return false;
+
+  buffer = xmalloc(INPUT_READ_CHUNK);
+  *hash = INPUT_HASH_INIT;
+  *size = 0;
+  while ((cb = fread(buffer, 1, INPUT_READ_CHUNK, pfil)) > 0)
+  {
+    *hash = InputHashData(*hash, buffer, cb);
+    *size += cb;
+  }
+  free(buffer);
+  fclose(pfil);
+  return true;
+}
+
+
+static boolean InputIsRecorded(char *fileName)
+{
+  Input *input;
+
+  for (input = inputFirst; input; input = input->next)
+    if (strcmp(input->name, fileName) == 0)
+      return true;
+  return false;
+}
+
+
+static void InputAdd(char *fileName, InputHash hash, long size)
+{
+  Input *input = xmalloc(sizeof(Input));
+
+  input->next = NULL;
+  input->name = xstrdup(fileName);
+  input->hash = hash;
+  input->size = size;
+  if (!inputLast)
+    inputLast = &inputFirst;
+  *inputLast = input;
+  inputLast = &input->next;
+}
+
+
+void InputRecord(char *fileName, void *data, long size)
+{
+  if (!InputIsRecorded(fileName))
+    InputAdd(fileName, InputHashData(INPUT_HASH_INIT, data, size), size);
+}
+
+
+void InputRecordHash(char *fileName, InputHash hash, long size)
+{
+  if (!InputIsRecorded(fileName))
+    InputAdd(fileName, hash, size);
+}
+
+
+void InputRecordFile(char *fileName)
+{
+  InputHash hash;
+  long      size;
+
+  if (!InputIsRecorded(fileName) && InputHashFile(fileName, &hash, &size))
+    InputAdd(fileName, hash, size);
+}
+
+
+void InputForEach(void (*fn)(char *fileName, InputHash hash, long size, void *data),
+                  void *data)
+{
+  Input *input;
+
+  for (input = inputFirst; input; input = input->next)
+    fn(input->name, input->hash, input->size, data);
+}
+
+
+/* writes a file name the way make wants it */
+static void InputWriteName(FILE *pfil, char *fileName)
+{
+  char *pch;
+
+  for (pch = fileName; *pch; pch++)
+  {
+    if (*pch == '$')
+      fputc('$', pfil);
+    else if (*pch == ' ' || *pch == '#')
+      fputc('\\', pfil);
+    fputc(*pch, pfil);
+  }
+}
+
+
+boolean InputWriteDepends(FILE *pfil, char *target)
+{
+  Input *input;
+
+  InputWriteName(pfil, target);
+  fputc(':', pfil);
+  for (input = inputFirst; input; input = input->next)
+  {
+    fputs(" \\\n  ", pfil);
+    InputWriteName(pfil, input->name);
+  }
+  fputc('\n', pfil);
+  return !ferror(pfil);
+}
+
+
+void InputFlush()
+{
+  Input *input;
+
+  while (inputFirst)
+  {
+    input = inputFirst;
+    inputFirst = input->next;
+    free(input->name);
+    free(input);
+  }
+  inputLast = NULL;
+}
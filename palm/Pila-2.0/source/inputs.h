@@ -0,0 +1,59 @@
+/**********************************************************************************
+ *
+ *      INPUTS.H
+ *
+ *      Keeps track of every file an assembly reads (source and include files,
+ *      resource and incbin files, precompiled includes) together with a hash
+ *      of its contents. The build cache (see cache.h) uses this to find out
+ *      whether an earlier result is still good.
+ *
+ *      InputRecord(char *fileName, void *data, long size)
+ *        Notes that the assembly read fileName, whose contents are the size
+ *        bytes at data. Files already noted are ignored.
+ *
+ *      InputRecordHash(char *fileName, InputHash hash, long size)
+ *        Same for a file whose hash is already known (from an earlier
+ *        assembly).
+ *
+ *      InputRecordFile(char *fileName)
+ *        Same for a file that was not read as a whole. The file is read
+ *        again to compute its hash.
+ *
+ *      InputForEach(void (*fn)(char *fileName, InputHash hash, long size, void *data), void *data)
+ *        Calls fn for every file noted since the last InputFlush, in the
+ *        order they were first read.
+ *
+ *      InputWriteDepends(FILE *pfil, char *target)
+ *        Writes a make rule to pfil that says target depends on all the
+ *        files noted. Returns false if it could not be written.
+ *
+ *      InputFlush()
+ *        Forgets about all files noted so far.
+ *
+ *      InputHashData(InputHash hash, void *data, long size)
+ *        Continues hash (start with INPUT_HASH_INIT) over size bytes of
+ *        data (64 bit FNV-1a) and returns the result.
+ *
+ *      InputHashFile(char *fileName, InputHash *hash, long *size)
+ *        Hashes the contents of a file. Returns false if it can't be read.
+ *
+ *********************************************************************************/
+
+#ifndef _INPUTS_H_
+#define _INPUTS_H_
+
+typedef unsigned long long InputHash;
+
+#define INPUT_HASH_INIT 14695981039346656037ULL
+
+void      InputRecord(char *fileName, void *data, long size);
+void      InputRecordHash(char *fileName, InputHash hash, long size);
+void      InputRecordFile(char *fileName);
+void      InputForEach(void (*fn)(char *fileName, InputHash hash, long size, void *data),
+                       void *data);
+boolean   InputWriteDepends(FILE *pfil, char *target);
+void      InputFlush();
+InputHash InputHashData(InputHash hash, void *data, long size);
+boolean   InputHashFile(char *fileName, InputHash *hash, long *size);
+
+#endif
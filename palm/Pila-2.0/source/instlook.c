@@ -8,8 +8,8 @@
  *      table. The input to the function is a pointer to the
  *      instruction on a line of assembly code. The routine
  *      scans the instruction and notes the size code if
- *      present. It then (binary) searches the instruction
- *      table for the specified opcode. If it finds the opcode,
+ *      present. It then looks the opcode up in a perfect hash
+ *      table built over the instruction table. If it finds the opcode,
  *      it returns a pointer to the instruction table entry for
  *      that instruction (via the instPtrPtr argument) as well
  *      as the size code or 0 if no size was specified (via the
@@ -26,6 +26,14 @@
  *      INV_OPCODE
  *      INV_SIZE_CODE
  *
+ *    Function: instFind()
+ *      Looks up a mnemonic (case insensitive) without any size
+ *      code and returns its instruction table entry or NULL.
+ *      Used by DirectiveContinuation() to recognize directives.
+ *
+ *   Usage: instruction *instFind(mnemonic)
+ *      char *mnemonic;
+ *
  *      Author: Paul McKee
  *      ECE492    North Carolina State University
  *
@@ -36,6 +44,9 @@
  *      07/23/2003 Frank Schaeckermann (frmipg602@sneakemail.com)
  *                 Changes for Pila Version 2.0
  *
+ *                 Replaced the binary search by a perfect hash
+ *                 table that is built on the first lookup
+ *
  ************************************************************************/
 
 
@@ -45,14 +56,123 @@
 #include "safe-ctype.h"
 
 extern instruction instTable[];
-extern int tableSize;
+extern short int tableSize;
+
+
+/*
+ * The hash table is built from instTable on the first lookup (hash and
+ * displace): every mnemonic is first put into one of INST_BUCKETS buckets.
+ * Then the buckets are placed into the table - the ones with the most
+ * mnemonics first - by searching a displacement (seed for the second hash)
+ * per bucket that moves all its mnemonics to free slots. A lookup
+ * therefore takes two hashes and exactly one string compare.
+ */
+#define INST_BUCKETS	128	// must be a power of two
+#define INST_SLOTS	512	// must be a power of two and >= tableSize
+
+static PILA_STATE unsigned short instDisplacement[INST_BUCKETS];
+static PILA_STATE short          instSlot[INST_SLOTS];	// index into instTable or -1
+static PILA_STATE boolean        instHashBuilt = false;
+
+
+/* case insensitive FNV-1a of the mnemonic, seeded with seed */
+static unsigned long instHash(char *mnemonic, unsigned seed)
+{
+    unsigned long hash = (2166136261UL ^ (seed*0x9E3779B9UL)) & 0xffffffffUL;
+
+    while (*mnemonic)
+    {
+        hash ^= (unsigned char)TOUPPER(*mnemonic++);
+        hash  = (hash*16777619UL) & 0xffffffffUL;
+    }
+    hash ^= hash >> 15;
+    hash  = (hash*0x2C1B3C6DUL) & 0xffffffffUL;
+    hash ^= hash >> 12;
+    return hash;
+}
+
+
+static void instHashBuild(void)
+{
+    short bucketOf[INST_SLOTS];
+    short bucketSize[INST_BUCKETS];
+    short order[INST_BUCKETS];
+    int   i, j, k, b, slot, count;
+
+    for (i = 0; i < INST_SLOTS; i++)
+        instSlot[i] = -1;
+    for (b = 0; b < INST_BUCKETS; b++)
+    {
+        bucketSize[b] = 0;
+        order[b] = b;
+    }
+    for (i = 0; i < tableSize; i++)
+    {
+        bucketOf[i] = instHash(instTable[i].mnemonic, 0) & (INST_BUCKETS-1);
+        bucketSize[bucketOf[i]]++;
+    }
+
+    // biggest buckets first (insertion sort - there are only a few of them)
+    for (i = 1; i < INST_BUCKETS; i++)
+        for (j = i; j > 0 && bucketSize[order[j]] > bucketSize[order[j-1]]; j--)
+        {
+            b = order[j]; order[j] = order[j-1]; order[j-1] = b;
+        }
+
+    for (k = 0; k < INST_BUCKETS && bucketSize[order[k]] > 0; k++)
+    {
+        b = order[k];
+        for (instDisplacement[b] = 1; instDisplacement[b] != 0; instDisplacement[b]++)
+        {
+            // try to place all mnemonics of the bucket with this displacement
+            count = 0;
+            for (i = 0; i < tableSize; i++)
+                if (bucketOf[i] == b)
+                {
+                    slot = instHash(instTable[i].mnemonic, instDisplacement[b]) & (INST_SLOTS-1);
+                    if (instSlot[slot] != -1)
+                        break;
+                    instSlot[slot] = i;
+                    count++;
+                }
+            if (count == bucketSize[b])
+                break;
+
+            // collision - take back what was placed already
+            for (j = 0; j < i; j++)
+                if (bucketOf[j] == b)
+                    instSlot[instHash(instTable[j].mnemonic, instDisplacement[b]) & (INST_SLOTS-1)] = -1;
+        }
+        if (instDisplacement[b] == 0)
+        {
+            fprintf(stderr, "internal error - unable to build the instruction hash table\n");
+            exit(1);
+        }
+    }
+    instHashBuilt = true;
+}
+
+
+instruction *instFind(char *mnemonic)
+{
+    int slot;
+
+    if (!instHashBuilt)
+        instHashBuild();
+
+    slot = instSlot[instHash(mnemonic, instDisplacement[instHash(mnemonic, 0) & (INST_BUCKETS-1)])
+                    & (INST_SLOTS-1)];
+    if (slot >= 0 && strcmpi(mnemonic, instTable[slot].mnemonic) == 0) // opcodes aren't case sensitive
+        return &instTable[slot];
+    return NULL;
+}
 
 
 char *instLookup(char *p, instruction **instPtrPtr, char *sizePtr)
 {
     char opcode[MNEMONIC_SIZE];
     int ch;
-    int i, hi, lo, mid, cmp;
+    int i;
 
     /*  printf("InstLookup: Input string is \"%s\"\n", p); */
     i = 0;
@@ -91,27 +211,12 @@ char *instLookup(char *p, instruction **instPtrPtr, char *sizePtr)
         *sizePtr = 0;
     }
 
-    lo = 0;
-    hi = tableSize - 1;
-    do {
-        mid = (hi + lo) / 2;
-        cmp = strcmpi(opcode, instTable[mid].mnemonic); // opcodes aren't case sensitive
-        if (cmp > 0) {
-            lo = mid + 1;
-        } else if (cmp < 0) {
-            hi = mid - 1;
-        }
-    } while (cmp && (hi >= lo));
-
-    if (!cmp) {
-        *instPtrPtr = &instTable[mid];
+    *instPtrPtr = instFind(opcode);
+    if (*instPtrPtr) {
         return p;
     } else {
         Error(INV_OPCODE,opcode);
         return NULL;
     }
-
-    return NORMAL;
-
 }
 
@@ -34,8 +34,9 @@
      The procedure which instLookup() and assemble() use to look up
 and verify an instruction (or directive) is as follows. Once the
 mnemonic of the instruction has been parsed and stripped of its size
-code and trailing spaces, the instLookup() does a binary search on the
-instruction table to determine if the mnemonic is present. If it is
+code and trailing spaces, the instLookup() looks it up in a perfect
+hash table (built over the instruction table on the first call) to
+determine if the mnemonic is present. If it is
 not found, then the INV_OPCODE error results. If the mnemonic is
 found, then assemble() examines the field parseFlag for that entry.
 This flag is true if the mnemonic represents a normal instruction that
@@ -845,6 +846,7 @@ instruction instTable[] = {
     { "SBCD", sbcdfl, flavorCount(sbcdfl), true, NULL},
     { "SCC", sccfl, flavorCount(sccfl), true, NULL},
     { "SCS", scsfl, flavorCount(scsfl), true, NULL},
+    { "SEGMENT", NULL, 0, false, SegmentDirective}, // start the next code segment
     { "SEQ", seqfl, flavorCount(seqfl), true, NULL},
 
     { "SET", NULL, 0, false, set}, // define re-defineable symbol
@@ -0,0 +1,366 @@
+/**********************************************************************************
+ *
+ *      LIBPILA.C
+ *
+ *      The assembler's global state and PilaAssemble, which runs one
+ *      assembly from start to finish (see libpila.h).
+ *
+ *********************************************************************************/
+
+#include "pila.h"
+#include "asm.h"
+#include "prc.h"
+#include "safe-ctype.h"
+#include "libiberty.h"
+#include "directiv.h"
+#include "expand.h"
+#include "pch.h"
+#include "inputs.h"
+#include "segment.h"
+#include "objfile.h"
+#include "procgraph.h"
+#include "cache.h"
+#include "libpila.h"
+
+#define _NO_EXTERN_GLOBAL_OPTIONS
+#include "options.h"
+
+PILA_STATE char   gszAppName[dmDBNameLength] = "";		/* application name from APPL directive */
+PILA_STATE FourCC gfcPrcType = MAKE4CC('a','p','p','l');	/* database type, default is 'appl' */
+PILA_STATE options globalOptions;			/* options of the current assembly */
+
+char *pilafilename = NULL;	/* name pila was started with (used to find the includes) */
+
+PILA_STATE long gulOutLoc;     /* The assembler's location counter */
+PILA_STATE int giPass;         /* Counter telling what pass we are on (0, 1 or 2) */
+PILA_STATE int giPassRun;      /* Number of passes run so far (pass 1 may be repeated) */
+PILA_STATE boolean endFlag;    /* Flag set when the END directive is encountered */
+
+//
+//
+//
+
+PILA_STATE BlockType gbt;
+PILA_STATE unsigned char *gpbCode;
+PILA_STATE long gulCodeLoc;
+PILA_STATE long gulCodeBase;
+
+PILA_STATE unsigned char *gpbData;
+PILA_STATE long gulDataLoc;
+
+PILA_STATE unsigned char *gpbResource;
+PILA_STATE long gulResLoc;
+PILA_STATE unsigned long gfcResType;
+PILA_STATE long gidRes;
+PILA_STATE long gcbResTotal;
+
+PILA_STATE unsigned char *gpbOutput;
+
+PILA_STATE FILE *gpfilMsg;     /* where messages are printed */
+
+
+PilaContext *PilaCreateContext()
+{
+    return (PilaContext *)xcalloc(1, sizeof(PilaContext));
+}
+
+
+static void PilaFreeResults(PilaContext *ctx)
+{
+    FILE *pfilMsg = ctx->pfilMsg, *pfilDepends = ctx->pfilDepends;
+
+    free(ctx->pbPrc);
+    free(ctx->pbCode);
+    free(ctx->pbData);
+    memset(ctx, 0, sizeof(PilaContext));
+    ctx->pfilMsg = pfilMsg;
+    ctx->pfilDepends = pfilDepends;
+}
+
+
+void PilaDestroyContext(PilaContext *ctx)
+{
+    if (ctx) {
+        PilaFreeResults(ctx);
+        free(ctx);
+    }
+}
+
+
+static void PilaSetErrors(PilaContext *ctx)
+{
+    sprintf(ctx->szErrors, "%d error%s, %d warning%s\n",
+            ctx->cErrors,   (ctx->cErrors!= 1)  ? "s" : "",
+            ctx->cWarnings, (ctx->cWarnings!=1) ? "s" : "");
+}
+
+
+/* copies the messages collected in pfilFrom to pfilTo */
+static void PilaCopyMessages(FILE *pfilFrom, FILE *pfilTo)
+{
+    char   buffer[4096];
+    size_t cb;
+
+    rewind(pfilFrom);
+    while ((cb = fread(buffer, 1, sizeof(buffer), pfilFrom)) > 0) {
+        fwrite(buffer, 1, cb, pfilTo);
+    }
+}
+
+
+/* assembles fileName into outName (and the listing lisName if not NULL) */
+static int PilaRun(PilaContext *ctx, char *fileName, char *outName, char *lisName)
+{
+    extern PILA_STATE long gcbDataCompressed;
+    boolean fFailed;
+
+    // Nothing may be left over from an earlier assembly in this thread.
+    gszAppName[0] = 0;
+    gfcResType = 0;
+    gidRes = 0;
+    gcbResTotal = 0;
+    gpbCode = gpbData = gpbResource = gpbOutput = NULL;
+    ErrorInitialize();
+    DirectiveInitialize();
+    BranchResetStatistics();
+    PrcInitialize();
+    InputFlush();
+    SegmentFlush();
+    ObjectFlush();
+    ProcGraphFlush();
+
+    if (lisName && !ListInitialize(lisName)) {
+        return -1;
+    }
+
+    /* Assemble the file */
+    SymbolInitialize();
+    SymbolRecordMisses(OPTION(precompile));
+    if (processFile(fileName) != NORMAL) {
+        SourceCacheFlush();
+        EvalFlush();
+        PchFlush();
+        ExpandFlush();
+        ListClose("");
+        SymbolTerminate();
+        SegmentFlush();
+        ObjectFlush();
+        ProcGraphFlush();
+        free(gpbCode);
+        free(gpbData);
+        free(gpbResource);
+        gpbCode = gpbData = gpbResource = gpbOutput = NULL;
+        return -1;
+    }
+
+    if (OPTION(verbose) || OPTION(statistics)) {
+        long cbCached, cLinesCached;
+
+        SourceCacheGetStats(&cbCached, &cLinesCached);
+        fprintf(gpfilMsg, "Source cache: %ld lines (%ld bytes) served from memory\n",
+                cLinesCached, cbCached);
+    }
+    if (OPTION(statistics)) {
+        SymbolPrintStatistics(gpfilMsg);
+        BranchPrintStatistics(gpfilMsg);
+        EvalPrintStatistics(gpfilMsg);
+    }
+    if (OPTION(gc_procs)) {
+        ProcGraphPrintStatistics(gpfilMsg);
+    }
+    if (ErrorGetSuppressedCount() > 0) {
+        fprintf(gpfilMsg, "%d repeated warning%s not shown (--warn-limit)\n",
+                ErrorGetSuppressedCount(), ErrorGetSuppressedCount()!=1 ? "s" : "");
+    }
+    SourceCacheFlush();
+    EvalFlush();
+    PchFlush();
+    ExpandFlush();
+
+    // Get the resource total before MakePrc adds in the code and data
+    // resources.
+    ctx->cbRes = gcbResTotal;
+
+    // If no errors, make the PRC (or the object file).
+    fFailed = false;
+    if (OPTION(precompile)) {
+        // A precompiled include only brings symbols along, so whatever the
+        // file generates would be missing when the image is used.
+        if (ErrorGetErrorCount()==0 && (gulCodeLoc || gulDataLoc || gcbResTotal)) {
+            fputs("A precompiled include file must not generate code, data or resources\n", gpfilMsg);
+            fFailed = true;
+        } else if (ErrorGetErrorCount()==0 && !OPTION(depends_only)) {
+            ctx->cSymbols = PchWrite(outName, fileName);
+            if (ctx->cSymbols < 0) {
+                fprintf(gpfilMsg, "Failed to write %s\n", outName);
+                fFailed = true;
+            } else {
+                fprintf(gpfilMsg, "PCH:  %ld symbols written to %s\n", ctx->cSymbols, outName);
+            }
+        }
+    } else if (OPTION(object)) {
+        // pila-ld makes the PRC out of this and the other modules
+        if (ErrorGetErrorCount()==0) {
+            ctx->cbPrc = ObjectWrite(&ctx->pbPrc);
+        }
+    } else if (ErrorGetErrorCount()==0) {
+        ctx->cbPrc = MakePrc(outName, gszAppName, gpbCode, gulCodeLoc,
+                             gpbData, gulDataLoc, &ctx->pbPrc);
+        ctx->cbDataCompressed = gcbDataCompressed;
+    }
+
+    ctx->cErrors   = ErrorGetErrorCount();
+    ctx->cWarnings = ErrorGetWarningCount();
+    PilaSetErrors(ctx);
+
+    ListClose(ctx->szErrors);
+    SymbolTerminate();
+    PrcInitialize();
+    SegmentFlush();
+    ObjectFlush();
+    ProcGraphFlush();
+
+    // The code and data sections are handed over to the context.
+    ctx->pbCode = gpbCode;
+    ctx->cbCode = gulCodeLoc;
+    ctx->pbData = gpbData;
+    ctx->cbData = gulDataLoc;
+    free(gpbResource);
+    gpbCode = gpbData = gpbResource = gpbOutput = NULL;
+
+    return ctx->cErrors + fFailed;
+}
+
+
+/* assembles like PilaRun, but takes the results out of the build cache
+   if they are there and puts them in if they are not */
+static int PilaRunCached(PilaContext *ctx, char *fileName, char *outName, char *lisName,
+                         InputHash key)
+{
+    FILE *pfilMsgs;
+    int rc;
+
+    if (CacheFetch(OPTION(cache_dir), key, lisName, ctx)) {
+        PilaSetErrors(ctx);
+        return 0;
+    }
+    PilaFreeResults(ctx);
+    strcpy(ctx->szOutName, outName);
+
+    // The messages are kept along with the results, so collect them first.
+    pfilMsgs = tmpfile();
+    if (pfilMsgs) {
+        gpfilMsg = pfilMsgs;
+    }
+    rc = PilaRun(ctx, fileName, outName, lisName);
+    if (pfilMsgs) {
+        if (rc == 0 && ctx->pbPrc) {
+            CacheStore(OPTION(cache_dir), key, lisName, ctx, pfilMsgs);
+        }
+        gpfilMsg = ctx->pfilMsg ? ctx->pfilMsg : stdout;
+        PilaCopyMessages(pfilMsgs, gpfilMsg);
+        fclose(pfilMsgs);
+    }
+    return rc;
+}
+
+
+/* writes the make rule for target to depName (to pfilOut if NULL) */
+static boolean PilaWriteDepends(char *depName, FILE *pfilOut, char *target)
+{
+    FILE *pfil;
+    boolean fOk;
+
+    if (!depName) {
+        return InputWriteDepends(pfilOut, target) && fflush(pfilOut) == 0;
+    }
+
+    pfil = fopen(depName, "w");
+    if (!pfil) {
+        return false;
+    }
+    fOk = InputWriteDepends(pfil, target);
+    if (fclose(pfil) != 0) {
+        fOk = false;
+    }
+    return fOk;
+}
+
+
+int PilaAssemble(PilaContext *ctx, char *fileName, options *opts)
+{
+    char outName[_MAX_PATH], lisName[_MAX_PATH], depName[_MAX_PATH], *pszLis, *p;
+    InputHash key;
+    int rc;
+
+    PilaFreeResults(ctx);
+    gpfilMsg = ctx->pfilMsg ? ctx->pfilMsg : stdout;
+    if (opts != &globalOptions) {
+        globalOptions = *opts;
+    }
+
+    /* Process output file names in their own buffer */
+    strcpy(outName, fileName);
+
+    /* Change extension to .lis (.lsb for pila-lst) */
+    p = strchr(outName, '.');
+    if (!p) {
+        p = outName + strlen(outName);
+    }
+    strcpy(p, OPTION(binary_listing) ? ".lsb" : ".lis");
+    strcpy(lisName, outName);
+    pszLis = OPTION(listing) ? lisName : NULL;
+
+    /* Dependencies go to infile.d with -MD, to stdout with -M */
+    strcpy(p, ".d");
+    strcpy(depName, outName);
+
+    strcpy(p, OPTION(object) ? ".o" : ".prc");
+    if (OPTION(precompile)) {
+        PchImageName(fileName, outName);
+    }
+    if (OPTION(out_fname)) {
+        strcpy(outName, OPTION(out_fname));
+    }
+    strcpy(ctx->szOutName, outName);
+    if (OPTION(depends_fname)) {
+        strcpy(depName, OPTION(depends_fname));
+    }
+
+    key = CacheKey(fileName, outName, pszLis);
+    if (OPTION(if_changed) && CacheUpToDate(key, outName, pszLis)) {
+        // outName is still what the inputs make of it
+        ctx->fUpToDate = true;
+        PilaSetErrors(ctx);
+        rc = 0;
+    } else if (OPTION(cache_dir) && !OPTION(precompile)) {
+        // Precompiled includes are not worth caching, they are made once.
+        rc = PilaRunCached(ctx, fileName, outName, pszLis, key);
+    } else {
+        rc = PilaRun(ctx, fileName, outName, pszLis);
+    }
+
+    if (rc == 0) {
+        if (OPTION(if_changed) && !ctx->fUpToDate && !OPTION(depends_only) &&
+            (ctx->pbPrc || OPTION(precompile))) {
+            CacheStamp(key, outName, ctx->pbPrc, ctx->cbPrc, pszLis);
+        }
+        if ((OPTION(depends) || OPTION(depends_only)) &&
+            !PilaWriteDepends(DEPENDS_TO_STDOUT(&globalOptions) ? NULL : depName,
+                              ctx->pfilDepends ? ctx->pfilDepends : stdout, outName)) {
+            fprintf(gpfilMsg, "Failed to write %s\n",
+                    DEPENDS_TO_STDOUT(&globalOptions) ? "the make rule" : depName);
+            rc = 1;
+        }
+    }
+
+    InputFlush();
+    return rc;
+}
+
+
+char *skipSpace(char *p)
+{
+  while (ISSPACE(*p)) p++;
+  return p;
+}
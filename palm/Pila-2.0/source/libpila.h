@@ -0,0 +1,75 @@
+/**********************************************************************************
+ *
+ *      LIBPILA.H
+ *
+ *      Pila as a library. Everything but main.c goes into libpila.a, so a
+ *      program can run the assembler without starting pila for every file
+ *      and gets the results handed back in memory.
+ *
+ *      The assembler's state is kept in PILA_STATE variables (see pila.h),
+ *      one set per thread. Each thread can therefore assemble with a
+ *      context of its own while other threads do the same. A context must
+ *      not be used by two threads at the same time.
+ *
+ *      PilaCreateContext()
+ *        Returns a new, empty context.
+ *
+ *      PilaAssemble(PilaContext *ctx, char *fileName, options *opts)
+ *        Assembles fileName with the given options (see options.h; the
+ *        in_fname member is ignored) and puts the results into ctx,
+ *        replacing those of an earlier call. Messages are printed to
+ *        ctx->pfilMsg and the listing file is written if opts asks for
+ *        one. With opts->cache_dir set the results may come out of the
+ *        build cache (see cache.h) instead, or with opts->if_changed
+ *        nothing be done at all if szOutName is up to date (fUpToDate).
+ *        With -M or -MD a make rule listing all the files read is written
+ *        as well (to ctx->pfilDepends with -M and no -MF). With opts->precompile set the symbol table is written to the
+ *        precompiled include szOutName instead of making a PRC, with
+ *        opts->object the object file (see objfile.h) is made instead.
+ *        Returns the number of errors plus one if the output could not be
+ *        made (just like pila's exit code) or -1 if fileName could not be
+ *        assembled at all.
+ *
+ *      PilaDestroyContext(PilaContext *ctx)
+ *        Frees the context and all buffers it holds.
+ *
+ *********************************************************************************/
+
+#ifndef _LIBPILA_H_
+#define _LIBPILA_H_
+
+#include "pila.h"
+#include "options.h"
+
+typedef struct PilaContext
+{
+  // Set by the caller: where PilaAssemble prints its messages (stdout
+  // if NULL). Can be changed between calls.
+  FILE          *pfilMsg;
+  // Set by the caller: where -M without -MF writes the make rule (stdout
+  // if NULL). Can be changed between calls.
+  FILE          *pfilDepends;
+
+  // Everything below is set by PilaAssemble. The buffers belong to the
+  // context and stay valid until the next PilaAssemble call.
+  char           szOutName[_MAX_PATH];	// file the PRC (or precompiled include) is meant for
+  unsigned char *pbPrc;			// PRC image or object file (NULL if there were errors)
+  long           cbPrc;
+  unsigned char *pbCode;		// code section (NULL if it came from --cache)
+  long           cbCode;
+  unsigned char *pbData;		// data section (uncompressed, NULL like pbCode)
+  long           cbData;
+  long           cbDataCompressed;	// size of the 'data' resource
+  long           cbRes;			// size of all resources but code and data
+  long           cSymbols;		// symbols in the precompiled include
+  int            cErrors;
+  int            cWarnings;
+  char           szErrors[80];		// "n errors, m warnings" line
+  boolean        fUpToDate;		// nothing done, szOutName is up to date (--if-changed)
+} PilaContext;
+
+PilaContext *PilaCreateContext();
+int          PilaAssemble(PilaContext *ctx, char *fileName, options *opts);
+void         PilaDestroyContext(PilaContext *ctx);
+
+#endif
@@ -0,0 +1,570 @@
+/**********************************************************************************
+ *
+ *      LINK.C
+ *
+ *      The linker: reading object files and archives, pulling in the
+ *      archive members needed, placing the modules and making the PRC.
+ *
+ *      See link.h for a description of the functions.
+ *
+ *********************************************************************************/
+
+#include "pila.h"
+#include "asm.h"
+#include "prc.h"
+#include "options.h"
+#include "safe-ctype.h"
+#include "libiberty.h"
+#include "objfile.h"
+#include "link.h"
+
+extern PILA_STATE int    giPass;
+extern PILA_STATE FourCC gfcCreatorId;
+extern PILA_STATE long   gcbResTotal;
+extern PILA_STATE long   gcbDataCompressed;
+
+#define AR_MAGIC        "!<arch>\n"
+#define AR_HEADER_SIZE  60
+
+#define LINK_HASH_SIZE  1024	// must be a power of two
+
+typedef struct _LinkModule
+{
+  ObjModule     *mod;
+  unsigned char *pb;		// the object file (the module points into it)
+  boolean        archived;	// comes out of an archive
+  boolean        linked;
+  long           codeBase;	// where its code and data go
+  long           dataBase;
+} LinkModule;
+
+typedef struct _LinkSymbol
+{
+  char               *name;
+  LinkModule         *module;	// the one defining it (NULL if only imported so far)
+  ObjSymbol          *sym;
+  struct _LinkSymbol *next;	// next one in the same hash chain
+} LinkSymbol;
+
+static LinkModule **linkModules = NULL;	// in the order they were added
+static int          linkModuleCount = 0;
+static int          linkModuleAlloc = 0;
+static LinkModule **linkOrder = NULL;	// in the order they are linked
+static int          linkOrderCount = 0;
+static LinkSymbol  *linkHash[LINK_HASH_SIZE];
+static int          linkErrors = 0;
+
+
+void LinkFlush()
+{
+  LinkSymbol *sym, *next;
+  int i;
+
+  for (i = 0; i < linkModuleCount; i++)
+  {
+    ObjectFree(linkModules[i]->mod);
+    free(linkModules[i]->pb);
+    free(linkModules[i]);
+  }
+  free(linkModules);
+  free(linkOrder);
+  linkModules = linkOrder = NULL;
+  linkModuleCount = linkModuleAlloc = linkOrderCount = 0;
+
+  for (i = 0; i < LINK_HASH_SIZE; i++)
+  {
+    for (sym = linkHash[i]; sym; sym = next)
+    {
+      next = sym->next;
+      free(sym);
+    }
+    linkHash[i] = NULL;
+  }
+  linkErrors = 0;
+}
+
+
+static void LinkError(char *where, char *format, char *details)
+{
+  fprintf(gpfilMsg, "%s: error: ", where);
+  fprintf(gpfilMsg, format, details);
+  fputc('\n', gpfilMsg);
+  linkErrors++;
+}
+
+
+//
+// Reading object files and archives
+//
+
+/* adds the object file in pb (which the module takes over) */
+static boolean LinkAddModule(char *name, unsigned char *pb, long cb, boolean archived)
+{
+  LinkModule *module;
+  ObjModule  *mod;
+
+  mod = ObjectLoad(name, pb, cb);
+  if (!mod)
+  {
+    free(pb);
+    return false;
+  }
+
+  if (linkModuleCount == linkModuleAlloc)
+  {
+    linkModuleAlloc = 2 * linkModuleAlloc + 16;
+    linkModules = xrealloc(linkModules, linkModuleAlloc * sizeof(LinkModule *));
+  }
+  module = xcalloc(1, sizeof(LinkModule));
+  module->mod = mod;
+  module->pb = pb;
+  module->archived = archived;
+  linkModules[linkModuleCount++] = module;
+  return true;
+}
+
+
+/* returns the number in an archive member header field (-1 if none) */
+static long LinkArchiveNumber(unsigned char *pb, int cb)
+{
+  char sz[16], *pch;
+  long l;
+
+  memcpy(sz, pb, cb);
+  sz[cb] = 0;
+  l = strtol(sz, &pch, 10);
+  while (*pch == ' ')
+    pch++;
+  return (pch == sz || *pch || l < 0) ? -1 : l;
+}
+
+
+static boolean LinkAddArchive(char *fileName, unsigned char *pb, long cb)
+{
+  unsigned char *pbMember, *pbNames = NULL;
+  char  szName[_MAX_PATH], szModule[2 * _MAX_PATH];
+  long  ib, cbMember, cbNames = 0, cbName, i;
+  boolean fOk = true;
+
+  for (ib = sizeof(AR_MAGIC) - 1; ib + AR_HEADER_SIZE <= cb; ib += cbMember + (cbMember & 1))
+  {
+    // name[16] date[12] uid[6] gid[6] mode[8] size[10] "`\n"
+    cbMember = LinkArchiveNumber(pb + ib + 48, 10);
+    if (cbMember < 0 || pb[ib + 58] != '`' || pb[ib + 59] != '\n' ||
+        cbMember > cb - ib - AR_HEADER_SIZE)
+    {
+      fprintf(gpfilMsg, "%s is damaged\n", fileName);
+      return false;
+    }
+    memcpy(szName, pb + ib, 16);
+    for (cbName = 16; cbName > 0 && szName[cbName - 1] == ' '; cbName--)
+      ;
+    szName[cbName] = 0;
+    pbMember = pb + ib + AR_HEADER_SIZE;
+    ib += AR_HEADER_SIZE;
+
+    if (strcmp(szName, "/") == 0 || strcmp(szName, "/SYM64/") == 0 ||
+        strncmp(szName, "__.SYMDEF", 9) == 0)
+      continue;			// ar's own symbol table
+
+    if (strcmp(szName, "//") == 0)
+    {
+      // GNU: the names too long for the header
+      pbNames = pbMember;
+      cbNames = cbMember;
+      continue;
+    }
+
+    if (szName[0] == '/' && ISDIGIT(szName[1]))
+    {
+      // GNU: "/offset" into the long names, each ending with "/\n"
+      i = strtol(szName + 1, NULL, 10);
+      for (cbName = 0; i + cbName < cbNames && pbNames[i + cbName] != '\n' &&
+                       cbName < (long)sizeof(szName) - 1; cbName++)
+        ;
+      if (!pbNames || i >= cbNames)
+      {
+        fprintf(gpfilMsg, "%s is damaged\n", fileName);
+        return false;
+      }
+      memcpy(szName, pbNames + i, cbName);
+      szName[cbName] = 0;
+    }
+    else if (strncmp(szName, "#1/", 3) == 0)
+    {
+      // BSD: the name is in front of the member
+      cbName = strtol(szName + 3, NULL, 10);
+      if (cbName <= 0 || cbName > cbMember || cbName >= (long)sizeof(szName))
+      {
+        fprintf(gpfilMsg, "%s is damaged\n", fileName);
+        return false;
+      }
+      memcpy(szName, pbMember, cbName);
+      szName[cbName] = 0;
+      pbMember += cbName;
+      ib += cbName;
+      cbMember -= cbName;
+    }
+
+    // the names may end with '/' (and BSD ones with '\0')
+    cbName = strlen(szName);
+    if (cbName > 0 && szName[cbName - 1] == '/')
+      szName[cbName - 1] = 0;
+
+    sprintf(szModule, "%.*s(%s)", _MAX_PATH - 2, fileName, szName);
+    if (!LinkAddModule(szModule, xmemdup(pbMember, cbMember, cbMember), cbMember, true))
+      fOk = false;
+  }
+  return fOk;
+}
+
+
+boolean LinkAddFile(char *fileName)
+{
+  FILE          *pfil;
+  unsigned char *pb;
+  long           cb;
+  boolean        fOk;
+
+  pfil = fopen(fileName, "rb");
+  if (!pfil)
+  {
+    fprintf(gpfilMsg, "Error: Can't open input file \"%s\"\n", fileName);
+    return false;
+  }
+  fseek(pfil, 0, SEEK_END);
+  cb = ftell(pfil);
+  rewind(pfil);
+  pb = xmalloc(cb + 1);
+  if (cb < 0 || fread(pb, 1, cb, pfil) != (size_t)cb)
+  {
+    fprintf(gpfilMsg, "Error: Can't read input file \"%s\"\n", fileName);
+    fclose(pfil);
+    free(pb);
+    return false;
+  }
+  fclose(pfil);
+
+  if (cb >= (long)sizeof(AR_MAGIC) - 1 && memcmp(pb, AR_MAGIC, sizeof(AR_MAGIC) - 1) == 0)
+  {
+    // the members are copied, so the archive is not needed afterwards
+    fOk = LinkAddArchive(fileName, pb, cb);
+    free(pb);
+    return fOk;
+  }
+  return LinkAddModule(fileName, pb, cb, false);
+}
+
+
+//
+// Resolving the symbols
+//
+
+/* returns the symbol name, which is created if create is set (NULL if not) */
+static LinkSymbol *LinkLookup(char *name, boolean create)
+{
+  LinkSymbol **pp = &linkHash[SymbolHashCode(name) & (LINK_HASH_SIZE - 1)];
+  LinkSymbol  *sym;
+
+  for (sym = *pp; sym; sym = sym->next)
+    if (strcmp(sym->name, name) == 0)
+      return sym;
+
+  if (!create)
+    return NULL;
+  sym = xcalloc(1, sizeof(LinkSymbol));
+  sym->name = name;
+  sym->next = *pp;
+  *pp = sym;
+  return sym;
+}
+
+
+static void LinkModuleIn(LinkModule *module)
+{
+  ObjSymbol  *objSym;
+  LinkSymbol *sym;
+  int i;
+
+  module->linked = true;
+  linkOrder[linkOrderCount++] = module;
+
+  for (i = 0, objSym = module->mod->symbols; i < module->mod->cSymbols; i++, objSym++)
+  {
+    sym = LinkLookup(objSym->name, true);
+    if (objSym->kind == kObjSymCode || objSym->kind == kObjSymData)
+    {
+      if (sym->module)
+      {
+        LinkError(module->mod->name, "symbol multiply defined: %s", objSym->name);
+        fprintf(gpfilMsg, "  first defined in %s\n", sym->module->mod->name);
+        continue;
+      }
+      sym->module = module;
+      sym->sym = objSym;
+    }
+  }
+}
+
+
+/* returns true if the archived module defines a symbol that is still missing */
+static boolean LinkIsNeeded(LinkModule *module)
+{
+  ObjSymbol  *objSym;
+  LinkSymbol *sym;
+  int i;
+
+  for (i = 0, objSym = module->mod->symbols; i < module->mod->cSymbols; i++, objSym++)
+  {
+    if (objSym->kind != kObjSymCode && objSym->kind != kObjSymData)
+      continue;
+    sym = LinkLookup(objSym->name, false);
+    if (sym && !sym->module)
+      return true;
+  }
+  return false;
+}
+
+
+static void LinkResolve()
+{
+  boolean fChanged;
+  int i;
+
+  linkOrder = xmalloc((linkModuleCount + 1) * sizeof(LinkModule *));
+  for (i = 0; i < linkModuleCount; i++)
+    if (!linkModules[i]->archived)
+      LinkModuleIn(linkModules[i]);
+
+  // a member pulled in may import what an earlier member defines
+  do
+  {
+    fChanged = false;
+    for (i = 0; i < linkModuleCount; i++)
+      if (!linkModules[i]->linked && LinkIsNeeded(linkModules[i]))
+      {
+        LinkModuleIn(linkModules[i]);
+        fChanged = true;
+      }
+  } while (fChanged);
+}
+
+
+static void LinkCheckImports()
+{
+  LinkModule *module;
+  ObjSymbol  *objSym;
+  LinkSymbol *sym;
+  int i, j;
+
+  for (i = 0; i < linkOrderCount; i++)
+  {
+    module = linkOrder[i];
+    for (j = 0, objSym = module->mod->symbols; j < module->mod->cSymbols; j++, objSym++)
+    {
+      if (objSym->kind != kObjSymImportCode && objSym->kind != kObjSymImportData)
+        continue;
+      sym = LinkLookup(objSym->name, false);
+      if (!sym->module)
+        LinkError(module->mod->name, "undefined symbol: %s", objSym->name);
+      else if (objSym->kind == kObjSymImportCode && sym->sym->kind != kObjSymCode)
+        LinkError(module->mod->name, "procedure is data in the module defining it: %s",
+                  objSym->name);
+      else if (objSym->kind == kObjSymImportData && sym->sym->kind != kObjSymData)
+        LinkError(module->mod->name, "variable is code in the module defining it: %s",
+                  objSym->name);
+    }
+  }
+}
+
+
+//
+// Placing the modules
+//
+
+static void LinkPlace(long *pcbCode, long *pcbData)
+{
+  LinkModule *module;
+  long cbCode = 0, cbData = 0;
+  int i;
+
+  for (i = 0; i < linkOrderCount; i++)
+  {
+    module = linkOrder[i];
+    module->codeBase = (cbCode + 3) & ~3L;
+    module->dataBase = (cbData + 3) & ~3L;
+    cbCode = module->codeBase + module->mod->cbCode;
+    cbData = module->dataBase + module->mod->cbData;
+    if (OPTION(verbose))
+      fprintf(gpfilMsg, "%s: code at %ld (%ld bytes), data at %ld (%ld bytes)\n",
+              module->mod->name, module->codeBase, module->mod->cbCode,
+              module->dataBase, module->mod->cbData);
+  }
+  *pcbCode = cbCode;
+  *pcbData = cbData;
+}
+
+
+static void LinkRelocate(LinkModule *module, unsigned char *pbCode, unsigned char *pbData)
+{
+  ObjReloc   *reloc;
+  ObjSymbol  *objSym;
+  LinkSymbol *sym;
+  unsigned char *pb;
+  long base, v;
+  boolean fData;
+  int i;
+
+  for (i = 0, reloc = module->mod->relocs; i < module->mod->cRelocs; i++, reloc++)
+  {
+    if (reloc->target == kObjTargetCode)
+      v = module->codeBase, fData = false;
+    else if (reloc->target == kObjTargetData)
+      v = module->dataBase, fData = true;
+    else
+    {
+      objSym = &module->mod->symbols[reloc->target];
+      sym = LinkLookup(objSym->name, false);
+      if (!sym || !sym->module)
+        continue;		// reported by LinkCheckImports
+      fData = sym->sym->kind == kObjSymData;
+      v = (fData ? sym->module->dataBase : sym->module->codeBase) + sym->sym->value;
+    }
+    v += reloc->addend;
+
+    if (reloc->block == kbtCode)
+      base = module->codeBase, pb = pbCode;
+    else
+      base = module->dataBase, pb = pbData;
+    if (reloc->how == kRelocPc)
+    {
+      if (fData || reloc->block != kbtCode)
+      {
+        LinkError(module->mod->name, "PC relative reference to data: %s",
+                  reloc->target >= 0 ? module->mod->symbols[reloc->target].name : "(data)");
+        continue;
+      }
+      v -= base + (reloc->loc & ~1L);	// from the extension word
+    }
+
+    // the same checks the assembler makes for values it knows itself
+    if ((reloc->size == WORD &&
+         (v < -32768 || v > (reloc->how == kRelocAbs ? 65535 : 32767))) ||
+        (reloc->size == BYTE &&
+         (v < -128 || v > (reloc->how == kRelocAbs ? 255 : 127))))
+    {
+      LinkError(module->mod->name, "value of %s out of range after linking",
+                reloc->target >= 0 ? module->mod->symbols[reloc->target].name
+                                   : (fData ? "a data label" : "a code label"));
+      continue;
+    }
+
+    pb += base + reloc->loc;
+    switch (reloc->size)
+    {
+    case LONG:
+      *pb++ = (unsigned char)(v >> 24);
+      *pb++ = (unsigned char)(v >> 16);
+      /* fall through */
+    case WORD:
+      *pb++ = (unsigned char)(v >> 8);
+      /* fall through */
+    case BYTE:
+      *pb = (unsigned char)v;
+      break;
+    }
+  }
+}
+
+
+static void LinkAddResources()
+{
+  ResourceMapEntry *arme;
+  ObjResource      *res;
+  LinkModule       *module;
+  char              sz[40];
+  long              cResources;
+  int i, j, k;
+
+  giPass = 2;		// AddResource ignores earlier passes
+  for (i = 0; i < linkOrderCount; i++)
+  {
+    module = linkOrder[i];
+    for (j = 0, res = module->mod->resources; j < module->mod->cResources; j++, res++)
+    {
+      cResources = PrcGetResources(&arme);
+      for (k = 0; k < cResources; k++)
+        if (arme[k].fcType == res->type && arme[k].usId == res->id)
+          break;
+      if (k < cResources)
+      {
+        sprintf(sz, "%c%c%c%c #%d", (char)(res->type >> 24), (char)(res->type >> 16),
+                (char)(res->type >> 8), (char)res->type, res->id);
+        LinkError(module->mod->name, "resource multiply defined: %s", sz);
+        continue;
+      }
+      AddResource(res->type, (ushort)res->id, res->pb, res->cb, false);
+    }
+  }
+}
+
+
+int LinkRun(char *outName)
+{
+  unsigned char *pbCode, *pbData, *pbPrc;
+  char  *pszAppName = NULL;
+  long   cbCode, cbData, cbPrc, cbRes, cbOut;
+  int    i;
+
+  PrcInitialize();
+  gcbResTotal = 0;
+
+  LinkResolve();
+  LinkCheckImports();
+  if (linkErrors)
+    return linkErrors;
+
+  LinkPlace(&cbCode, &cbData);
+  pbCode = xcalloc(cbCode + 1, 1);
+  pbData = xcalloc(cbData + 1, 1);
+  for (i = 0; i < linkOrderCount; i++)
+  {
+    memcpy(pbCode + linkOrder[i]->codeBase, linkOrder[i]->mod->pbCode, linkOrder[i]->mod->cbCode);
+    memcpy(pbData + linkOrder[i]->dataBase, linkOrder[i]->mod->pbData, linkOrder[i]->mod->cbData);
+  }
+  for (i = 0; i < linkOrderCount; i++)
+    LinkRelocate(linkOrder[i], pbCode, pbData);
+
+  for (i = 0; i < linkOrderCount && !pszAppName; i++)
+    if (linkOrder[i]->mod->pszAppName)
+    {
+      pszAppName = linkOrder[i]->mod->pszAppName;
+      gfcCreatorId = linkOrder[i]->mod->creator;
+    }
+  if (!pszAppName)
+    LinkError(outName, "%s", "none of the modules has an APPL directive");
+
+  LinkAddResources();
+  cbRes = gcbResTotal;
+
+  cbOut = 0;
+  if (!linkErrors)
+  {
+    cbPrc = MakePrc(outName, pszAppName, pbCode, cbCode, pbData, cbData, &pbPrc);
+    if (cbPrc)
+    {
+      cbOut = WritePrc(outName, pbPrc, cbPrc);
+      free(pbPrc);
+    }
+    if (!cbOut)
+      linkErrors++;
+    fprintf(gpfilMsg, "Code: %ld bytes\nData: %ld bytes (%ld compressed)\n"
+            "Res:  %ld bytes\nPRC:  %ld bytes\n",
+            cbCode, cbData, gcbDataCompressed, cbRes, cbOut);
+  }
+
+  PrcInitialize();
+  free(pbCode);
+  free(pbData);
+  return linkErrors;
+}
@@ -0,0 +1,42 @@
+/**********************************************************************************
+ *
+ *      LINK.H
+ *
+ *      The linker behind pila-ld. It makes a PRC out of object files
+ *      written by "pila --object" (see objfile.h) and archives of them made
+ *      with ar (the usual System V/GNU and BSD formats).
+ *
+ *      All object files named are linked, in the order given. The first
+ *      has to be the one with the startup code, as it goes to the start of
+ *      code #1 and its data to the start of the data (0(a5), where PalmOS
+ *      keeps its own 32 bytes). A module out of an archive is only linked
+ *      if it defines a symbol imported by a module already linked; the
+ *      archives are searched again as long as this pulls in more modules.
+ *
+ *      The code and the data of each module start at a multiple of 4 bytes.
+ *      Its resources are put into the PRC as they are. The application
+ *      name and creator come from the first module with an appl directive.
+ *
+ *      LinkFlush()
+ *        Forgets about the files added before.
+ *
+ *      LinkAddFile(char *fileName)
+ *        Reads the object file or archive fileName. Returns false (after
+ *        printing why) if it can't be read or isn't one.
+ *
+ *      LinkRun(char *outName)
+ *        Links what was added and writes the PRC to outName. Returns the
+ *        number of errors (0 if the PRC was written).
+ *
+ *********************************************************************************/
+
+#ifndef _LINK_H_
+#define _LINK_H_
+
+#include "pila.h"
+
+void    LinkFlush();
+boolean LinkAddFile(char *fileName);
+int     LinkRun(char *outName);
+
+#endif
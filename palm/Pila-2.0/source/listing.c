@@ -36,16 +36,14 @@
  *    ListWriteError(char *errorMsg)
  *      Adds an error message to the listing file. The actual writing of
  *      the error message is deferred until after the offending source
- *      line has been written to the listing file.
- *      The string passed in as parameter must have been allocated via
- *      malloc. If there is no listing file written the function returns
- *      true to signal to the caller that the message has not been stored
- *      (and can be freed) otherwise false is returned and the message will
- *      be freed by ListWriteLine later on.
+ *      line has been written to the listing file. The message is copied,
+ *      so the caller keeps its string.
  *
  *    ListPutSourceLine(char *sourceLine, int sourceLineNo)
  *      This call stores the source line and the current line no for
  *      later inclusion in the line written to the listing file.
+ *      Lines of macro expansions are passed in with line no. 0 and
+ *      listed without one.
  *
  *    ListPutLocation(unsigned long outputLocation)
  *      Starts the process of assembling a listing line by
@@ -70,6 +68,14 @@
  *      be printed to indicate the omission of values from the
  *      listing, and the data will not be added to the file.
  *
+ *    ListRender(char *binaryName, char *listFileName)
+ *      Turns a binary listing into the listing file (see listing.h).
+ *
+ *      The listing is put together in a large buffer that is written
+ *      out when it is full, formatting the numbers by hand. With
+ *      --binary-listing the calls above are only recorded (in the same
+ *      buffer) and ListRender plays them back later.
+ *
  *      Author: Paul McKee
  *      ECE492    North Carolina State University
  *
@@ -90,7 +96,6 @@
 #include "asm.h"
 
 #include <stdio.h>
-#include "expand.h"
 #include "options.h"
 #include "listing.h"
 #include "libiberty.h"
@@ -98,56 +103,208 @@
 /************************************************************************
  * Declarations of module variables
  ************************************************************************/
-static FILE *listFile = NULL;		/* listing file */
+#define LIST_BUFFER_SIZE 65536
+#define LIST_DATA_WIDTH  41				/* width of the location and object field */
+
+static PILA_STATE FILE *listFile = NULL;		/* listing file */
+static PILA_STATE boolean listBinary = false;		/* recording a binary listing (see listing.h) */
+
+static PILA_STATE char  *listBuffer = NULL;		/* output waiting to be written */
+static PILA_STATE size_t listBufferUsed = 0;
+
+static PILA_STATE char  listData[49];			/* Buffer in which listing lines are assembled */
+static PILA_STATE char *listPtr;				/* Pointer to above buffer */
+
+static PILA_STATE char *currentSourceLine = NULL;	/* buffer for current source line */
+static PILA_STATE int   currentSourceLineLen = 0;	/* size of source line buffer */
+static PILA_STATE int   currentSourceLineUsed = 0;	/* length of the source line in it */
+static PILA_STATE int   currentSourceLineNo;		/* currently worked on source line no. */
+
+static PILA_STATE boolean enabled = false;		/* to keep track of list enable/disable */
+static PILA_STATE boolean started = false;		/* only in pass 2 will there be anything written */
+
+/************************************************************************
+ * Error messages waiting for their source line to be written, one after
+ * the other (in a binary listing they are recorded right away)
+ ************************************************************************/
+static PILA_STATE char  *deferredErrors = NULL;
+static PILA_STATE size_t deferredErrorsUsed = 0;
+static PILA_STATE size_t deferredErrorsSize = 0;
+static PILA_STATE boolean deferredErrorsRecorded = false;
+
+
+static void ListWriteOut(const char *text, size_t len)
+{
+	if (len && fwrite(text, 1, len, listFile)!=len)
+	{
+		fputs("Error writing to listing file\n", gpfilMsg);
+		exit(0);
+	}
+}
+
+
+static void ListFlush()
+{
+	ListWriteOut(listBuffer, listBufferUsed);
+	listBufferUsed = 0;
+}
+
+
+static void ListAppend(const char *text, size_t len)
+{
+	if (listBufferUsed+len>LIST_BUFFER_SIZE)
+	{
+		ListFlush();
+		if (len>LIST_BUFFER_SIZE)
+		{
+			ListWriteOut(text, len);
+			return;
+		}
+	}
+	memcpy(listBuffer+listBufferUsed, text, len);
+	listBufferUsed += len;
+}
+
+
+static void ListAppendChar(char c)
+{
+	if (listBufferUsed==LIST_BUFFER_SIZE)
+		ListFlush();
+	listBuffer[listBufferUsed++] = c;
+}
+
+
+/* appends text cut or padded with spaces to width (like %-41.41s) */
+static void ListAppendField(const char *text, int width)
+{
+	char *p;
+
+	if (listBufferUsed+width>LIST_BUFFER_SIZE)
+		ListFlush();
+	p = listBuffer+listBufferUsed;
+	listBufferUsed += width;
+	while (width>0 && *text)
+	{
+		*p++ = *text++;
+		width--;
+	}
+	memset(p, ' ', width);
+}
+
+
+/* appends n right aligned in width characters (like %5d) */
+static void ListAppendDecimal(long n, int width)
+{
+	char digits[24], *p = digits+sizeof(digits);
+	unsigned long u = n<0 ? -(unsigned long)n : (unsigned long)n;
+	int len;
+
+	do
+	{
+		*--p = (char)('0'+u%10);
+		u /= 10;
+	} while (u);
+	if (n<0)
+		*--p = '-';
+	len = digits+sizeof(digits)-p;
+	while (width-->len)
+		ListAppendChar(' ');
+	ListAppend(p, len);
+}
 
-static char  listData[49];			/* Buffer in which listing lines are assembled */
-static char *listPtr;				/* Pointer to above buffer */
 
-static char *currentSourceLine = NULL;	/* buffer for current source line */
-static int   currentSourceLineLen = 0;	/* size of source line buffer */
-static int   currentSourceLineNo;		/* currently worked on source line no. */
+/* writes the lowest digits hex digits of value to p (like %08lX) */
+static void ListHex(char *p, unsigned long value, int digits)
+{
+	static const char hexDigits[] = "0123456789ABCDEF";
+
+	while (digits>0)
+	{
+		p[--digits] = hexDigits[value & 15];
+		value >>= 4;
+	}
+}
 
-static boolean enabled = false;		/* to keep track of list enable/disable */
-static boolean started = false;		/* only in pass 2 will there be anything written */
 
 /************************************************************************
- * Structure and variables for error message deferral
+ * Binary listing records (see listing.h)
  ************************************************************************/
-typedef struct _DeferredErrorMsg
+static void ListRecordLong(unsigned long l)
 {
-  struct _DeferredErrorMsg *next;
-  char                     *msg;
-} DeferredErrorMsg;
+	char b[4];
 
-DeferredErrorMsg *deferredErrorMsgList = NULL;
-DeferredErrorMsg *lastErrorEntry       = (DeferredErrorMsg *)&deferredErrorMsgList;
+	b[0] = (char)(l>>24);
+	b[1] = (char)(l>>16);
+	b[2] = (char)(l>>8);
+	b[3] = (char)l;
+	ListAppend(b, 4);
+}
+
+
+static void ListRecordString(const char *text, size_t len)
+{
+	ListRecordLong(len);
+	ListAppend(text, len);
+}
 
 
-void ListInitialize(char *name)
+boolean ListInitialize(char *name)
 {
-    listFile = fopen(name, "w");
-    if (!listFile)
+	listBinary = OPTION(binary_listing);
+	listFile = fopen(name, listBinary ? "wb" : "w");
+	if (!listFile)
 	{
-        puts("Can't open listing file");
-        exit(0);
-    }
+		fputs("Can't open listing file\n", gpfilMsg);
+		return false;
+	}
+	listBuffer = xmalloc(LIST_BUFFER_SIZE);
+	listBufferUsed = 0;
+	if (listBinary)
+	{
+		ListAppend(LIST_BINARY_MAGIC, 8);
+		ListAppendChar(OPTION(const_expanded) ? 1 : 0);
+	}
+	return true;
 }
 
 void ListClose(char *szErrors)
 {
 	if (listFile)
 	{
-		putc('\n', listFile);
-		fputs(szErrors,listFile);
+		if (listBinary)
+		{
+			ListAppendChar('C');
+			ListRecordString(szErrors, strlen(szErrors));
+		}
+		else
+		{
+			ListAppendChar('\n');
+			ListAppend(szErrors, strlen(szErrors));
+		}
+		ListFlush();
 		fclose(listFile);
 		listFile = NULL;
 	}
 
+	free(listBuffer);
+	listBuffer = NULL;
+	listBufferUsed = 0;
+
 	if (currentSourceLine)
 	{
 		free(currentSourceLine);
 		currentSourceLine = NULL;
 	}
+	currentSourceLineLen = 0;
+	currentSourceLineUsed = 0;
+
+	free(deferredErrors);
+	deferredErrors = NULL;
+	deferredErrorsUsed = deferredErrorsSize = 0;
+	deferredErrorsRecorded = false;
+	listBinary = false;
+	enabled = false;
+	started = false;
 }
 
 void ListStartListing()
@@ -169,58 +326,72 @@ void ListDisable()
 }
 
 
-boolean ListWriteError(char *errorMsg)
+void ListWriteError(char *errorMsg)
 {
-	if (listFile!=NULL) // keep message if a listing file is being written
-	{					// (even if listing is off at this point)
-		DeferredErrorMsg *errListEntry = xmalloc(sizeof(DeferredErrorMsg));
-		errListEntry->next = NULL;
-		errListEntry->msg  = errorMsg;
-		lastErrorEntry->next = errListEntry;
-		lastErrorEntry = errListEntry;
-		return false;
+	size_t len;
+
+	if (listFile==NULL)
+		return;
+
+	// keep message if a listing file is being written
+	// (even if listing is off at this point)
+	len = strlen(errorMsg);
+	if (listBinary)
+	{
+		ListAppendChar('E');
+		ListRecordString(errorMsg, len);
+		deferredErrorsRecorded = true;	// ListWriteLine has to tell where they go
+		return;
 	}
-	else
-		return true;
+
+	if (deferredErrorsUsed+len>deferredErrorsSize)
+	{
+		deferredErrorsSize = 2*deferredErrorsSize+len+256;
+		deferredErrors = xrealloc(deferredErrors, deferredErrorsSize);
+	}
+	memcpy(deferredErrors+deferredErrorsUsed, errorMsg, len);
+	deferredErrorsUsed += len;
 }
 
 
 void ListWriteLine()
 {
-	if (enabled)
+	if (listBinary)
 	{
-	    fprintf(listFile, "%-41.41s", listData);
-	    if (currentSourceLine && *currentSourceLine)
-	    {
-	      if (ExpandGetLineNum()==0)
-	        fprintf(listFile, "%5d  %s", currentSourceLineNo, currentSourceLine);
-	      else
-	        fprintf(listFile, "       %s",currentSourceLine);
-		  *currentSourceLine = '\0';
-	    }
-	    else
-	    {
-	        putc('\n', listFile);
-	    }
+		// a line that is not listed still gets its error messages out
+		if (enabled)
+			ListAppendChar('W');
+		else if (deferredErrorsRecorded)
+			ListAppendChar('F');
+		deferredErrorsRecorded = false;
+		return;
 	}
 
-	if (listFile!=NULL) // write error messages even if listing is off
+	if (enabled)
 	{
-		DeferredErrorMsg *deferredErrorMsg;
-
-		while (deferredErrorMsgList!=NULL)
+		ListAppendField(listData, LIST_DATA_WIDTH);
+		if (currentSourceLine && *currentSourceLine)
+		{
+			if (currentSourceLineNo!=0)
+			{
+				ListAppendDecimal(currentSourceLineNo, 5);
+				ListAppend("  ", 2);
+			}
+			else
+				ListAppend("       ", 7);
+			ListAppend(currentSourceLine, currentSourceLineUsed);
+			*currentSourceLine = '\0';
+		}
+		else
 		{
-			fputs(deferredErrorMsgList->msg,listFile);
-			deferredErrorMsg = deferredErrorMsgList;
-			deferredErrorMsgList = deferredErrorMsgList->next;
-			free(deferredErrorMsg->msg);
-			free(deferredErrorMsg);
+			ListAppendChar('\n');
 		}
-		
-	    if (ferror(listFile)) {
-	        fputs("Error writing to listing file\n", stdout);
-	        exit(0);
-	    }
+	}
+
+	if (listFile!=NULL && deferredErrorsUsed) // write error messages even if listing is off
+	{
+		ListAppend(deferredErrors, deferredErrorsUsed);
+		deferredErrorsUsed = 0;
 	}
 }
 
@@ -229,22 +400,23 @@ void ListPutSourceLine(char *sourceLine,int sourceLineNo) // gpsseCur->iLineNum
 {
 	if (enabled)
 	{
-		int len = strlen(sourceLine)+1;
+		int len = strlen(sourceLine);
 
-		if (currentSourceLine==NULL)
+		if (listBinary)
 		{
-			currentSourceLine = xstrdup(sourceLine);
-			currentSourceLineLen = len;
+			ListAppendChar('P');
+			ListRecordLong(sourceLineNo);
+			ListRecordString(sourceLine, len);
+			return;
 		}
-		else
+
+		if (currentSourceLineLen<len+1)
 		{
-			if (currentSourceLineLen<len)
-			{
-				currentSourceLine = realloc(currentSourceLine,len);
-				currentSourceLineLen = len;
-			}
-			strcpy(currentSourceLine,sourceLine);
+			currentSourceLine = xrealloc(currentSourceLine,len+1);
+			currentSourceLineLen = len+1;
 		}
+		memcpy(currentSourceLine,sourceLine,len+1);
+		currentSourceLineUsed = len;
 		currentSourceLineNo = sourceLineNo;
 	}
 }
@@ -253,8 +425,16 @@ void ListPutLocation(unsigned long outputLocation)
 {
 	if (enabled)
 	{
-    	sprintf(listData, "%08lX  ", outputLocation);
-    	listPtr = listData + 10;
+		if (listBinary)
+		{
+			ListAppendChar('L');
+			ListRecordLong(outputLocation);
+			return;
+		}
+		ListHex(listData, outputLocation, 8);
+		listData[8] = listData[9] = ' ';
+		listData[10] = '\0';
+		listPtr = listData + 10;
 	}
 }
 
@@ -263,6 +443,12 @@ void ListPutSymbol(long data)
 {
 	if (enabled)
 	{
+		if (listBinary)
+		{
+			ListAppendChar('S');
+			ListRecordLong(data);
+			return;
+		}
 		*(listPtr++) = '=';
 		ListPutData(data,LONG);
 	}
@@ -273,6 +459,12 @@ void ListPutTypeName(char *data)
 {
 	if (enabled)
 	{
+		if (listBinary)
+		{
+			ListAppendChar('T');
+			ListRecordString(data, strlen(data));
+			return;
+		}
 		*(listPtr++) = '=';
 		*(listPtr+29) = '\0';
 		strncpy(listPtr,data,29);
@@ -285,6 +477,20 @@ void ListPutData(long data, int size)
 {
 	if (enabled)
 	{
+		if (size!=BYTE && size!=WORD && size!=LONG)
+		{
+			fputs("ListPutData: INVALID SIZE CODE!\n", gpfilMsg);
+			exit(0);
+		}
+
+		if (listBinary)
+		{
+			ListAppendChar('D');
+			ListAppendChar((char)size);
+			ListRecordLong(data);
+			return;
+		}
+
 		if (listPtr-listData+size*2+1>40)
 		{
 			if (!OPTION(const_expanded))
@@ -299,24 +505,143 @@ void ListPutData(long data, int size)
 				listPtr = listData+10;
 			}
 		}
-		
-	    switch (size)
+
+		// two hex digits per byte and a space
+		ListHex(listPtr, data, size*2);
+		listPtr += size*2;
+		*(listPtr++) = ' ';
+		*listPtr = '\0';
+	}
+}
+
+
+/* reads a long of a binary listing record */
+static boolean ListReadLong(FILE *pfil, unsigned long *l)
+{
+	unsigned char b[4];
+
+	if (fread(b, 1, 4, pfil)!=4)
+		return false;
+	*l = ((unsigned long)b[0]<<24) | ((unsigned long)b[1]<<16) | ((unsigned long)b[2]<<8) | b[3];
+	return true;
+}
+
+
+/* reads a string of a binary listing record into *text (growing it) */
+static boolean ListReadString(FILE *pfil, char **text, size_t *size)
+{
+	unsigned long len;
+
+	if (!ListReadLong(pfil, &len) || len>0x7FFFFFFFUL)
+		return false;
+	if (len+1>*size)
+	{
+		*size = len+1;
+		*text = xrealloc(*text, *size);
+	}
+	if (fread(*text, 1, len, pfil)!=len)
+		return false;
+	(*text)[len] = '\0';
+	return true;
+}
+
+
+int ListRender(char *binaryName, char *listFileName)
+{
+	FILE *pfil;
+	char magic[8], *text = NULL;
+	size_t textSize = 0;
+	unsigned long l;
+	int c, size;
+	boolean closed = false, damaged = false;
+
+	pfil = fopen(binaryName, "rb");
+	if (!pfil)
+	{
+		fprintf(gpfilMsg, "Can't open %s\n", binaryName);
+		return -1;
+	}
+	if (fread(magic, 1, 8, pfil)!=8 || memcmp(magic, LIST_BINARY_MAGIC, 8)!=0 ||
+	    (c = getc(pfil))==EOF)
+	{
+		fprintf(gpfilMsg, "%s is not a binary listing\n", binaryName);
+		fclose(pfil);
+		return -1;
+	}
+
+	OPTION(binary_listing) = false;
+	OPTION(const_expanded) = c!=0;
+	if (!ListInitialize(listFileName))
+	{
+		fclose(pfil);
+		return -1;
+	}
+	ListStartListing();
+
+	// play back the calls recorded by pila
+	while (!closed && !damaged && (c = getc(pfil))!=EOF)
+	{
+		switch (c)
 		{
-			case BYTE:
-				sprintf(listPtr, "%02lX ", data & 0xFF);
-				listPtr += 3;
+			case 'L':
+				damaged = !ListReadLong(pfil, &l);
+				if (!damaged)
+					ListPutLocation(l);
 				break;
-			case WORD:
-				sprintf(listPtr, "%04lX ", data & 0xFFFF);
-				listPtr += 5;
+			case 'D':
+				size = getc(pfil);
+				damaged = (size!=BYTE && size!=WORD && size!=LONG) || !ListReadLong(pfil, &l);
+				if (!damaged)
+					ListPutData((long)l, size);
 				break;
-			case LONG:
-				sprintf(listPtr, "%08lX ", data);
-				listPtr += 9;
+			case 'S':
+				damaged = !ListReadLong(pfil, &l);
+				if (!damaged)
+					ListPutSymbol((long)l);
+				break;
+			case 'T':
+				damaged = !ListReadString(pfil, &text, &textSize);
+				if (!damaged)
+					ListPutTypeName(text);
+				break;
+			case 'P':
+				damaged = !ListReadLong(pfil, &l) || !ListReadString(pfil, &text, &textSize);
+				if (!damaged)
+					ListPutSourceLine(text, (int)l);
+				break;
+			case 'E':
+				damaged = !ListReadString(pfil, &text, &textSize);
+				if (!damaged)
+					ListWriteError(text);
+				break;
+			case 'W':
+				ListWriteLine();
+				break;
+			case 'F':
+				ListDisable();
+				ListWriteLine();
+				ListEnable();
+				break;
+			case 'C':
+				damaged = !ListReadString(pfil, &text, &textSize);
+				if (!damaged)
+				{
+					ListClose(text);
+					closed = true;
+				}
 				break;
 			default:
-				printf("ListPutData: INVALID SIZE CODE!\n");
-				exit(0);
+				damaged = true;
+				break;
 		}
 	}
+
+	if (!closed)
+	{
+		fprintf(gpfilMsg, "%s is damaged or incomplete\n", binaryName);
+		ListClose("");
+	}
+	free(text);
+	fclose(pfil);
+	return closed ? 0 : -1;
 }
@@ -6,11 +6,12 @@
  *    ListInitialize(char *listFileName)
  *      Opens the specified listing file for writing. If the
  *      file cannot be opened, then the routine prints a
- *      message and exits.
+ *      message and returns false.
  *
  *    ListClose(char *szErrors)
  *      Closing of the listing file after writing the error statistics
- *      passed in with szErrors.
+ *      passed in with szErrors. Afterwards the module is back in its
+ *      initial state, ready for the next ListInitialize.
  *
  *    ListStartListing()
  *      There will be no listing output (even after calls to
@@ -36,16 +37,14 @@
  *    ListWriteError(char *errorMsg)
  *      Adds an error message to the listing file. The actual writing of
  *      the error message is deferred until after the offending source
- *      line has been written to the listing file.
- *      The string passed in as parameter must have been allocated via
- *      malloc. If there is no listing file written the function returns
- *      true to signal to the caller that the message has not been stored
- *      (and can be freed) otherwise false is returned and the message will
- *      be freed by ListWriteLine later on.
+ *      line has been written to the listing file. The message is copied,
+ *      so the caller keeps its string.
  *
  *    ListPutSourceLine(char *sourceLine, int sourceLineNo)
  *      This call stores the source line and the current line no for
  *      later inclusion in the line written to the listing file.
+ *      Lines of macro expansions are passed in with line no. 0 and
+ *      listed without one.
  *
  *    ListPutLocation(unsigned long outputLocation)
  *      Starts the process of assembling a listing line by
@@ -70,6 +69,27 @@
  *      be printed to indicate the omission of values from the
  *      listing, and the data will not be added to the file.
  *
+ *    ListRender(char *binaryName, char *listFileName)
+ *      Writes the listing file listFileName out of the binary listing
+ *      binaryName, the same as pila -l would have. Returns 0 if that
+ *      worked or -1 after printing a message (used by pila-lst).
+ *
+ *      With --binary-listing ListInitialize opens a binary listing
+ *      instead, which just records the calls above for ListRender:
+ *      it starts with LIST_BINARY_MAGIC and a byte that is 1 for -c,
+ *      followed by records of a letter and the call's arguments, longs
+ *      as 4 bytes (most significant first), strings as their length
+ *      (a long) and the characters:
+ *        L location           ListPutLocation
+ *        D size, data         ListPutData (size is a byte)
+ *        S data               ListPutSymbol
+ *        T name               ListPutTypeName
+ *        P line no., line     ListPutSourceLine
+ *        E message            ListWriteError
+ *        W                    ListWriteLine
+ *        F                    ListWriteLine while listing was off
+ *        C statistics         ListClose (the last record)
+ *
  *      Author: Frank Schaeckermann
  *
  *        Date: 2003-08-14
@@ -84,17 +104,20 @@
 
 #include "pila.h"
 
-void ListInitialize(char *listFileName);
+boolean ListInitialize(char *listFileName);
 void ListClose(char *szErrors);
 void ListStartListing();
 void ListEnable();
 void ListDisable();
-boolean ListWriteError(char *errorMsg);
+void ListWriteError(char *errorMsg);
 void ListWriteLine();
 void ListPutSourceLine(char *sourceLine,int sourceLineNo);
 void ListPutLocation(unsigned long outputLocation);
 void ListPutSymbol(long data);
 void ListPutTypeName(char *name);
 void ListPutData(long data, int size);
+int  ListRender(char *binaryName, char *listFileName);
+
+#define LIST_BINARY_MAGIC "PilaLst\001"
 
 #endif
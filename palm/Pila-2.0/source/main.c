@@ -4,9 +4,9 @@
  *      Main Module for 68000 Assembler
  *
  *    Function: main()
- *      Parses the command line, opens the input file and
- *      output files, and calls processFile() to perform the
- *      assembly, then closes all files.
+ *      Parses the command line and calls BatchAssemble() (see
+ *      batch.h) to assemble the input files and write their
+ *      PRC files, or hands it to a pila server (see server.h).
  *
  *   Usage: main(argc, argv);
  *      int argc;
@@ -24,140 +24,57 @@
  *
  ************************************************************************/
 
-/* F. Schaeckermann --- moved ifndef unix block up before "#include asm.h" due to      */
-/* 2003-07-23       --- conflict with #define WORD in asm.h and it's usage in windef.h */
-// for htonl and ntohl
-#ifndef unix
-    #include <winsock.h>
-#else
-    #include <asm/byteorder.h>
-#endif
-
 #include "pila.h"
-#include "asm.h"
-#include "prc.h"
-#include "safe-ctype.h"
 #include "options.h"
-
-char   gszAppName[dmDBNameLength] = "";		/* application name from APPL directive */
-FourCC gfcPrcType = MAKE4CC('a','p','p','l');	/* database type, default is 'appl' */
-char  *pilafilename = NULL;			/* input file name */
-
-#define _NO_EXTERN_GLOBAL_OPTIONS
-options globalOptions;				/* command line options */
+#include "batch.h"
+#include "server.h"
 
 /* General */
 const char *progname; /* the program's name under which it was called */
 
-long gulOutLoc;     /* The assembler's location counter */
-int giPass;         /* Counter telling what pass we are on (0, 1 or 2) */
-boolean endFlag;       /* Flag set when the END directive is encountered */
-
-//
-//
-//
-
-BlockType gbt;
-unsigned char *gpbCode;
-long gulCodeLoc;
-
-unsigned char *gpbData;
-long gulDataLoc;
-
-unsigned char *gpbResource;
-long gulResLoc;
-unsigned long gfcResType;
-long gidRes;
-long gcbResTotal;
-
-unsigned char *gpbOutput;
-
-
 
 int main(int argc, char *argv[])
 {
-    extern long gcbDataCompressed;
-    char pszFile[_MAX_PATH], outName[_MAX_PATH], *p;
-    int i;
-    long cbRes, cbPrc;
-    char szErrors[80];
+    extern char *pilafilename;
+    int rc, fArgsOk;
 
 	pilafilename = argv[0];
 
-    puts("Pila 2.0 Beta ("__DATE__" "__TIME__")\n");
+    fArgsOk = SetArgFlags(argc, argv);
 
-    i = SetArgFlags(argc, argv);
-    if (!i) {
+    /* With -M stdout is the make rule and nothing else */
+    fprintf(fArgsOk && DEPENDS_TO_STDOUT(&globalOptions) ? stderr : stdout,
+            "Pila 2.0 Beta ("__DATE__" "__TIME__")\n\n");
+
+    if (!fArgsOk) {
         help();
     }
 
-    gszAppName[0] = 0;
+    if (OPTION(server_socket)) {
+        return ServerRun(OPTION(server_socket));
+    }
 
     /* Check whether a name was specified */
 
-    if (i >= argc) {
+    if (!OPTION(in_fname)) {
         fputs("No input file specified\n\n", stdout);
         help();
     }
 
-    if (!strcmp("?", argv[i])) {
+    if (!strcmp("?", OPTION(in_fname))) {
         help();
     }
 
-    strcpy(pszFile, argv[i]);
-
-    /* Process output file names in their own buffer */
-    strcpy(outName, pszFile);
-
-    /* Change extension to .lis */
-    p = strchr(outName, '.');
-    if (!p) {
-        p = outName + strlen(outName);
-    }
-    if (OPTION(listing))
-    {
-        strcpy(p, ".lis");
-        ListInitialize(outName);
-    }
-
-    strcpy(p, ".prc");
-
-    /* Assemble the file */
-    SymbolInitialize();
-    processFile(pszFile);
-
-    /* Close files and print error and warning counts */
-    //PopSourceFile();
-
-    // Get the resource total before WritePrc adds in the code and data
-    // resources.
-    cbRes = gcbResTotal;
-
-    // If no errors, write the PRC file.
-    cbPrc = 0;
-    if (ErrorGetErrorCount()==0) {
-        cbPrc = WritePrc(outName, gszAppName, gpbCode, gulCodeLoc, gpbData, gulDataLoc);
-        fprintf(stdout, "Code: %ld bytes\nData: %ld bytes (%ld compressed)\n"
-                "Res:  %ld bytes\nPRC:  %ld bytes\n",
-                gulCodeLoc, gulDataLoc, gcbDataCompressed, cbRes, cbPrc);
+    /* Let the server do it if there is one. It only sends stdout back, */
+    /* so not with -M, which needs stderr as well. */
+    if (OPTION(connect_socket) && !DEPENDS_TO_STDOUT(&globalOptions)) {
+        rc = ServerRequest(OPTION(connect_socket), argc, argv);
+        if (rc >= 0) {
+            return rc;
+        }
     }
 
-    sprintf(szErrors, "%d error%s, %d warning%s\n",
-            ErrorGetErrorCount(),   (ErrorGetErrorCount()!= 1)  ? "s" : "",
-            ErrorGetWarningCount(), (ErrorGetWarningCount()!=1) ? "s" : "");
-
-    fprintf(stdout, szErrors);
-
-    ListClose(szErrors);
-
-    return ErrorGetErrorCount();
+    /* Assemble the files and write their PRC files */
+    return BatchAssemble(OPTION(in_fnames), OPTION(in_count), OPTION(jobs),
+                         &globalOptions);
 }
-
-
-char *skipSpace(char *p)
-{
-  while (ISSPACE(*p)) p++;
-  return p;
-}
-
-
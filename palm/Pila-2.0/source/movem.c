@@ -58,8 +58,8 @@
 #define SourceModes (ControlAlt | AnIndPost | PCDisp | PCIndex)
 
 
-extern long gulOutLoc;
-extern int  giPass;
+extern PILA_STATE long gulOutLoc;
+extern PILA_STATE int  giPass;
 
 
 int movem(int size, char *label, char *op)
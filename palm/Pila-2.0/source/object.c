@@ -3,35 +3,119 @@
 // Author: Darrin Massena (darrin@massena.com)
 // Date: 6/24/96
 
-/* F. Schaeckermann --- moved ifndef unix block up before "#include asm.h" due to      */
-/* 2003-07-23       --- conflict with #define WORD in asm.h and it's usage in windef.h */
-// for htonl and ntohl
-#ifndef unix
-    #include <winsock.h>
-#else
-    #include <asm/byteorder.h>
-#endif
-
 #include "pila.h"
 #include "asm.h"
 #include "prc.h"
+#include "libiberty.h"
 
-int outputObj(long lOutLoc, long data, int size)
+// Allocated sizes of the code, data and resource buffers. They start
+// small and double whenever something is written beyond their end.
+static PILA_STATE long gcbCodeAlloc;
+static PILA_STATE long gcbDataAlloc;
+static PILA_STATE long gcbResAlloc;
+
+void OutputInitialize(void)
+{
+    free(gpbCode);
+    free(gpbData);
+    free(gpbResource);
+    gcbCodeAlloc = gcbDataAlloc = gcbResAlloc = kcbOutputChunk;
+    gpbCode = (unsigned char *)xcalloc(1, gcbCodeAlloc);
+    gpbData = (unsigned char *)xcalloc(1, gcbDataAlloc);
+    gpbResource = (unsigned char *)xcalloc(1, gcbResAlloc);
+    gpbOutput = gpbCode;
+}
+
+// Hands the code buffer over to the caller and starts a new one (for the
+// next code segment).
+
+unsigned char *OutputTakeCode(void)
+{
+    unsigned char *pb = gpbCode;
+
+    gcbCodeAlloc = kcbOutputChunk;
+    gpbCode = (unsigned char *)xcalloc(1, gcbCodeAlloc);
+    if (gbt == kbtCode) {
+        gpbOutput = gpbCode;
+    }
+    return pb;
+}
+
+// Returns where location lOutLoc of the current block is in its buffer:
+// code segments start at gulCodeBase.
+
+long OutputOffset(long lOutLoc)
+{
+    return gbt == kbtCode ? lOutLoc - gulCodeBase : lOutLoc;
+}
+
+// Makes room for cb bytes at lOutLoc in the buffer of the current block
+// (gbt) and returns where they go. Bytes that were skipped (org, align,
+// ds before pass 2) are zero. Returns NULL if the block would grow beyond
+// kcbBlockMax.
+
+unsigned char *OutputReserve(long lOutLoc, long cb)
 {
-    unsigned char *pbOutput = gpbOutput + lOutLoc;
+    unsigned char **ppb;
+    long *pcbAlloc;
+    long cbAlloc;
 
-    switch (size) {
-    case BYTE:
-        *(unsigned char *)pbOutput = (unsigned char)data;
+    switch (gbt) {
+    case kbtData:
+        ppb = &gpbData;
+        pcbAlloc = &gcbDataAlloc;
         break;
-    case WORD:
-        *(unsigned short *)pbOutput = htons((unsigned short)data);
+    case kbtResource:
+        ppb = &gpbResource;
+        pcbAlloc = &gcbResAlloc;
         break;
-    case LONG:
-        *(unsigned long *)pbOutput = htonl((unsigned long)data);
+    default:
+        ppb = &gpbCode;
+        pcbAlloc = &gcbCodeAlloc;
         break;
     }
 
-    return NORMAL;
+    lOutLoc = OutputOffset(lOutLoc);
+    if (lOutLoc < 0 || lOutLoc > kcbBlockMax - cb) {
+        Error(BLOCK_TOO_BIG, NULL);
+        return NULL;
+    }
+    if (lOutLoc <= kcbChunkMax && lOutLoc + cb > kcbChunkMax) {
+        Error(BLOCK_OVER_64K, NULL);
+    }
+
+    if (lOutLoc + cb > *pcbAlloc) {
+        for (cbAlloc = *pcbAlloc; cbAlloc < lOutLoc + cb; cbAlloc *= 2)
+            ;
+        *ppb = (unsigned char *)xrealloc(*ppb, cbAlloc);
+        memset(*ppb + *pcbAlloc, 0, cbAlloc - *pcbAlloc);
+        *pcbAlloc = cbAlloc;
+    }
+
+    gpbOutput = *ppb;
+    return *ppb + lOutLoc;
 }
 
+// Writes data big-endian one byte at a time: a long is 8 bytes on some
+// hosts, and the location may be odd.
+
+int outputObj(long lOutLoc, long data, int size)
+{
+    unsigned char *pbOutput;
+    int ib;
+
+    if (size != BYTE && size != WORD && size != LONG) {
+        return NORMAL;
+    }
+    pbOutput = OutputReserve(lOutLoc, size);
+    if (pbOutput == NULL) {
+        return NORMAL;
+    }
+
+    for (ib = size - 1; ib >= 0; ib--) {
+        pbOutput[ib] = (unsigned char)data;
+        data >>= 8;
+    }
+
+    return NORMAL;
+}
@@ -0,0 +1,469 @@
+/**********************************************************************************
+ *
+ *      OBJFILE.C
+ *
+ *      Relocatable object files: noting imports and relocations while
+ *      assembling, writing the object file and reading it again.
+ *
+ *      See objfile.h for a description of the functions.
+ *
+ *********************************************************************************/
+
+#include "pila.h"
+#include "asm.h"
+#include "prc.h"
+#include "options.h"
+#include "libiberty.h"
+#include "obstack.h"
+#include "objfile.h"
+
+#define obstack_chunk_alloc xmalloc
+#define obstack_chunk_free  free
+
+extern PILA_STATE int    giPass;
+extern PILA_STATE char   gszAppName[dmDBNameLength];
+extern PILA_STATE FourCC gfcCreatorId;
+
+#define OBJ_MAGIC       "PilaObj"
+#define OBJ_VERSION     1
+
+// Import i stands for the addresses around kObjImportBase + (i+1/2) *
+// kObjImportStride, far beyond code and data (kcbBlockMax).
+#define kObjImportBase      0x40000000L
+#define kObjImportStride    0x40000L
+#define kObjImportMax       ((0x7FFFFFFFL - kObjImportBase) / kObjImportStride)
+
+static PILA_STATE char    **objImports = NULL;      // names of the imported symbols
+static PILA_STATE int      *objImportKinds = NULL;  // kObjSymImport... (0 if not used)
+static PILA_STATE int       objImportCount = 0;
+static PILA_STATE int       objImportAlloc = 0;
+static PILA_STATE ObjReloc *objRelocs = NULL;
+static PILA_STATE int       objRelocCount = 0;
+static PILA_STATE int       objRelocAlloc = 0;
+
+
+void ObjectFlush()
+{
+  int i;
+
+  for (i = 0; i < objImportCount; i++)
+    free(objImports[i]);
+  free(objImports);
+  free(objImportKinds);
+  free(objRelocs);
+  objImports = NULL;
+  objImportKinds = NULL;
+  objRelocs = NULL;
+  objImportCount = objImportAlloc = 0;
+  objRelocCount = objRelocAlloc = 0;
+}
+
+
+static long ObjectImportAddress(int i)
+{
+  return kObjImportBase + i * kObjImportStride + kObjImportStride / 2;
+}
+
+
+/* returns the index of the import value belongs to (-1 if none) */
+static int ObjectImportIndex(long value)
+{
+  long i;
+
+  if (value < kObjImportBase)
+    return -1;
+  i = (value - kObjImportBase) / kObjImportStride;
+  return i < objImportCount ? (int)i : -1;
+}
+
+
+long ObjectImport(char *id)
+{
+  int i;
+
+  // there are only a few, so they are simply looked through
+  for (i = 0; i < objImportCount; i++)
+    if (strcmp(objImports[i], id) == 0)
+      return ObjectImportAddress(i);
+
+  if (objImportCount == kObjImportMax)
+  {
+    Error(TOO_MANY_IMPORTS, id);
+    return ObjectImportAddress(0);
+  }
+  if (objImportCount == objImportAlloc)
+  {
+    objImportAlloc = 2 * objImportAlloc + 16;
+    objImports = xrealloc(objImports, objImportAlloc * sizeof(char *));
+    objImportKinds = xrealloc(objImportKinds, objImportAlloc * sizeof(int));
+  }
+  objImports[objImportCount] = xstrdup(id);
+  objImportKinds[objImportCount] = 0;
+  return ObjectImportAddress(objImportCount++);
+}
+
+
+boolean ObjectRelocate(long lLoc, int size, Value *value, int how)
+{
+  SymbolCategory cat;
+  ObjReloc      *reloc;
+  int            i;
+
+  if (!OPTION(object) || giPass != 2)
+    return false;
+  cat = SymbolGetCategory(value->kind);
+  if (cat != symbolCategoryCode && cat != symbolCategoryData)
+    return false;
+
+  i = ObjectImportIndex(value->value);
+  if (i < 0 && how == kRelocPc)
+    return false;	// stays the same wherever the module's code goes
+  if (gbt == kbtResource)
+  {
+    // resources are not relocated
+    if (i >= 0)
+      Error(IMPORT_NOT_RELOCATABLE, objImports[i]);
+    return i >= 0;
+  }
+
+  if (objRelocCount == objRelocAlloc)
+  {
+    objRelocAlloc = 2 * objRelocAlloc + 64;
+    objRelocs = xrealloc(objRelocs, objRelocAlloc * sizeof(ObjReloc));
+  }
+  reloc = &objRelocs[objRelocCount++];
+  reloc->block = gbt;
+  reloc->loc   = lLoc;
+  reloc->size  = size;
+  reloc->how   = how;
+  if (i >= 0)
+  {
+    reloc->target = i;
+    reloc->addend = value->value - ObjectImportAddress(i);
+    if (!objImportKinds[i])
+      objImportKinds[i] = cat == symbolCategoryCode ? kObjSymImportCode : kObjSymImportData;
+  }
+  else
+  {
+    reloc->target = cat == symbolCategoryCode ? kObjTargetCode : kObjTargetData;
+    reloc->addend = value->value;
+  }
+  return i >= 0;
+}
+
+
+//
+// Writing the object file
+//
+
+typedef struct
+{
+  struct obstack symbols;	// ObjSymbol records (names are pool offsets)
+  struct obstack pool;
+} ObjWriter;
+
+
+static void ObjectPut(struct obstack *ob, long l)
+{
+  obstack_1grow(ob, (char)(l >> 24));
+  obstack_1grow(ob, (char)(l >> 16));
+  obstack_1grow(ob, (char)(l >> 8));
+  obstack_1grow(ob, (char)l);
+}
+
+
+static long ObjectAddName(ObjWriter *w, char *name)
+{
+  long offset = obstack_object_size(&w->pool);
+
+  obstack_grow(&w->pool, name, strlen(name) + 1);
+  return offset;
+}
+
+
+static void ObjectAddSymbol(ObjWriter *w, char *name, int kind, long value)
+{
+  ObjSymbol sym;
+
+  sym.name  = (char *)ObjectAddName(w, name);
+  sym.kind  = kind;
+  sym.value = value;
+  obstack_grow(&w->symbols, &sym, sizeof(sym));
+}
+
+
+static void ObjectCollectExport(char *id, SymbolDef *global, boolean missed, void *data)
+{
+  SymbolKind kind;
+
+  if (!global || SymbolGetRedefineable(global))
+    return;
+  kind = SymbolGetKind(global);
+  if (kind == symbolKindProcEntry || kind == symbolKindProxyEntry)
+    ObjectAddSymbol(data, id, kObjSymCode, SymbolGetValue(global));
+  else if (kind == symbolKindData && ObjectImportIndex(SymbolGetValue(global)) < 0)
+    ObjectAddSymbol(data, id, kObjSymData, SymbolGetValue(global));
+}
+
+
+long ObjectWrite(unsigned char **ppb)
+{
+  ResourceMapEntry *arme;
+  ObjWriter         w;
+  ObjSymbol        *syms;
+  ObjReloc         *reloc;
+  struct obstack    ob;
+  int              *importSymbols, cSymbols, cResources, i;
+  long              appName, cb;
+
+  obstack_init(&w.symbols);
+  obstack_init(&w.pool);
+
+  SymbolForEachId(ObjectCollectExport, &w);
+  importSymbols = xmalloc((objImportCount + 1) * sizeof(int));
+  for (i = 0; i < objImportCount; i++)
+  {
+    importSymbols[i] = obstack_object_size(&w.symbols) / sizeof(ObjSymbol);
+    if (objImportKinds[i])
+      ObjectAddSymbol(&w, objImports[i], objImportKinds[i], 0);
+  }
+  cSymbols = obstack_object_size(&w.symbols) / sizeof(ObjSymbol);
+  syms = (ObjSymbol *)obstack_finish(&w.symbols);
+
+  appName = gszAppName[0] ? ObjectAddName(&w, gszAppName) : kObjNone;
+  cResources = PrcGetResources(&arme);
+
+  obstack_init(&ob);
+  obstack_grow(&ob, OBJ_MAGIC, sizeof(OBJ_MAGIC));
+  ObjectPut(&ob, OBJ_VERSION);
+  ObjectPut(&ob, gulCodeLoc);
+  ObjectPut(&ob, gulDataLoc);
+  ObjectPut(&ob, cResources);
+  ObjectPut(&ob, cSymbols);
+  ObjectPut(&ob, objRelocCount);
+  ObjectPut(&ob, obstack_object_size(&w.pool));
+  ObjectPut(&ob, appName);
+  ObjectPut(&ob, gfcCreatorId);
+  obstack_grow(&ob, gpbCode, gulCodeLoc);
+  obstack_grow(&ob, gpbData, gulDataLoc);
+
+  for (i = 0; i < cResources; i++)
+  {
+    ObjectPut(&ob, arme[i].fcType);
+    ObjectPut(&ob, arme[i].usId);
+    ObjectPut(&ob, arme[i].cbData);
+    obstack_grow(&ob, arme[i].pbData, arme[i].cbData);
+  }
+
+  for (i = 0; i < cSymbols; i++)
+  {
+    ObjectPut(&ob, (long)syms[i].name);
+    ObjectPut(&ob, syms[i].kind);
+    ObjectPut(&ob, syms[i].value);
+  }
+
+  for (i = 0, reloc = objRelocs; i < objRelocCount; i++, reloc++)
+  {
+    ObjectPut(&ob, reloc->block);
+    ObjectPut(&ob, reloc->loc);
+    ObjectPut(&ob, reloc->size);
+    ObjectPut(&ob, reloc->how);
+    ObjectPut(&ob, reloc->target >= 0 ? importSymbols[reloc->target] : reloc->target);
+    ObjectPut(&ob, reloc->addend);
+  }
+
+  obstack_grow(&ob, obstack_base(&w.pool), obstack_object_size(&w.pool));
+
+  cb = obstack_object_size(&ob);
+  *ppb = xmalloc(cb);
+  memcpy(*ppb, obstack_base(&ob), cb);
+
+  free(importSymbols);
+  obstack_free(&ob, NULL);
+  obstack_free(&w.symbols, NULL);
+  obstack_free(&w.pool, NULL);
+  return cb;
+}
+
+
+//
+// Reading the object file
+//
+
+typedef struct
+{
+  unsigned char *pb;
+  long           cb;
+  long           ib;	// where the next number is read from
+  boolean        failed;
+} ObjReader;
+
+
+static long ObjectGet(ObjReader *r)
+{
+  unsigned long ul;
+
+  if (r->ib > r->cb - 4)
+  {
+    r->failed = true;
+    return 0;
+  }
+  ul = ((unsigned long)r->pb[r->ib] << 24) | ((unsigned long)r->pb[r->ib+1] << 16) |
+       ((unsigned long)r->pb[r->ib+2] << 8) | r->pb[r->ib+3];
+  r->ib += 4;
+
+  // the numbers are signed 32 bit values, a long may be bigger
+  if (ul & 0x80000000UL)
+    return -(long)(~ul & 0x7FFFFFFFUL) - 1;
+  return (long)ul;
+}
+
+
+/* returns the next cb bytes (NULL if there aren't as many) */
+static unsigned char *ObjectGetBytes(ObjReader *r, long cb)
+{
+  unsigned char *pb = r->pb + r->ib;
+
+  if (cb < 0 || cb > r->cb - r->ib)
+  {
+    r->failed = true;
+    return NULL;
+  }
+  r->ib += cb;
+  return pb;
+}
+
+
+/* returns the name at offset in the pool (NULL if there is none) */
+static char *ObjectGetName(char *pool, long cbPool, long offset)
+{
+  if (offset < 0 || offset >= cbPool)
+    return NULL;
+  return pool + offset;
+}
+
+
+ObjModule *ObjectLoad(char *name, unsigned char *pb, long cb)
+{
+  ObjReader  r;
+  ObjModule *mod;
+  ObjReloc  *reloc;
+  char      *pool;
+  long       cbPool, appName, cbBlock;
+  int        i;
+
+  if (cb < (long)sizeof(OBJ_MAGIC) || memcmp(pb, OBJ_MAGIC, sizeof(OBJ_MAGIC)) != 0)
+  {
+    fprintf(gpfilMsg, "%s is not a Pila object file\n", name);
+    return NULL;
+  }
+  r.pb = pb;
+  r.cb = cb;
+  r.ib = sizeof(OBJ_MAGIC);
+  r.failed = false;
+  if (ObjectGet(&r) != OBJ_VERSION)
+  {
+    fprintf(gpfilMsg, "%s was written by another version of Pila\n", name);
+    return NULL;
+  }
+
+  mod = xcalloc(1, sizeof(ObjModule));
+  strncpy(mod->name, name, sizeof(mod->name) - 1);
+  mod->cbCode     = ObjectGet(&r);
+  mod->cbData     = ObjectGet(&r);
+  mod->cResources = ObjectGet(&r);
+  mod->cSymbols   = ObjectGet(&r);
+  mod->cRelocs    = ObjectGet(&r);
+  cbPool          = ObjectGet(&r);
+  appName         = ObjectGet(&r);
+  mod->creator    = (FourCC)ObjectGet(&r) & 0xFFFFFFFFUL;
+
+  // each resource, symbol and relocation takes at least 12 bytes
+  if (r.failed || mod->cResources < 0 || mod->cSymbols < 0 || mod->cRelocs < 0 ||
+      cb / 12 < (long)mod->cResources + mod->cSymbols + mod->cRelocs)
+  {
+    fprintf(gpfilMsg, "%s is damaged\n", name);
+    ObjectFree(mod);
+    return NULL;
+  }
+  mod->resources = xcalloc(mod->cResources + 1, sizeof(ObjResource));
+  mod->symbols   = xcalloc(mod->cSymbols + 1, sizeof(ObjSymbol));
+  mod->relocs    = xcalloc(mod->cRelocs + 1, sizeof(ObjReloc));
+
+  mod->pbCode = ObjectGetBytes(&r, mod->cbCode);
+  mod->pbData = ObjectGetBytes(&r, mod->cbData);
+
+  for (i = 0; i < mod->cResources && !r.failed; i++)
+  {
+    mod->resources[i].type = (FourCC)ObjectGet(&r) & 0xFFFFFFFFUL;
+    mod->resources[i].id   = ObjectGet(&r);
+    mod->resources[i].cb   = ObjectGet(&r);
+    mod->resources[i].pb   = ObjectGetBytes(&r, mod->resources[i].cb);
+  }
+
+  // the names come last, so the symbols keep their offsets for now
+  for (i = 0; i < mod->cSymbols; i++)
+  {
+    mod->symbols[i].name  = (char *)ObjectGet(&r);
+    mod->symbols[i].kind  = ObjectGet(&r);
+    mod->symbols[i].value = ObjectGet(&r);
+  }
+
+  for (i = 0, reloc = mod->relocs; i < mod->cRelocs; i++, reloc++)
+  {
+    reloc->block  = ObjectGet(&r);
+    reloc->loc    = ObjectGet(&r);
+    reloc->size   = ObjectGet(&r);
+    reloc->how    = ObjectGet(&r);
+    reloc->target = ObjectGet(&r);
+    reloc->addend = ObjectGet(&r);
+
+    cbBlock = reloc->block == kbtCode ? mod->cbCode : mod->cbData;
+    if ((reloc->block != kbtCode && reloc->block != kbtData) ||
+        (reloc->size != BYTE && reloc->size != WORD && reloc->size != LONG) ||
+        reloc->loc < 0 || reloc->loc > cbBlock - reloc->size ||
+        reloc->how < kRelocAbs || reloc->how > kRelocPc ||
+        reloc->target < kObjTargetData || reloc->target >= mod->cSymbols)
+      r.failed = true;
+  }
+
+  pool = (char *)ObjectGetBytes(&r, cbPool);
+  if (!r.failed && (cbPool == 0 || pool[cbPool - 1] != 0))
+    r.failed = true;
+  for (i = 0; i < mod->cSymbols && !r.failed; i++)
+  {
+    mod->symbols[i].name = ObjectGetName(pool, cbPool, (long)mod->symbols[i].name);
+    if (!mod->symbols[i].name ||
+        mod->symbols[i].kind < kObjSymCode || mod->symbols[i].kind > kObjSymImportData)
+      r.failed = true;
+  }
+  for (i = 0; i < mod->cRelocs && !r.failed; i++)
+    if (mod->relocs[i].target >= 0 && mod->symbols[mod->relocs[i].target].kind < kObjSymImportCode)
+      r.failed = true;
+  if (!r.failed && appName != kObjNone)
+  {
+    mod->pszAppName = ObjectGetName(pool, cbPool, appName);
+    if (!mod->pszAppName)
+      r.failed = true;
+  }
+
+  if (r.failed)
+  {
+    fprintf(gpfilMsg, "%s is damaged\n", name);
+    ObjectFree(mod);
+    return NULL;
+  }
+  return mod;
+}
+
+
+void ObjectFree(ObjModule *mod)
+{
+  if (mod)
+  {
+    free(mod->resources);
+    free(mod->symbols);
+    free(mod->relocs);
+    free(mod);
+  }
+}
@@ -0,0 +1,142 @@
+/**********************************************************************************
+ *
+ *      OBJFILE.H
+ *
+ *      Relocatable object files. "pila --object module.asm" writes the code,
+ *      data and resources of module.asm to module.o instead of making a PRC,
+ *      along with the symbols it exports and imports and a relocation for
+ *      every place that depends on where the linker (pila-ld, see link.h)
+ *      puts things.
+ *
+ *      A module exports its procedures, proxies and data labels (global
+ *      variables among them). It imports the procedures it declares with
+ *      procdef and calls without defining them, and the variables it
+ *      declares with extern. While assembling, an imported symbol stands
+ *      for an address of its own far beyond any code or data (see
+ *      ObjectImport), so it can take part in expressions like any other
+ *      label as long as only constants are added to it.
+ *
+ *      There are three kinds of relocations:
+ *
+ *        kRelocAbs   the field holds a code location or A5 offset
+ *                    (dc.l label, #label, absolute addresses)
+ *        kRelocDisp  the field is an address register displacement, A5
+ *                    relative for data (label(a5))
+ *        kRelocPc    the field is a PC relative displacement from the
+ *                    word it is in (jsr label(pc), bsr label)
+ *
+ *      References within the module's own code that are PC relative need
+ *      no relocation. All numbers in the file are 32 bit big-endian, so
+ *      object files can be used on any host. The file starts with the
+ *      magic "PilaObj" and the version, followed by
+ *
+ *        the sizes of the code and the data, the number of resources,
+ *        symbols and relocations, the size of the name pool, the
+ *        application name (kObjNone if no appl directive) and creator,
+ *        the code and the data,
+ *        per resource its type, id, size and data,
+ *        per symbol its name, kind (kObjSym...) and value,
+ *        per relocation its block (kbtCode or kbtData), location, size
+ *        (1, 2 or 4 bytes), kind (kReloc...), target (kObjTargetCode,
+ *        kObjTargetData or the index of an imported symbol) and the value
+ *        to add to the target's address,
+ *        the name pool ('\0' terminated names; names are offsets into it).
+ *
+ *      ObjectFlush()
+ *        Forgets about the imports and relocations of the last assembly.
+ *
+ *      ObjectImport(char *id)
+ *        Returns the address imported symbol id stands for.
+ *
+ *      ObjectRelocate(long lLoc, int size, Value *value, int how)
+ *        Called for each value that goes into the code or data on pass 2
+ *        with where it goes (lLoc) and how it is used. Notes a relocation
+ *        if the value is a code or data location and the object file is
+ *        being written. Returns true if the linker fills the field in all
+ *        by itself (the value is an imported symbol's), in which case the
+ *        caller writes 0 to it.
+ *
+ *      ObjectWrite(unsigned char **ppb)
+ *        Puts the object file of the assembly just finished into a buffer
+ *        of its own (*ppb, the caller frees it) and returns its size.
+ *
+ *      ObjectLoad(char *name, unsigned char *pb, long cb)
+ *        Reads the object file in pb (name is used for messages). Returns
+ *        the module or NULL (after printing why) if pb doesn't hold one.
+ *        The module keeps pointers into pb, which has to stay around.
+ *
+ *      ObjectFree(ObjModule *mod)
+ *        Frees what ObjectLoad allocated.
+ *
+ *********************************************************************************/
+
+#ifndef _OBJFILE_H_
+#define _OBJFILE_H_
+
+#include "asm.h"
+#include "prc.h"
+
+#define kRelocAbs       0
+#define kRelocDisp      1
+#define kRelocPc        2
+
+#define kObjNone        (-1)
+
+#define kObjSymCode         1   // procedure or proxy of the module
+#define kObjSymData         2   // data label of the module
+#define kObjSymImportCode   3   // procedure declared with procdef
+#define kObjSymImportData   4   // variable declared with extern
+
+#define kObjTargetCode  (-1)    // the module's own code
+#define kObjTargetData  (-2)    // the module's own data
+
+typedef struct
+{
+  FourCC         type;
+  int            id;
+  unsigned char *pb;
+  long           cb;
+} ObjResource;
+
+typedef struct
+{
+  char *name;
+  int   kind;
+  long  value;
+} ObjSymbol;
+
+typedef struct
+{
+  BlockType block;
+  long      loc;
+  int       size;
+  int       how;
+  int       target;
+  long      addend;
+} ObjReloc;
+
+typedef struct
+{
+  char           name[_MAX_PATH];
+  unsigned char *pbCode;
+  long           cbCode;
+  unsigned char *pbData;
+  long           cbData;
+  ObjResource   *resources;
+  int            cResources;
+  ObjSymbol     *symbols;
+  int            cSymbols;
+  ObjReloc      *relocs;
+  int            cRelocs;
+  char          *pszAppName;    // NULL if the module has no appl directive
+  FourCC         creator;
+} ObjModule;
+
+void       ObjectFlush();
+long       ObjectImport(char *id);
+boolean    ObjectRelocate(long lLoc, int size, Value *value, int how);
+long       ObjectWrite(unsigned char **ppb);
+ObjModule *ObjectLoad(char *name, unsigned char *pb, long cb);
+void       ObjectFree(ObjModule *mod);
+
+#endif
@@ -51,21 +51,217 @@
 #include "asm.h"
 
 #include "safe-ctype.h"
-#include "strcap.h"
 #include "guard.h"
+#include "options.h"
 
-extern int giPass;
+extern PILA_STATE int giPass;
 
 #define isTerm(c)   (ISSPACE(c) || (c==',') || c=='\0' || c==';')
 #define isRegNum(c) ((c >= '0') && (c <= '7'))
 
+/* The operand is read as a sequence of tokens right out of the line, each
+   one noted with where it starts and how long it is. Register names are
+   recognized regardless of case, so nothing needs to be copied or
+   uppercased. */
+typedef enum
+{
+    tokEnd,         /* end of the line or a comment */
+    tokComma,
+    tokLParen,
+    tokRParen,
+    tokPlus,
+    tokMinus,
+    tokDot,
+    tokDReg,        /* D0-D7 */
+    tokAReg,        /* A0-A7 and SP */
+    tokPC,
+    tokSR,
+    tokCCR,
+    tokUSP,
+    tokSFC,
+    tokDFC,
+    tokVBR,
+    tokWord,        /* any other name or number */
+    tokOther
+} OpTokenKind;
+
+typedef struct
+{
+    OpTokenKind kind;
+    char       *start;  /* where the token is in the line */
+    int         len;
+    int         reg;    /* register number of tokDReg and tokAReg */
+} OpToken;
+
+static const struct
+{
+    char        name[4];
+    OpTokenKind kind;
+} opRegisterNames[] =
+{
+    { "SP",  tokAReg },
+    { "PC",  tokPC   },
+    { "SR",  tokSR   },
+    { "CCR", tokCCR  },
+    { "USP", tokUSP  },
+    { "SFC", tokSFC  },
+    { "DFC", tokDFC  },
+    { "VBR", tokVBR  },
+};
+
+#define isWordChar(c) (ISALNUM(c) || c=='_' || c=='$' || c=='?' || c=='@')
+
+/* returns true if the len characters at p spell name (given in upper case) */
+static boolean opNameIs(char *p, int len, const char *name)
+{
+    int i;
+
+    for (i = 0; i < len; i++) {
+        if (TOUPPER(p[i]) != name[i]) {
+            return false;
+        }
+    }
+    return name[len] == '\0';
+}
+
+/* reads the token at p (after any blanks) into t and returns the
+   position right after it */
+static char *opToken(char *p, OpToken *t)
+{
+    int i;
+
+    p = skipSpace(p);
+    t->start = p;
+    t->len   = 1;
+    t->reg   = 0;
+
+    switch (*p) {
+    case '\0':
+    case ';':
+        t->kind = tokEnd;
+        t->len  = 0;
+        return p;
+    case ',': t->kind = tokComma;  break;
+    case '(': t->kind = tokLParen; break;
+    case ')': t->kind = tokRParen; break;
+    case '+': t->kind = tokPlus;   break;
+    case '-': t->kind = tokMinus;  break;
+    case '.': t->kind = tokDot;    break;
+    default:
+        if (!isWordChar(*p)) {
+            t->kind = tokOther;
+            break;
+        }
+        while (isWordChar(p[t->len])) {
+            t->len++;
+        }
+        t->kind = tokWord;
+        if (t->len == 2 && isRegNum(p[1]) && (TOUPPER(p[0]) == 'D' || TOUPPER(p[0]) == 'A')) {
+            t->kind = TOUPPER(p[0]) == 'D' ? tokDReg : tokAReg;
+            t->reg  = p[1] - '0';
+        } else {
+            for (i = 0; i < sizeof(opRegisterNames)/sizeof(opRegisterNames[0]); i++) {
+                if (opNameIs(p, t->len, opRegisterNames[i].name)) {
+                    t->kind = opRegisterNames[i].kind;
+                    t->reg  = 7;    /* SP is A7 */
+                    break;
+                }
+            }
+        }
+        break;
+    }
+    return p + t->len;
+}
+
+/* returns true if nothing but blanks is left of the operand at p */
+static boolean opIsTerm(char *p)
+{
+    p = skipSpace(p);
+    return (*p == '\0' || *p == ',' || *p == ';');
+}
+
+/* Recognizes "(An)", "(An)+", "(An,Xn.s)", "(PC)" and "(PC,Xn.s)" with p
+   at the '('. A postincrement is only taken if there is no displacement.
+   Sets d->mode (AnInd for "(An)"), d->reg and the index and returns the
+   position right after it. Returns NULL if p is none of these and sets
+   *pfError as well if it reported an error in the index part. */
+static char *opIndirect(char *p, opDescriptor *d, boolean displaced, boolean *pfError)
+{
+    OpToken base, tok;
+
+    *pfError = false;
+    p = opToken(p, &tok);
+    p = opToken(p, &base);
+    if (tok.kind != tokLParen || (base.kind != tokAReg && base.kind != tokPC)) {
+        return NULL;
+    }
+    if (base.kind == tokAReg) {
+        d->reg = base.reg;
+    }
+
+    p = opToken(p, &tok);
+    if (tok.kind == tokRParen) {
+        if (base.kind == tokPC) {
+            d->mode = PCDisp;
+            return p;
+        }
+        /* Check for postincrement */
+        if (!displaced && !opIsTerm(p)) {
+            p = opToken(p, &tok);
+            if (tok.kind != tokPlus) {
+                return NULL;
+            }
+            d->mode = AnIndPost;
+            return p;
+        }
+        d->mode = AnInd;
+        return p;
+    }
+
+    /* Check for an index register */
+    if (tok.kind != tokComma) {
+        return NULL;
+    }
+    p = opToken(p, &tok);
+    if (tok.kind != tokDReg && tok.kind != tokAReg) {
+        return NULL;
+    }
+    d->mode  = base.kind == tokPC ? PCIndex : AnIndIndex;
+    d->index = tok.reg + (tok.kind == tokAReg ? 8 : 0);
+
+    p = opToken(p, &tok);
+    if (tok.kind == tokDot) {
+        /* Determine size of index register */
+        p = opToken(p, &tok);
+        if (tok.kind == tokWord && opNameIs(tok.start, tok.len, "W")) {
+            d->size = WORD;
+        } else if (tok.kind == tokWord && opNameIs(tok.start, tok.len, "L")) {
+            d->size = LONG;
+        } else {
+            Error(SYNTAX,tok.start);
+            *pfError = true;
+            return NULL;
+        }
+        p = opToken(p, &tok);
+    } else {
+        /* Default index register size is Word */
+        d->size = WORD;
+    }
+    if (tok.kind != tokRParen) {
+        Error(SYNTAX,tok.start);
+        *pfError = true;
+        return NULL;
+    }
+    return p;
+}
+
 char *_opParse(char *p, opDescriptor *d, int guardSubId)
 {
-    char szT[strlen(p)+1];
-    char *pOrig;
-    char *pTmp;
-    int cch;
-    int quoted;
+    OpToken tok, next;
+    char *pEnd;
+    boolean fError;
+
+    p = skipSpace(p);
 
     /* Check for immediate mode */
     if (p[0]=='#')
@@ -85,218 +281,83 @@ char *_opParse(char *p, opDescriptor *d, int guardSubId)
       return NULL;
     }
 
-    // remove all blanks and the comment from the line
-    // but honor quoted strings that may appear in expression
-    pOrig  = p;
-    pTmp   = p;
-    quoted = 0;
-    while(*p)
-    {
-      if (!quoted)
-      {
-        if (*p==';')
-          *p = '\0'; // cut off comment
-        else if (!ISSPACE(*p))
-        {
-          if (*p=='\'')
-            quoted = 1;
-          *(pTmp)++ = *(p++);
+    pEnd = opToken(p, &tok);
+    switch (tok.kind) {
+    /* Check for address or data register direct (SP is A7) */
+    case tokDReg:
+    case tokAReg:
+        if (opIsTerm(pEnd)) {
+            d->mode = tok.kind == tokDReg ? DnDirect : AnDirect;
+            d->reg  = tok.reg;
+            return pEnd;
         }
-        else
-          p++;
-      }
-      else
-      {
-        if (*p=='\\')
-        {
-          *(pTmp++) = *(p++);
-          if (*p)
-            *(pTmp++) = *(p++);
-        }
-        else
-        {
-          if (*p=='\'')
-            quoted = 0;
-          *(pTmp++) = *(p++);
-        }
-      }
-    }
-    *pTmp = '\0';
-    
-    if (quoted)
-    {
-      Error(UNTERMINATED_STRING,pOrig);
-      return NULL;
-    }
+        break;
 
-    strcap(szT, pOrig);
-    p = szT;
-
-    /* Check for address or data register direct */
-    if (isRegNum(p[1]) && isTerm(p[2])) {
-        if (p[0] == 'D') {
-            d->mode = DnDirect;
-            d->reg = p[1] - '0';
-            return (pOrig + 2);
-        } else if (p[0] == 'A') {
-            d->mode = AnDirect;
-            d->reg = p[1] - '0';
-            return (pOrig + 2);
+    /* Check for the special registers */
+    case tokSR:
+    case tokCCR:
+    case tokUSP:
+    case tokSFC:
+    case tokDFC:
+    case tokVBR:
+        if (opIsTerm(pEnd)) {
+            switch (tok.kind) {
+            case tokSR:  d->mode = SRDirect;  break;
+            case tokCCR: d->mode = CCRDirect; break;
+            case tokUSP: d->mode = USPDirect; break;
+            case tokSFC: d->mode = SFCDirect; break;   /* 68010 */
+            case tokDFC: d->mode = DFCDirect; break;   /* 68010 */
+            default:     d->mode = VBRDirect; break;   /* 68010 */
+            }
+            return pEnd;
         }
-    }
-    /* Check for Stack Pointer (i.e., A7) direct */
-    if (p[0] == 'S' && p[1] == 'P' && isTerm(p[2])) {
-        d->mode = AnDirect;
-        d->reg = 7;
-        return (pOrig + 2);
-    }
-    /* Check for address register indirect */
-    if (p[0] == '(' &&
-        ((p[1] == 'A' && isRegNum(p[2])) || (p[1] == 'S' && p[2] == 'P'))) {
+        break;
 
-        if (p[1] == 'S') {
-            d->reg = 7;
-        } else {
-            d->reg = p[2] - '0';
+    /* Check for address register indirect (with postincrement or
+       index) and PC relative without displacement */
+    case tokLParen:
+        pEnd = opIndirect(p, d, false, &fError);
+        if (fError) {
+            return NULL;
         }
-        if (p[3] == ')') {
-            /* Check for plain address register indirect */
-            if (isTerm(p[4])) {
-                d->mode = AnInd;
-                return pOrig+4;
-            /* Check for postincrement */
-            } else if (p[4] == '+') {
-                d->mode = AnIndPost;
-                return pOrig+5;
-            }
-        /* Check for address register indirect with index */
-        } else if (p[3] == ',' && (p[4] == 'A' || p[4] == 'D')
-                 && isRegNum(p[5])) {
-            d->mode = AnIndIndex;
+        if (pEnd) {
             /* Displacement is zero */
             d->data.value = 0;
-            d->data.kind  = symbolKindConst;
-            d->index = p[5] - '0';
-            if (p[4] == 'A') {
-                d->index += 8;
-            }
-            if (p[6] == '.') {
-                /* Determine size of index register */
-                if (p[7] == 'W') {
-                    d->size = WORD;
-                    return pOrig+9;
-                } else if (p[7] == 'L') {
-                    d->size = LONG;
-                    return pOrig+9;
-                } else {
-                    Error(SYNTAX,pOrig+7);
-                    return NULL;
-                }
-            } else if (p[6] == ')') {
-                /* Default index register size is Word */
-                d->size = WORD;
-                return pOrig+7;
-            } else {
-                Error(SYNTAX,pOrig+6);
-                return NULL;
-            }
+            d->data.kind  = (d->mode == PCDisp || d->mode == PCIndex) ? symbolKindCode
+                                                                        : symbolKindConst;
+            d->data.type  = NULL;
+            return pEnd;
         }
-    }
-    /* Check for address register indirect with predecrement */
-    if (p[0] == '-' && p[1] == '(' && p[4] == ')' &&
-        ((p[2] == 'A' && isRegNum(p[3])) || (p[2] == 'S' && p[3] == 'P'))) {
+        break;
 
-        if (p[2] == 'S') {
-            d->reg = 7;
-        } else {
-            d->reg = p[3] - '0';
-        }
-        d->mode = AnIndPre;
-        return pOrig+5;
-    }
-    /* Check for PC relative */
-    if (p[0] == '(' && p[1] == 'P' && p[2] == 'C') {
-        /* Displacement is zero */
-        d->data.value = 0;
-        d->data.kind  = symbolKindCode;
-        /* Check for plain PC relative */
-        if (p[3] == ')') {
-            d->mode = PCDisp;
-            return pOrig+4;
-        }
-        /* Check for PC relative with index */
-        else if (p[3] == ',' && (p[4] == 'A' || p[4] == 'D')
-                 && isRegNum(p[5])) {
-            d->mode = PCIndex;
-            d->index = p[5] - '0';
-            if (p[4] == 'A'){ 
-                d->index += 8;
-            }
-            if (p[6] == '.') {
-                /* Determine size of index register */
-                if (p[7] == 'W') {
-                    d->size = WORD;
-                    return pOrig+9;
-                } else if (p[7] == 'L') {
-                    d->size = LONG;
-                    return pOrig+9;
-                } else {
-                    Error(SYNTAX,pOrig+7);
-                    return NULL;
-                } 
-            } else if (p[6] == ')') {
-                /* Default size of index register is Word */
-                d->size = WORD;
-                return pOrig+7;
-            } else {
-                Error(SYNTAX,pOrig+6);
-                return NULL;
+    /* Check for address register indirect with predecrement */
+    case tokMinus:
+        pEnd = opToken(pEnd, &next);
+        if (next.kind == tokLParen) {
+            pEnd = opToken(pEnd, &next);
+            if (next.kind == tokAReg) {
+                d->reg = next.reg;
+                pEnd = opToken(pEnd, &next);
+                if (next.kind == tokRParen) {
+                    d->mode = AnIndPre;
+                    return pEnd;
+                }
             }
         }
-    }
+        break;
 
-    /* Check for Status Register direct */
-    if (p[0] == 'S' && p[1] == 'R' && isTerm(p[2])) {
-        d->mode = SRDirect;
-        return pOrig+2;
-    }
-    /* Check for Condition Code Register direct */
-    if (p[0] == 'C' && p[1] == 'C' && p[2] == 'R' && isTerm(p[3])) {
-        d->mode = CCRDirect;
-        return pOrig+3;
-    }
-    /* Check for User Stack Pointer direct */
-    if (p[0] == 'U' && p[1] == 'S' && p[2] == 'P' && isTerm(p[3])) {
-        d->mode = USPDirect;
-        return pOrig+3;
-    }
-    /* Check for Source Function Code register direct (68010) */
-    if (p[0] == 'S' && p[1] == 'F' && p[2] == 'C' && isTerm(p[3])) {
-        d->mode = SFCDirect;
-        return pOrig+3;
-    }
-    /* Check for Destination Function Code register direct (68010) */
-    if (p[0] == 'D' && p[1] == 'F' && p[2] == 'C' && isTerm(p[3])) {
-        d->mode = DFCDirect;
-        return pOrig+3;
-    }
-    /* Check for Vector Base Register direct (68010) */
-    if (p[0] == 'V' && p[1] == 'B' && p[2] == 'R' && isTerm(p[3])) {
-        d->mode = VBRDirect;
-        return pOrig+3;
+    default:
+        break;
     }
 
     /* All other addressing modes start with a constant expression */
-    pTmp = evaluate(pOrig, &(d->data));
-    if (pTmp==NULL)
+    p = evaluate(p, &(d->data));
+    if (p==NULL)
       return NULL;
-      
-    cch = pTmp-pOrig;
-    p += cch;
-    pOrig += cch;
+
     if (!ErrorStatusIsSevere()) {
         /* Check for absolute */
-        if (isTerm(p[0]))
+        if (opIsTerm(p))
         {
           if (giPass<2)
           {
@@ -321,93 +382,28 @@ char *_opParse(char *p, opDescriptor *d, int guardSubId)
             }
             d->mode = guardValue;
           }
-          return pOrig;
-        }
-        /* Check for address register indirect with displacement */
-        if (p[0] == '(' &&
-            ((p[1] == 'A' && isRegNum(p[2])) || (p[1] == 'S' && p[2] == 'P'))) {
-            if (p[1] == 'S') {
-                d->reg = 7;
-            } else {
-                d->reg = p[2] - '0';
-            }
-            /* Check for plain address register indirect with displacement */
-            if (p[3] == ')') {
-                if (d->data.value==0)
-                  d->mode = AnInd;
-                else
-                  d->mode = AnIndDisp;
-                return pOrig+4;
-            /* Check for address register indirect with index */
-            } else if (p[3] == ',' && (p[4] == 'A' || p[4] == 'D')
-                && isRegNum(p[5])) {
-                d->mode = AnIndIndex;
-                d->index = p[5] - '0';
-                if (p[4] == 'A') {
-                    d->index += 8;
-                }
-                if (p[6] == '.') {
-                    /* Determine size of index register */
-                    if (p[7] == 'W') {
-                        d->size = WORD;
-                        return pOrig+9;
-                    } else if (p[7] == 'L') {
-                        d->size = LONG;
-                        return pOrig+9;
-                    } else {
-                        Error(SYNTAX,pOrig+7);
-                        return NULL;
-                    }
-                } else if (p[6] == ')') {
-                    /* Default size of index register is Word */
-                    d->size = WORD;
-                    return pOrig+7;
-                } else {
-                    Error(SYNTAX,pOrig+6);
-                    return NULL;
-                }
-            }
+          return p;
         }
 
-        /* Check for PC relative */
-        if (p[0] == '(' && p[1] == 'P' && p[2] == 'C') {
-            /* Check for plain PC relative */
-            if (p[3] == ')') {
-                d->mode = PCDisp;
-                return pOrig+4;
-            }
-            /* Check for PC relative with index */
-            else if (p[3] == ',' && (p[4] == 'A' || p[4] == 'D')
-                && isRegNum(p[5])) {
-                d->mode = PCIndex;
-                d->index = p[5] - '0';
-                if (p[4] == 'A') {
-                    d->index += 8;
-                }
-                if (p[6] == '.') {
-                    /* Determine size of index register */
-                    if (p[7] == 'W') {
-                        d->size = WORD;
-                        return pOrig+9;
-                    } else if (p[7] == 'L') {
-                        d->size = LONG;
-                        return pOrig+9;
-                    } else {
-                        Error(SYNTAX,pOrig+7);
-                        return NULL;
-                    }
-                } else if (p[6] == ')') {
-                    /* Default size of index register is Word */
-                    d->size = WORD;
-                    return pOrig+7;
-                } else {
-                    Error(SYNTAX,pOrig+6);
-                    return NULL;
-                }
-            }
+        /* Check for address register indirect with displacement or
+           index and PC relative */
+        pEnd = opIndirect(p, d, true, &fError);
+        if (fError) {
+            return NULL;
+        }
+        if (pEnd) {
+            // a label at 0 moves when linked (see objfile.h)
+            if (d->mode==AnInd &&
+                (d->data.value!=0 ||
+                 (OPTION(object) &&
+                  (SymbolGetCategory(d->data.kind)==symbolCategoryCode ||
+                   SymbolGetCategory(d->data.kind)==symbolCategoryData))))
+              d->mode = AnIndDisp;
+            return pEnd;
         }
+
         /* If the operand doesn't match any pattern, return an error status */
-        Error(SYNTAX,pOrig);
+        Error(SYNTAX,p);
     }
 
     return NULL;
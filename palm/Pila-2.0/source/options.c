@@ -1,6 +1,7 @@
 
 #include <stdio.h>
 #include "options.h"
+#include "libiberty.h"
 
 int SetArgFlags(int cpszArgs, char *apszArgs[])
 {
@@ -8,11 +9,68 @@ int SetArgFlags(int cpszArgs, char *apszArgs[])
 
 	// set default for database_type
 	strcpy(OPTION(database_type),"appl");
+	OPTION(jobs) = 1;
+	OPTION(in_fnames) = xmalloc(cpszArgs * sizeof(char *));
 	
-    for (i = 1; i < cpszArgs && apszArgs[i][0] == '-'; i++) {
+    for (i = 1; i < cpszArgs; i++) {
         char ch;
         char *pszArg = apszArgs[i] + 1, *pch;
 
+        // input files and options may come in any order
+        if (apszArgs[i][0] != '-') {
+            if (!OPTION(in_fname)) {
+                OPTION(in_fname) = apszArgs[i];
+            }
+            OPTION(in_fnames)[OPTION(in_count)++] = apszArgs[i];
+            continue;
+        }
+
+        // long options are spelled out and can't be combined
+        if (*pszArg == '-') {
+            if (strcmp(pszArg, "-stats") == 0) {
+                OPTION(statistics) = true;
+            } else if (strcmp(pszArg, "-precompile") == 0) {
+                OPTION(precompile) = true;
+            } else if (strcmp(pszArg, "-object") == 0) {
+                OPTION(object) = true;
+            } else if (strcmp(pszArg, "-gc-procs") == 0) {
+                OPTION(gc_procs) = true;
+            } else if (strcmp(pszArg, "-binary-listing") == 0) {
+                OPTION(listing) = true;
+                OPTION(binary_listing) = true;
+            } else if (strcmp(pszArg, "-compress-bitmaps") == 0) {
+                OPTION(compress_bitmaps) = true;
+            } else if (strcmp(pszArg, "-json-errors") == 0) {
+                OPTION(json_errors) = true;
+            } else if (strcmp(pszArg, "-warn-limit") == 0 && i + 1 < cpszArgs) {
+                OPTION(warn_limit) = strtol(apszArgs[++i], &pch, 10);
+                if (*pch != 0 || OPTION(warn_limit) < 1) {
+                    fprintf(stdout, "--warn-limit requires a number of at least 1.\n");
+                    return 0;
+                }
+            } else if (strcmp(pszArg, "-timestamp") == 0 && i + 1 < cpszArgs) {
+                OPTION(fixed_timestamp) = true;
+                OPTION(timestamp) = strtol(apszArgs[++i], &pch, 10);
+                if (*pch != 0) {
+                    fprintf(stdout, "--timestamp requires the number of seconds "
+                            "since 1970.\n");
+                    return 0;
+                }
+            } else if (strcmp(pszArg, "-cache") == 0 && i + 1 < cpszArgs) {
+                OPTION(cache_dir) = apszArgs[++i];
+            } else if (strcmp(pszArg, "-server") == 0 && i + 1 < cpszArgs) {
+                OPTION(server_socket) = apszArgs[++i];
+            } else if (strcmp(pszArg, "-connect") == 0 && i + 1 < cpszArgs) {
+                OPTION(connect_socket) = apszArgs[++i];
+            } else if (strcmp(pszArg, "-if-changed") == 0) {
+                OPTION(if_changed) = true;
+            } else {
+                fprintf(stdout, "Unknown option %s\n", apszArgs[i]);
+                return 0;
+            }
+            continue;
+        }
+
         while ((ch = *pszArg++) != 0) {
             switch (ch) {
             case 'd':
@@ -34,6 +92,30 @@ int SetArgFlags(int cpszArgs, char *apszArgs[])
             case 's':
                 OPTION(emit_proc_symbols) = true;
                 break;
+            case 'M':
+                // -M, -MD and -MF FILE like gcc's, so no other letters follow
+                if (*pszArg == 0) {
+                    OPTION(depends_only) = true;
+                } else if (strcmp(pszArg, "D") == 0) {
+                    OPTION(depends) = true;
+                } else if (strcmp(pszArg, "F") == 0 && i + 1 < cpszArgs) {
+                    OPTION(depends) = true;
+                    OPTION(depends_fname) = apszArgs[++i];
+                } else {
+                    fprintf(stdout, "Unknown option %s\n", apszArgs[i]);
+                    return 0;
+                }
+                pszArg += strlen(pszArg);
+                break;
+            case 'o':
+                if (*pszArg != 0 || i + 1 >= cpszArgs) {
+                    fprintf(stdout, "-o must be followed by a space and the "
+                            "output file name.\n");
+                    return 0;
+                }
+
+                OPTION(out_fname) = apszArgs[++i];
+                break;
             case 't':
                 if (*pszArg != 0) {
                     fprintf(stdout, "-t must be followed by a space and a "
@@ -54,6 +136,19 @@ int SetArgFlags(int cpszArgs, char *apszArgs[])
 
                 strcpy(OPTION(database_type),pch);
                 break;
+            case 'j':
+                if (*pszArg != 0 || i + 1 >= cpszArgs) {
+                    fprintf(stdout, "-j must be followed by a space and the "
+                            "number of files to assemble at the same time.\n");
+                    return 0;
+                }
+
+                OPTION(jobs) = atoi(apszArgs[++i]);
+                if (OPTION(jobs) < 1) {
+                    fprintf(stdout, "-j requires a number of at least 1.\n");
+                    return 0;
+                }
+                break;
 
             default:
                 fprintf(stdout, "Unknown option -%c\n", ch);
@@ -62,7 +157,28 @@ int SetArgFlags(int cpszArgs, char *apszArgs[])
         }
     }
 
-    return i;
+    if (OPTION(object) && OPTION(precompile)) {
+        fprintf(stdout, "--object can't be used with --precompile\n");
+        return 0;
+    }
+
+    // another module may call any procedure of an object file
+    if (OPTION(object) && OPTION(gc_procs)) {
+        fprintf(stdout, "--gc-procs can't be used with --object\n");
+        return 0;
+    }
+
+    if (OPTION(out_fname) && OPTION(in_count) > 1) {
+        fprintf(stdout, "-o can't be used with more than one input file\n");
+        return 0;
+    }
+
+    if (OPTION(depends_fname) && OPTION(in_count) > 1) {
+        fprintf(stdout, "-MF can't be used with more than one input file\n");
+        return 0;
+    }
+
+    return 1;
 }
 
 
@@ -75,12 +191,39 @@ int SetArgFlags(int cpszArgs, char *apszArgs[])
 
 void help()
 {
-    puts("Usage: pila [-cldrs] [-t TYPE] infile.ext\n");
+    puts("Usage: pila [-cldrs] [-t TYPE] [-o outfile] [-M|-MD] [-MF depfile] [--gc-procs] [--stats] infile.ext");
+    puts("       pila [-cldrs] [-t TYPE] [-j N] [--gc-procs] [--stats] infile.ext...");
+    puts("       pila --precompile [-o outfile.pch] infile.inc");
+    puts("       pila --object [-o outfile.o] infile.ext...");
+    puts("       pila --server SOCKET\n");
     puts("Options: -c  Show full constant expansions for DC directives");
     puts("         -l  Produce listing file (infile.lis)");
     puts("         -d  Debugging output");
     puts("         -r  Resources only, don't generate code or data");
     puts("         -s  Include debugging symbols in output");
     puts("    -t TYPE  Specify the PRC type. Default is appl");
+    puts("    -o FILE  Write the output to FILE (default infile.prc or infile.pch)");
+    puts("       -j N  Assemble up to N of the input files at the same time");
+    puts("         -M  Print only the make rule for the files infile.prc depends on");
+    puts("             (to depfile if -MF is given) instead of writing it");
+    puts("        -MD  Write the rule to infile.d along with infile.prc");
+    puts("   -MF FILE  Write the rule to FILE (implies -MD unless -M is given)");
+    puts("  --precompile  Write the symbols of infile.inc to infile.pch, which");
+    puts("             is then used in place of infile.inc by the include directive");
+    puts("   --object  Write a relocatable object file (infile.o) for pila-ld");
+    puts("             instead of a PRC");
+    puts("  --gc-procs  Leave out the procedures and global variables nothing uses");
+    puts("  --binary-listing  Write the listing as infile.lsb, which pila-lst");
+    puts("             turns into infile.lis");
+    puts("    --stats  Print symbol table and source cache statistics");
+    puts("  --compress-bitmaps  Compress the bitmaps of 'WBMP' resources (PalmOS 3.5)");
+    puts("  --json-errors  Write errors and warnings as JSON objects, one per line");
+    puts("  --warn-limit N  Write a warning at most N times for the same source line");
+    puts("  --timestamp SECONDS  Put this time (seconds since 1970) into the PRC");
+    puts("             header instead of the current time (default $SOURCE_DATE_EPOCH)");
+    puts("  --cache DIR  Keep results in DIR and reuse them while no input changes");
+    puts("  --if-changed  Don't assemble if no input changed since the last time");
+    puts("  --server SOCKET  Keep running and assemble for pila --connect SOCKET");
+    puts("  --connect SOCKET  Have the server on SOCKET assemble (if there is one)");
     exit(0);
 }
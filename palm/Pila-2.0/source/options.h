@@ -12,6 +12,13 @@ typedef struct options
   char *in_fname;
   char *out_fname;
 
+  /* All input files (in_fname is the first of them).  */
+  char **in_fnames;
+  int in_count;
+
+  /* Number of files assembled at the same time (-j).  */
+  int jobs;
+
   /* Pending options - -D, -U, -A, -I, -ixxx.  */
   struct cpp_pending *pending;
 
@@ -54,14 +61,72 @@ typedef struct options
   /* A listing is being produced */
   unsigned char listing;
   
+  /* True if --binary-listing appeared in the options. */
+  /* The listing is written as infile.lsb for pila-lst (see listing.h) */
+  unsigned char binary_listing;
+  
+  /* True if --stats appeared in the options. */
+  /* Statistics about the symbol table etc. are printed after assembly */
+  unsigned char statistics;
+  
+  /* True if --precompile appeared in the options. */
+  /* The symbol table is written to a precompiled include instead of a PRC */
+  unsigned char precompile;
+
+  /* True if --object appeared in the options. */
+  /* A relocatable object file for pila-ld is written instead of a PRC */
+  unsigned char object;
+
+  /* True if --gc-procs appeared in the options. */
+  /* Procedures and global variables nothing uses are left out */
+  unsigned char gc_procs;
+  
+  /* True if --compress-bitmaps appeared in the options. */
+  /* Bitmaps are compressed where that saves space (see bitmap.h) */
+  unsigned char compress_bitmaps;
+
+  /* True if --json-errors appeared in the options. */
+  /* Errors and warnings are written as JSON objects, one per line */
+  unsigned char json_errors;
+
+  /* N from --warn-limit N (0: no limit). */
+  /* A warning is written at most N times for the same source line */
+  int warn_limit;
+  
+  /* True if --timestamp appeared in the options. */
+  /* The PRC header gets timestamp (seconds since 1970) instead of the time */
+  unsigned char fixed_timestamp;
+  long timestamp;
+
+  /* Directory of the build cache from --cache (NULL if none) */
+  char *cache_dir;
+
+  /* True if --if-changed appeared in the options. */
+  /* Nothing is assembled if the inputs are the same as last time */
+  unsigned char if_changed;
+
+  /* Socket to serve requests on (--server) or to send them to (--connect) */
+  char *server_socket;
+  char *connect_socket;
+
+  /* -M (only write the dependencies), -MD (write them too) and the */
+  /* name of the dependency file from -MF (NULL: infile.d or stdout) */
+  unsigned char depends_only;
+  unsigned char depends;
+  char *depends_fname;
+
   /* database type from -t option */
   char database_type[5];
 } options;
 
 #ifndef _NO_EXTERN_GLOBAL_OPTIONS
-extern options globalOptions;
+extern PILA_STATE options globalOptions;
 #endif
 
+/* -M without -MF: stdout gets nothing but the make rule (like with gcc -M), */
+/* the messages go to stderr */
+#define DEPENDS_TO_STDOUT(opts) ((opts)->depends_only && !(opts)->depends_fname)
+
 int SetArgFlags(int cpszArgs, char *apszArgs[]);
 
 #endif // !OPTIONS_H
@@ -15,6 +15,9 @@
 #include "asm.h"
 
 #include "safe-ctype.h"
+#include "options.h"
+#include "objfile.h"
+#include "procgraph.h"
 
 /**********************************************************************
  * Parsing a quoted string. The output string is padded with four
@@ -91,6 +94,7 @@ char *ParseSymbol(char *s,SymbolDef **symbol, Value *value)
       *symbol = SymbolLookup(id);
     if (*symbol)
     {
+      ProcGraphReference(*symbol);
       cat = SymbolGetCategory(SymbolGetKind(*symbol));
       if (cat!=symbolCategoryNone && cat!=symbolCategoryType)
       {
@@ -98,6 +102,16 @@ char *ParseSymbol(char *s,SymbolDef **symbol, Value *value)
         value->kind  = SymbolGetKind(*symbol);
         value->type  = SymbolGetType(*symbol);
       }
+      else if (OPTION(object) &&
+               (SymbolGetKind(*symbol)==symbolKindExtern ||
+                (SymbolGetKind(*symbol)==symbolKindProcDef && SymbolGetType(*symbol))))
+      {
+        // imported from another module (see objfile.h)
+        value->value = ObjectImport(SymbolGetId(*symbol));
+        value->kind  = SymbolGetKind(*symbol)==symbolKindExtern ? symbolKindData
+                                                                : symbolKindProcEntry;
+        value->type  = SymbolGetType(*symbol);
+      }
     }
   }
   
@@ -0,0 +1,712 @@
+/**********************************************************************************
+ *
+ *      PCH.C
+ *
+ *      Precompiled include files: writing the symbol table to an image
+ *      and loading it again in place of an include directive.
+ *
+ *      See pch.h for a description of the functions.
+ *
+ *********************************************************************************/
+
+#include "pila.h"
+#include "asm.h"
+#include "directiv.h"
+#include "options.h"
+#include "crc32.h"
+#include "libiberty.h"
+#include "obstack.h"
+#include "pch.h"
+#include "inputs.h"
+
+#ifdef unix
+    #include <sys/types.h>
+    #include <sys/stat.h>
+    #include <sys/mman.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+#define obstack_chunk_alloc xmalloc
+#define obstack_chunk_free  free
+
+extern PILA_STATE int giPassRun;
+
+#define PCH_MAGIC       "PilaPCH"
+#define PCH_VERSION     2
+#define PCH_BYTE_ORDER  0x01020304
+
+#define PCH_NONE        (-1)	// index of a NULL pointer
+
+#define PCH_GLOBAL      1	// symbol is the global symbol of its id
+#define PCH_PREDEFINED  2	// symbol is created by SymbolInitialize
+#define PCH_REDEFINABLE 4	// symbol was created by the set directive
+
+// The image consists of the header, fileCount PchFile records,
+// symbolCount PchSymbol records, missedCount offsets of missed ids and
+// poolSize bytes of '\0' terminated names. All names are stored as
+// offsets into this pool.
+typedef struct
+{
+  char magic[8];
+  int  version;
+  int  byteOrder;	// PCH_BYTE_ORDER as written by the host
+  int  fileCount;
+  int  symbolCount;
+  int  missedCount;
+  int  poolSize;
+} PchHeader;
+
+typedef struct
+{
+  unsigned int crc;	// CRC32 of the file's contents
+  int  size;		// size of the file in bytes
+  int  name;		// name of the file
+  int  relative;	// true if name is relative to the included file's directory
+} PchFile;
+
+typedef struct
+{
+  long long value;	// 64 bits (and first) whatever size a long has
+  int  id;		// name of the symbol (PCH_NONE if it has none)
+  int  kind;
+  int  type;		// index of the symbol's type
+  int  next;		// index of the next symbol in the symbol's list
+  int  derived;		// index of the first type derived from the symbol
+  int  flags;
+} PchSymbol;
+
+#define PCH_READ_CHUNK 0x10000
+
+// an include file an image was looked for
+typedef struct _PchImage
+{
+  struct _PchImage *next;
+  char   *name;		// resolved name of the include file
+  boolean loaded;	// false if the file has to be included as text
+  int     fileCount;	// number of files the image was made of
+  char  **files;	// their names (the include file being one of them)
+} PchImage;
+
+static PILA_STATE PchImage *pchImages = NULL;
+
+
+void PchImageName(char *fileName, char *pchName)
+{
+  char *pchExt = NULL, *pch;
+
+  strcpy(pchName, fileName);
+  for (pch = pchName; *pch; pch++)
+  {
+#ifndef unix
+    if (*pch == '\\')
+#else
+    if (*pch == '/')
+#endif
+      pchExt = NULL;
+    else if (*pch == '.')
+      pchExt = pch;
+  }
+  if (!pchExt)
+    pchExt = pch;
+  strcpy(pchExt, ".pch");
+}
+
+
+// Directory part of fileName including the trailing separator
+// ("" if the file name has no directory).
+static void PchFileDir(char *fileName, char *dir)
+{
+#ifndef unix
+  GetFullPathName(fileName, _MAX_PATH, dir, NULL);
+#else
+  strcpy(dir, fileName);
+#endif
+  TruncateDir(dir);
+#ifndef unix
+  if (*dir)
+    strcat(dir, "\\");
+#else
+  if (*dir)
+    strcat(dir, "/");
+#endif
+}
+
+
+// CRC32 of a file's contents. Returns false if the file can't be read.
+static boolean PchFileChecksum(char *fileName, unsigned int *crc, int *size)
+{
+  unsigned char buffer[PCH_READ_CHUNK];
+  FILE  *pfil;
+  size_t cb, i;
+
+  pfil = fopen(fileName, "rb");
+  if (pfil == NULL)
+    return false;
+
+  CRC32Reset();
+  *size = 0;
+  while ((cb = fread(buffer, 1, sizeof(buffer), pfil)) > 0)
+  {
+    for (i = 0; i < cb; i++)
+      CRC32Add(buffer[i]);
+    *size += cb;
+  }
+  fclose(pfil);
+  *crc = (unsigned int)CRC32Get();
+  return true;
+}
+
+
+//
+// Writing the image
+//
+
+typedef struct
+{
+  SymbolDef   **symbols;	// symbols in the order of their records
+  int           symbolCount;
+  int           symbolCapacity;
+  int          *slots;		// open addressing table: symbol -> index+1
+  unsigned long slotCount;	// (a power of two, at most half full)
+  struct obstack pool;		// names
+  struct obstack files;		// PchFile records
+  struct obstack missed;	// offsets of missed ids
+  struct obstack records;	// PchSymbol records
+  char          dir[_MAX_PATH+2];
+  boolean       failed;
+} PchWriter;
+
+
+static int PchAddName(PchWriter *w, char *name)
+{
+  int offset = obstack_object_size(&w->pool);
+
+  obstack_grow(&w->pool, name, strlen(name)+1);
+  return offset;
+}
+
+
+static unsigned long PchSlot(PchWriter *w, SymbolDef *symbol)
+{
+  unsigned long mask = w->slotCount-1;
+  unsigned long i = ((unsigned long)symbol >> 3) & mask;
+
+  while (w->slots[i] && w->symbols[w->slots[i]-1] != symbol)
+    i = (i+1) & mask;
+  return i;
+}
+
+
+// Returns the index of a symbol's record, adding the symbol if needed.
+static int PchSymbolIndex(PchWriter *w, SymbolDef *symbol)
+{
+  unsigned long i;
+
+  if (!symbol)
+    return PCH_NONE;
+
+  i = PchSlot(w, symbol);
+  if (w->slots[i])
+    return w->slots[i]-1;
+
+  if (w->symbolCount == w->symbolCapacity)
+  {
+    w->symbolCapacity *= 2;
+    w->symbols = xrealloc(w->symbols, w->symbolCapacity*sizeof(SymbolDef *));
+  }
+  w->symbols[w->symbolCount] = symbol;
+  w->slots[i] = ++w->symbolCount;
+
+  if ((unsigned long)w->symbolCount*2 > w->slotCount)
+  {
+    int n;
+
+    free(w->slots);
+    w->slotCount *= 2;
+    w->slots = xcalloc(w->slotCount, sizeof(int));
+    for (n = 0; n < w->symbolCount; n++)
+      w->slots[PchSlot(w, w->symbols[n])] = n+1;
+  }
+  return w->symbolCount-1;
+}
+
+
+static void PchCollectId(char *id, SymbolDef *global, boolean missed, void *data)
+{
+  PchWriter *w = data;
+  char      *fileName;
+  PchFile    file;
+  int        offset;
+
+  if ((fileName = SourceFileIncludedName(global)) != NULL)
+  {
+    // included files are not stored as symbols but as files
+    if (!PchFileChecksum(fileName, &file.crc, &file.size))
+    {
+      fprintf(gpfilMsg, "Can't read %s\n", fileName);
+      w->failed = true;
+      return;
+    }
+    file.relative = *w->dir && strncmp(fileName, w->dir, strlen(w->dir)) == 0;
+    file.name = PchAddName(w, file.relative ? fileName+strlen(w->dir) : fileName);
+    obstack_grow(&w->files, &file, sizeof(file));
+  }
+  else if (global)
+    PchSymbolIndex(w, global);
+  else if (missed)
+  {
+    offset = PchAddName(w, id);
+    obstack_grow(&w->missed, &offset, sizeof(offset));
+  }
+}
+
+
+long PchWrite(char *pchName, char *fileName)
+{
+  PchWriter  w;
+  PchHeader  header;
+  PchSymbol  rec;
+  SymbolDef *symbol;
+  FILE      *pfil;
+  int        i;
+
+  SymbolRecordMisses(false);
+
+  memset(&w, 0, sizeof(w));
+  w.symbolCapacity = 1024;
+  w.symbols = xmalloc(w.symbolCapacity*sizeof(SymbolDef *));
+  w.slotCount = 2048;
+  w.slots = xcalloc(w.slotCount, sizeof(int));
+  obstack_init(&w.pool);
+  obstack_init(&w.files);
+  obstack_init(&w.missed);
+  obstack_init(&w.records);
+  PchFileDir(fileName, w.dir);
+
+  // start with the global symbols and follow their pointers from there
+  // (which adds the symbols they point to behind the ones seen so far)
+  SymbolForEachId(PchCollectId, &w);
+
+  for (i = 0; i < w.symbolCount; i++)
+  {
+    symbol = w.symbols[i];
+    rec.id    = symbol->id ? PchAddName(&w, symbol->id) : PCH_NONE;
+    rec.kind  = symbol->value.kind;
+    rec.value = symbol->value.value;
+    rec.flags = 0;
+    if (symbol->id && SymbolLookup(symbol->id) == symbol)
+      rec.flags |= PCH_GLOBAL;
+    if (symbol->redefineable)
+      rec.flags |= PCH_REDEFINABLE;
+    if (SymbolIsPredefined(symbol))
+    {
+      // only the types derived from a predefined type belong to the image
+      rec.flags |= PCH_PREDEFINED;
+      rec.type   = PCH_NONE;
+      rec.next   = PCH_NONE;
+    }
+    else
+    {
+      rec.type   = PchSymbolIndex(&w, symbol->value.type);
+      rec.next   = PchSymbolIndex(&w, symbol->next);
+    }
+    rec.derived = PchSymbolIndex(&w, symbol->derived);
+    obstack_grow(&w.records, &rec, sizeof(rec));
+  }
+
+  memset(&header, 0, sizeof(header));
+  strcpy(header.magic, PCH_MAGIC);
+  header.version     = PCH_VERSION;
+  header.byteOrder   = PCH_BYTE_ORDER;
+  header.fileCount   = obstack_object_size(&w.files)/sizeof(PchFile);
+  header.symbolCount = w.symbolCount;
+  header.missedCount = obstack_object_size(&w.missed)/sizeof(int);
+  header.poolSize    = obstack_object_size(&w.pool);
+
+  pfil = NULL;
+  if (!w.failed)
+    pfil = fopen(pchName, "wb");
+  if (pfil != NULL)
+  {
+    fwrite(&header, sizeof(header), 1, pfil);
+    fwrite(obstack_base(&w.files), sizeof(PchFile), header.fileCount, pfil);
+    fwrite(obstack_base(&w.records), sizeof(PchSymbol), header.symbolCount, pfil);
+    fwrite(obstack_base(&w.missed), sizeof(int), header.missedCount, pfil);
+    fwrite(obstack_base(&w.pool), 1, header.poolSize, pfil);
+    if (ferror(pfil))
+      w.failed = true;
+    if (fclose(pfil) != 0)
+      w.failed = true;
+  }
+  else
+    w.failed = true;
+
+  free(w.symbols);
+  free(w.slots);
+  obstack_free(&w.pool, NULL);
+  obstack_free(&w.files, NULL);
+  obstack_free(&w.missed, NULL);
+  obstack_free(&w.records, NULL);
+
+  return w.failed ? -1 : header.symbolCount;
+}
+
+
+//
+// Loading the image
+//
+
+typedef struct
+{
+  PchHeader  *header;
+  PchFile    *files;
+  PchSymbol  *records;
+  int        *missed;
+  char       *pool;
+  SymbolDef **map;	// symbol for each record
+  boolean    *shared;	// record maps to a symbol that existed before
+} PchReader;
+
+
+static char *PchName(PchReader *r, int offset)
+{
+  return offset == PCH_NONE ? NULL : r->pool+offset;
+}
+
+
+// Checks that the image is complete and all of its offsets and
+// indices point into it.
+static boolean PchCheckImage(PchReader *r, long size)
+{
+  PchHeader *header = r->header;
+  int i;
+
+#define PCH_CHECK_NAME(n)  ((n) >= 0 && (n) < header->poolSize)
+#define PCH_CHECK_INDEX(n) ((n) >= PCH_NONE && (n) < header->symbolCount)
+
+  if (size < (long)sizeof(PchHeader) ||
+      memcmp(header->magic, PCH_MAGIC, sizeof(PCH_MAGIC)) != 0 ||
+      header->version != PCH_VERSION ||
+      header->byteOrder != PCH_BYTE_ORDER ||
+      header->fileCount < 0 || header->symbolCount < 0 ||
+      header->missedCount < 0 || header->poolSize <= 0 ||
+      size != (long)sizeof(PchHeader)
+              + header->fileCount*(long)sizeof(PchFile)
+              + header->symbolCount*(long)sizeof(PchSymbol)
+              + header->missedCount*(long)sizeof(int)
+              + header->poolSize)
+    return false;
+
+  r->files   = (PchFile *)(header+1);
+  r->records = (PchSymbol *)(r->files+header->fileCount);
+  r->missed  = (int *)(r->records+header->symbolCount);
+  r->pool    = (char *)(r->missed+header->missedCount);
+
+  if (r->pool[header->poolSize-1] != '\0')
+    return false;
+  for (i = 0; i < header->fileCount; i++)
+    if (!PCH_CHECK_NAME(r->files[i].name))
+      return false;
+  for (i = 0; i < header->missedCount; i++)
+    if (!PCH_CHECK_NAME(r->missed[i]))
+      return false;
+  for (i = 0; i < header->symbolCount; i++)
+  {
+    PchSymbol *rec = &r->records[i];
+    if ((rec->id != PCH_NONE && !PCH_CHECK_NAME(rec->id)) ||
+        (rec->id == PCH_NONE && (rec->flags & (PCH_GLOBAL|PCH_PREDEFINED))) ||
+        rec->kind < 0 || rec->kind > symbolKindTypeSimple ||
+        !PCH_CHECK_INDEX(rec->type) ||
+        !PCH_CHECK_INDEX(rec->next) ||
+        !PCH_CHECK_INDEX(rec->derived))
+      return false;
+  }
+  return true;
+
+#undef PCH_CHECK_NAME
+#undef PCH_CHECK_INDEX
+}
+
+
+// Finds the types derived from an existing type in the image that
+// exist already as well (i.e. "char*" if it was used before the include).
+static void PchShareDerived(PchReader *r, int index, SymbolDef *owner)
+{
+  SymbolDef *derived;
+
+  for (; index != PCH_NONE; index = r->records[index].next)
+  {
+    for (derived = owner->derived; derived; derived = derived->next)
+      if (strcmp(derived->id, PchName(r, r->records[index].id)) == 0)
+        break;
+    if (derived && derived->value.kind == r->records[index].kind)
+    {
+      r->map[index] = derived;
+      r->shared[index] = true;
+      PchShareDerived(r, r->records[index].derived, derived);
+    }
+  }
+}
+
+
+// Adds the types of the image that are derived from an existing type
+// to its list.
+static void PchLinkDerived(PchReader *r, int index, SymbolDef *owner)
+{
+  SymbolDef *symbol;
+  int next;
+
+  for (; index != PCH_NONE; index = next)
+  {
+    next = r->records[index].next;
+    symbol = r->map[index];
+    if (r->shared[index])
+      PchLinkDerived(r, r->records[index].derived, symbol);
+    else
+    {
+      symbol->next = owner->derived;
+      owner->derived = symbol;
+    }
+  }
+}
+
+
+// Makes sure the image can take the place of the include file's text.
+// Returns the reason why it can't or NULL.
+static char *PchCheckUsable(PchReader *r, char *dir)
+{
+  char fullName[2*_MAX_PATH+2];
+  unsigned int crc;
+  int i, size;
+  PchSymbol *rec;
+  SymbolDef *symbol;
+
+  for (i = 0; i < r->header->fileCount; i++)
+  {
+    strcpy(fullName, r->files[i].relative ? dir : "");
+    strcat(fullName, PchName(r, r->files[i].name));
+    if (!PchFileChecksum(fullName, &crc, &size) ||
+        crc != r->files[i].crc || size != r->files[i].size)
+      return "source file changed";
+    if (SourceFileIsIncluded(fullName))
+      return "source file included before";
+  }
+
+  // ids the include file looked for must still be undefined
+  for (i = 0; i < r->header->missedCount; i++)
+    if (SymbolLookup(PchName(r, r->missed[i])) != NULL)
+      return "symbol used by the include file defined before";
+
+  for (i = 0; i < r->header->symbolCount; i++)
+  {
+    rec = &r->records[i];
+    if (rec->flags & PCH_PREDEFINED)
+    {
+      symbol = SymbolLookup(PchName(r, rec->id));
+      if (!symbol || !SymbolIsPredefined(symbol))
+        return "predefined type missing";
+    }
+    else if ((rec->flags & PCH_GLOBAL) && SymbolLookup(PchName(r, rec->id)) != NULL)
+      return "symbol defined by the include file defined before";
+  }
+  return NULL;
+}
+
+
+// Creates the symbols of the image. PchCheckUsable must have been happy.
+static void PchLoadSymbols(PchReader *r)
+{
+  int count = r->header->symbolCount;
+  PchSymbol *rec;
+  SymbolDef *symbol;
+  int i;
+
+  r->map    = xcalloc(count, sizeof(SymbolDef *));
+  r->shared = xcalloc(count, sizeof(boolean));
+
+  for (i = 0; i < count; i++)
+  {
+    if (r->records[i].flags & PCH_PREDEFINED)
+    {
+      r->map[i] = SymbolLookup(PchName(r, r->records[i].id));
+      r->shared[i] = true;
+      PchShareDerived(r, r->records[i].derived, r->map[i]);
+    }
+  }
+
+  for (i = 0; i < count; i++)
+  {
+    rec = &r->records[i];
+    if (!r->shared[i])
+    {
+      r->map[i] = SymbolFactory(PchName(r, rec->id), (SymbolKind)rec->kind, NULL, (long)rec->value);
+      if (rec->flags & PCH_REDEFINABLE)
+        SymbolSetRedefineable(r->map[i]);
+    }
+  }
+
+#define PCH_SYMBOL(n) ((n) == PCH_NONE ? NULL : r->map[n])
+  for (i = 0; i < count; i++)
+  {
+    rec = &r->records[i];
+    if (!r->shared[i])
+    {
+      symbol = r->map[i];
+      symbol->value.type = PCH_SYMBOL(rec->type);
+      symbol->next       = PCH_SYMBOL(rec->next);
+      symbol->derived    = PCH_SYMBOL(rec->derived);
+    }
+  }
+#undef PCH_SYMBOL
+
+  for (i = 0; i < count; i++)
+    if (r->records[i].flags & PCH_PREDEFINED)
+      PchLinkDerived(r, r->records[i].derived, r->map[i]);
+
+  for (i = 0; i < count; i++)
+    if ((r->records[i].flags & PCH_GLOBAL) && !r->shared[i])
+      SymbolInstallGlobal(r->map[i]);
+
+  free(r->map);
+  free(r->shared);
+}
+
+
+static void PchLoad(PchImage *image)
+{
+  char pchName[_MAX_PATH+5], dir[_MAX_PATH+2];
+  char fullName[2*_MAX_PATH+2];
+  PchReader r;
+  char *reason;
+  long size;
+  int i;
+#ifdef unix
+  struct stat st;
+  int fd;
+#else
+  FILE *pfil;
+#endif
+
+  PchImageName(image->name, pchName);
+  PchFileDir(image->name, dir);
+
+#ifdef unix
+  fd = open(pchName, O_RDONLY);
+  if (fd < 0)
+    return;
+  if (fstat(fd, &st) != 0 || st.st_size == 0)
+  {
+    close(fd);
+    return;
+  }
+  size = st.st_size;
+  r.header = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (r.header == MAP_FAILED)
+    return;
+#else
+  pfil = fopen(pchName, "rb");
+  if (pfil == NULL)
+    return;
+  fseek(pfil, 0, SEEK_END);
+  size = ftell(pfil);
+  fseek(pfil, 0, SEEK_SET);
+  r.header = xmalloc(size > 0 ? size : 1);
+  if (fread(r.header, 1, size, pfil) != (size_t)size)
+    size = 0;
+  fclose(pfil);
+#endif
+
+  if (!PchCheckImage(&r, size))
+    reason = "not a valid image";
+  else
+    reason = PchCheckUsable(&r, dir);
+
+  if (reason)
+  {
+    if (OPTION(verbose))
+      fprintf(gpfilMsg, "not using %s: %s\n", pchName, reason);
+  }
+  else
+  {
+    PchLoadSymbols(&r);
+
+    image->fileCount = r.header->fileCount;
+    image->files = xmalloc(image->fileCount*sizeof(char *));
+    for (i = 0; i < image->fileCount; i++)
+    {
+      strcpy(fullName, r.files[i].relative ? dir : "");
+      strcat(fullName, PchName(&r, r.files[i].name));
+      image->files[i] = xstrdup(fullName);
+    }
+    image->loaded = true;
+
+    InputRecordFile(pchName);
+    for (i = 0; i < image->fileCount; i++)
+      InputRecordFile(image->files[i]);
+
+    if (OPTION(verbose))
+      fprintf(gpfilMsg, "using %s: %d symbols\n", pchName, r.header->symbolCount);
+  }
+
+#ifdef unix
+  munmap(r.header, size);
+#else
+  free(r.header);
+#endif
+}
+
+
+boolean PchInclude(char *fileName)
+{
+  PchImage *image;
+  char markedName[_MAX_PATH+1];
+  int i;
+
+  // an image is made from the text only
+  if (OPTION(precompile))
+    return false;
+
+  for (image = pchImages; image; image = image->next)
+    if (strcmp(image->name, fileName) == 0)
+      break;
+
+  if (!image)
+  {
+    image = xcalloc(1, sizeof(PchImage));
+    image->name = xstrdup(fileName);
+    image->next = pchImages;
+    pchImages = image;
+    PchLoad(image);
+  }
+
+  if (!image->loaded)
+    return false;
+
+  // the symbols are there from now on, but the files still have to
+  // count as included on every pass so they don't get included again
+  if (SourceFileMarkIncluded(fileName, markedName))
+    for (i = 0; i < image->fileCount; i++)
+      SourceFileMarkIncluded(image->files[i], markedName);
+
+  return true;
+}
+
+
+void PchFlush()
+{
+  PchImage *image;
+  int i;
+
+  while (pchImages)
+  {
+    image = pchImages;
+    pchImages = image->next;
+    for (i = 0; i < image->fileCount; i++)
+      free(image->files[i]);
+    free(image->files);
+    free(image->name);
+    free(image);
+  }
+}
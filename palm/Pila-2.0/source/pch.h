@@ -0,0 +1,46 @@
+/**********************************************************************************
+ *
+ *      PCH.H
+ *
+ *      Precompiled include files. "pila --precompile sdk.inc" assembles an
+ *      include file that only declares things (equ, struct, enum, typedef,
+ *      trapdef, ...) and writes the resulting symbol table to sdk.pch. When
+ *      sdk.inc gets included later on, the symbols are loaded from sdk.pch
+ *      instead of assembling the text on every pass.
+ *
+ *      The image holds symbols as records that refer to each other by index,
+ *      the names and checksums of all files that went into it and the ids it
+ *      looked up without finding them. It is only used if none of the files
+ *      changed since and none of these ids (nor any of the image's own global
+ *      ids) has been defined before the include. Otherwise the file is
+ *      included as text, just as if there was no image.
+ *
+ *      PchImageName(char *fileName, char *pchName)
+ *        Stores the name of the image belonging to fileName (the file name
+ *        with its extension replaced by .pch) in pchName.
+ *
+ *      PchWrite(char *pchName, char *fileName)
+ *        Writes the current symbol table as the image of fileName (which has
+ *        to be the file just assembled). Returns the number of symbols
+ *        written or -1 if the image could not be written.
+ *
+ *      PchInclude(char *fileName)
+ *        Called for every include directive with the resolved file name.
+ *        Returns true if the include was taken care of by the image of the
+ *        file (or the file was included already during this pass) and false
+ *        if the file has to be read as text.
+ *
+ *      PchFlush()
+ *        Forgets about all images looked at so far.
+ *
+ *********************************************************************************/
+
+#ifndef _PCH_H_
+#define _PCH_H_
+
+void    PchImageName(char *fileName, char *pchName);
+long    PchWrite(char *pchName, char *fileName);
+boolean PchInclude(char *fileName);
+void    PchFlush();
+
+#endif
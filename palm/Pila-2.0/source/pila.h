@@ -31,5 +31,32 @@ typedef enum
 
 #define Assert(f) assert(f)
 
+/* The assembler keeps its state in global variables. All of them are
+   declared PILA_STATE, which gives each thread a copy of its own, so
+   several threads can assemble at the same time (see libpila.h). */
+#ifdef _MSC_VER
+    #define PILA_STATE __declspec(thread)
+#else
+    #define PILA_STATE __thread
+#endif
+
+/* Locks for the little state that is shared between the threads. */
+#ifdef unix
+    #include <pthread.h>
+    typedef pthread_mutex_t PilaLock;
+    #define PILA_LOCK_INIT      PTHREAD_MUTEX_INITIALIZER
+    #define PilaLockEnter(l)    pthread_mutex_lock(l)
+    #define PilaLockLeave(l)    pthread_mutex_unlock(l)
+#else
+    typedef SRWLOCK PilaLock;
+    #define PILA_LOCK_INIT      SRWLOCK_INIT
+    #define PilaLockEnter(l)    AcquireSRWLockExclusive(l)
+    #define PilaLockLeave(l)    ReleaseSRWLockExclusive(l)
+#endif
+
+/* All messages of the assembler go here (stdout unless the caller of
+   PilaAssemble asked for something else, see libpila.h). */
+extern PILA_STATE FILE *gpfilMsg;
+
 #endif /* __PILA_H__ */
 
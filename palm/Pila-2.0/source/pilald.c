@@ -0,0 +1,106 @@
+/***********************************************************************
+ *
+ *      PILALD.C
+ *      Main Module for the Pila linker
+ *
+ *    Function: main()
+ *      Parses the command line, reads the object files and
+ *      archives given and links them into a PRC (see link.h).
+ *
+ *   Usage: pila-ld [-d] [-t TYPE] [-o outfile] [--timestamp SECONDS]
+ *                  file.o... [lib.a...]
+ *
+ ************************************************************************/
+
+#include "pila.h"
+#include "options.h"
+#include "link.h"
+
+static void LinkHelp()
+{
+    puts("Usage: pila-ld [-d] [-t TYPE] [-o outfile.prc] [--timestamp SECONDS] file.o... [lib.a...]\n");
+    puts("Links the object files made by pila --object (the one with the startup");
+    puts("code first) and what they need out of the archives into a PRC.\n");
+    puts("Options: -d  Print where each module goes");
+    puts("    -t TYPE  Specify the PRC type. Default is appl");
+    puts("    -o FILE  Write the PRC to FILE (default: the first file's name with .prc)");
+    puts("  --timestamp SECONDS  Put this time (seconds since 1970) into the PRC");
+    puts("             header instead of the current time (default $SOURCE_DATE_EPOCH)");
+    exit(0);
+}
+
+
+int main(int argc, char *argv[])
+{
+    char outName[_MAX_PATH], *pch;
+    char *pszOut = NULL;
+    int i, cFiles = 0, rc;
+
+    puts("Pila-ld 2.0 Beta ("__DATE__" "__TIME__")\n");
+
+    gpfilMsg = stdout;
+    strcpy(OPTION(database_type), "appl");
+
+    for (i = 1; i < argc; i++) {
+        if (argv[i][0] != '-') {
+            if (!cFiles++) {
+                // the PRC is named after the first file
+                strncpy(outName, argv[i], sizeof(outName) - 5);
+                outName[sizeof(outName) - 5] = 0;
+                pch = strrchr(outName, '.');
+                if (!pch || strchr(pch, '/')) {
+                    pch = outName + strlen(outName);
+                }
+                strcpy(pch, ".prc");
+            }
+            continue;
+        }
+        if (strcmp(argv[i], "-d") == 0) {
+            OPTION(verbose) = true;
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            pszOut = argv[++i];
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc && strlen(argv[i + 1]) == 4) {
+            strcpy(OPTION(database_type), argv[++i]);
+        } else if (strcmp(argv[i], "--timestamp") == 0 && i + 1 < argc) {
+            OPTION(fixed_timestamp) = true;
+            OPTION(timestamp) = strtol(argv[++i], &pch, 10);
+            if (*pch != 0) {
+                fprintf(stdout, "--timestamp requires the number of seconds "
+                        "since 1970.\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "-?") == 0) {
+            LinkHelp();
+        } else {
+            fprintf(stdout, "Unknown option %s\n", argv[i]);
+            LinkHelp();
+        }
+    }
+
+    if (!cFiles) {
+        fputs("No input file specified\n\n", stdout);
+        LinkHelp();
+    }
+    if (pszOut) {
+        strcpy(outName, pszOut);
+    }
+
+    rc = 0;
+    for (i = 1; i < argc; i++) {
+        if (argv[i][0] != '-') {
+            if (!LinkAddFile(argv[i])) {
+                rc++;
+            }
+        } else if (strcmp(argv[i], "-d") != 0) {
+            i++;	// the option's argument
+        }
+    }
+
+    if (rc == 0) {
+        rc = LinkRun(outName);
+    }
+    LinkFlush();
+
+    fprintf(stdout, "%d error%s\n", rc, rc != 1 ? "s" : "");
+    return rc;
+}
@@ -0,0 +1,80 @@
+/***********************************************************************
+ *
+ *      PILALST.C
+ *      Main Module for the Pila listing renderer
+ *
+ *    Function: main()
+ *      Turns the binary listings written by pila --binary-listing
+ *      into the listing files pila -l would have written
+ *      (see listing.h).
+ *
+ *   Usage: pila-lst [-o outfile] file.lsb...
+ *
+ ************************************************************************/
+
+#include "pila.h"
+#include "listing.h"
+
+static void ListHelp()
+{
+    puts("Usage: pila-lst [-o outfile.lis] file.lsb...\n");
+    puts("Turns the binary listings written by pila --binary-listing into");
+    puts("the listing files pila -l writes.\n");
+    puts("Options: -o FILE  Write the listing to FILE (default: file.lis)");
+    exit(0);
+}
+
+
+int main(int argc, char *argv[])
+{
+    char outName[_MAX_PATH], *pch;
+    char *pszOut = NULL;
+    int i, cFiles = 0, rc = 0;
+
+    gpfilMsg = stdout;
+
+    for (i = 1; i < argc; i++) {
+        if (argv[i][0] != '-') {
+            cFiles++;
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            pszOut = argv[++i];
+        } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "-?") == 0) {
+            ListHelp();
+        } else {
+            fprintf(stdout, "Unknown option %s\n", argv[i]);
+            ListHelp();
+        }
+    }
+
+    if (!cFiles) {
+        fputs("No input file specified\n\n", stdout);
+        ListHelp();
+    }
+    if (pszOut && cFiles > 1) {
+        fputs("-o can only be used with one input file\n", stdout);
+        return 1;
+    }
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0) {
+            i++;
+            continue;
+        }
+        if (pszOut) {
+            strcpy(outName, pszOut);
+        } else {
+            // file.lsb becomes file.lis
+            strncpy(outName, argv[i], sizeof(outName) - 5);
+            outName[sizeof(outName) - 5] = 0;
+            pch = strrchr(outName, '.');
+            if (!pch || strchr(pch, '/')) {
+                pch = outName + strlen(outName);
+            }
+            strcpy(pch, ".lis");
+        }
+        if (ListRender(argv[i], outName) != 0) {
+            rc++;
+        }
+    }
+    return rc;
+}
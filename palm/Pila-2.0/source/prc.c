@@ -22,6 +22,8 @@
 #include "options.h"
 #include "time.h"
 #include "libiberty.h"
+#include "segment.h"
+#include "bitmap.h"
 
 #ifndef unix
     //#include <windows.h>
@@ -31,58 +33,52 @@
     #include <asm/byteorder.h>
 #endif
 
-#ifdef unix
-    typedef struct {
-        unsigned long biSize;
-        long int      biWidth;
-        long int      biHeight;
-        short int     biPlanes;
-        short int     biBitCount;
-        unsigned long biCompression;
-        unsigned long biSizeImage;
-        long int      biXPelsPerMeter;
-        long int      biYPelsPerMeter;
-        unsigned long biClrUsed;
-        unsigned long biClrImportant;
-    } BITMAPINFOHEADER;
-    
-    typedef struct {
-        char rgbBlue;
-        char rgbGreen;
-        char rgbRed;
-        char rgbReserved;
-    } RGBQUAD;
-
-    typedef struct {
-        BITMAPINFOHEADER bmiHeader;
-        RGBQUAD          bmiColors[1];
-    } BITMAPINFO;
-#endif
-
 /////////////////////////////////////////////////////////////////////////////
 
-extern int giPass;
-extern long gcbResTotal;
-long gcbDataCompressed;
+extern PILA_STATE int giPass;
+extern PILA_STATE long gcbResTotal;
+PILA_STATE long gcbDataCompressed;
 
-#define kcbPrcMax   (512 * 1024)    // 512k should be plenty
 #define kcrmeMax    1000            // 1000 resources should be enough
 
 // #define offsetof(s,m)  (ulong)&(((s *)0)->m)
 
-ResourceMapEntry garme[kcrmeMax];
-long gcrme;
-byte gpbPrc[kcbPrcMax];
-long gcbPrc;
-FourCC gfcCreatorId = MAKE4CC('T','E','M','P');
+PILA_STATE ResourceMapEntry garme[kcrmeMax];
+PILA_STATE long gcrme;
+PILA_STATE byte *gpbPrc;
+PILA_STATE long gcbPrc;
+PILA_STATE FourCC gfcCreatorId = MAKE4CC('T','E','M','P');
+PILA_STATE byte *gpbJumpTable;      // initial jump table (see segment.h)
+PILA_STATE ulong gcbJumpTable;
 
-boolean CompressData(byte *pbData, ulong cbData, ulong cbUninitData,
+boolean CompressData(byte *pbData, ulong cbData, byte *pbJump, ulong cbJump,
                   byte **ppbCompData, ulong *pcbCompData);
 boolean ConvertResource(ulong ulTypeOriginal, byte *pbResData,
                      ResourceMapEntry *prme);
 
 /////////////////////////////////////////////////////////////////////////////
 
+void PrcInitialize()
+{
+    int i;
+
+    // Drop whatever an earlier assembly in this thread has left behind.
+    for (i = 0; i < gcrme; i++) {
+        free(garme[i].pbData);
+    }
+    gcrme = 0;
+    gcbPrc = 0;
+    gcbDataCompressed = 0;
+    free(gpbPrc);
+    gpbPrc = NULL;
+    free(gpbJumpTable);
+    gpbJumpTable = NULL;
+    gcbJumpTable = 0;
+    gfcCreatorId = MAKE4CC('T','E','M','P');
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
 boolean AddResource(FourCC fcType, ushort usId, byte *pbData, ulong cbData,
                  boolean fHead)
 {
@@ -121,50 +117,72 @@ boolean AddResource(FourCC fcType, ushort usId, byte *pbData, ulong cbData,
 
 /////////////////////////////////////////////////////////////////////////////
 
+// The resources added so far (converted like they go into the PRC), for
+// the object file. Returns how many there are.
+
+long PrcGetResources(ResourceMapEntry **parme)
+{
+    *parme = garme;
+    return gcrme;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
 
 // cbData = cbA + cbB;
 // a5 = new byte[cbData] + cbB;
 // *a5 = SysAppInfoPtr
 
-struct CodeZeroResource {
-    ulong cbA;      // Initialized data size
-    ulong cbB;      // Uninitialized data size
-} czr;
+// The resource is two big-endian longs, cbA (initialized data size) and
+// cbB (jump table size, below A5). A ulong may well have more than 4 bytes,
+// so they are put together byte by byte.
+PILA_STATE byte gabCodeZero[8];
+
+// Stores ul at pb as 4 big-endian bytes.
+static void PutLong(byte *pb, ulong ul)
+{
+    pb[0] = (byte)(ul >> 24);
+    pb[1] = (byte)(ul >> 16);
+    pb[2] = (byte)(ul >> 8);
+    pb[3] = (byte)ul;
+}
+
+// Lays out the PRC in a buffer of its own. The caller owns the buffer
+// (*ppbPrc) and has to free it. Returns the size of the PRC or 0 if it
+// could not be made.
 
-long WritePrc(char *pszFileName, char *pszAppName, byte *pbCode, long cbCode,
-              byte *pbData, long cbData)
+long MakePrc(char *pszFileName, char *pszAppName, byte *pbCode, long cbCode,
+             byte *pbData, long cbData, byte **ppbPrc)
 {
     extern boolean LayoutPrc(char *pszFilename, char *pszAppName);
-    boolean fSuccess;
-    FILE *pfilOut;
     char szName[_MAX_PATH];
-    long cbRes;
+    long cbPrc;
 
     if (!OPTION(resources_only)) {
         //
         // Add resources for code, data info, and data.
         //
 
-        if (cbData) {
+        // The jump table of a program with several code segments goes
+        // into the 'data' resource, too.
+        gcbJumpTable = SegmentGetJumpTable(&gpbJumpTable);
+
+        if (cbData || gcbJumpTable) {
             AddResource(MAKE4CC('d','a','t','a'), 0x0000, pbData, cbData, true);
         }
 
         // Write the mystery 'code' 0000 resource.
         // FIX:
-        czr.cbA = htonl(cbData);
-        czr.cbB = htonl(0);
-        AddResource(MAKE4CC('c','o','d','e'), 0x0000, (byte *)&czr, sizeof(czr), true);
+        PutLong(gabCodeZero, cbData);
+        PutLong(gabCodeZero + 4, gcbJumpTable);
+        AddResource(MAKE4CC('c','o','d','e'), 0x0000, gabCodeZero, sizeof(gabCodeZero), true);
 
-        // Write the real 'code' resource.
+        // Write the real 'code' resource(s).
+        SegmentAddResources();
         AddResource(MAKE4CC('c','o','d','e'), 0x0001, pbCode, cbCode, true);
     }
 
-    // Create file for writing.
-    pfilOut = fopen(pszFileName, "wb");
-    if (pfilOut == NULL || pfilOut == (FILE *)-1) {
-        printf("Error: Can't open output file \"%s\"\n", pszFileName);
-        return 0;
-    }
+    *ppbPrc = NULL;
 
     if ( ( !pszAppName ) || ( !*pszAppName ) ) {
 #ifdef unix
@@ -181,16 +199,37 @@ long WritePrc(char *pszFileName, char *pszAppName, byte *pbCode, long cbCode,
     }
 
     if (strlen(pszAppName) > 31) {
-        printf("Error: Application name %s is too long. 31 characters max.\n",
+        fprintf(gpfilMsg, "Error: Application name %s is too long. 31 characters max.\n",
                pszAppName);
         return 0;
     }
 
-    fSuccess = LayoutPrc(pszFileName, pszAppName);
-    if (fSuccess) {
-        fSuccess = fwrite(gpbPrc, gcbPrc, 1, pfilOut) == 1;
+    if (!LayoutPrc(pszFileName, pszAppName)) {
+        return 0;
     }
 
+    *ppbPrc = gpbPrc;
+    cbPrc = gcbPrc;
+    gpbPrc = NULL;
+    gcbPrc = 0;
+
+    return cbPrc;
+}
+
+long WritePrc(char *pszFileName, byte *pbPrc, long cbPrc)
+{
+    FILE *pfilOut;
+    long cbRes;
+
+    // Create file for writing.
+    pfilOut = fopen(pszFileName, "wb");
+    if (pfilOut == NULL || pfilOut == (FILE *)-1) {
+        fprintf(gpfilMsg, "Error: Can't open output file \"%s\"\n", pszFileName);
+        return 0;
+    }
+
+    fwrite(pbPrc, cbPrc, 1, pfilOut);
+
     cbRes = ftell(pfilOut);
     fclose(pfilOut);
 
@@ -198,22 +237,63 @@ long WritePrc(char *pszFileName, char *pszAppName, byte *pbCode, long cbCode,
 }
 
 
+/////////////////////////////////////////////////////////////////////////////
+
+// The time for the PRC header in seconds since 1970. It comes from
+// --timestamp or SOURCE_DATE_EPOCH if one of them is given, so the same
+// sources always give the same PRC. Returns false (and the current time)
+// if neither is.
+
+boolean PrcGetTimestamp(long *plTime)
+{
+    char *psz, *pszEnd;
+
+    if (OPTION(fixed_timestamp)) {
+        *plTime = OPTION(timestamp);
+        return true;
+    }
+
+    psz = getenv("SOURCE_DATE_EPOCH");
+    if (psz && *psz) {
+        *plTime = strtol(psz, &pszEnd, 10);
+        if (*pszEnd == 0) {
+            return true;
+        }
+    }
+
+    *plTime = time(0L);
+    return false;
+}
+
 /////////////////////////////////////////////////////////////////////////////
 
 boolean LayoutPrc(char *pszFilename, char *pszAppName)
 {
     byte *pbResData;
     ResourceMapEntry *prme;
-    DatabaseHdrType *dbHdr = (DatabaseHdrType *)&gpbPrc;
+    DatabaseHdrType *dbHdr;
     RsrcEntryType *resEntry;
+    long lTime, cbMap;
     int i;
 
     //
     // Here we go!
     //
 
-    // Initialize the output buffer to all zeros.
-    memset(gpbPrc, 0, kcbPrcMax);
+    // The header and the resource map (with two null bytes after it) come
+    // first, then the resources. Get a buffer of exactly that size, with
+    // the header and map initialized to all zeros.
+    cbMap = offsetof(DatabaseHdrType, recordList.firstEntry) +
+            gcrme * sizeof(RsrcEntryType) + 2;
+    gcbPrc = cbMap;
+    for (i = 0; i < gcrme; i++) {
+        gcbPrc += garme[i].cbData;
+    }
+
+    free(gpbPrc);
+    gpbPrc = (byte *)xmalloc(gcbPrc);
+    memset(gpbPrc, 0, cbMap);
+    dbHdr = (DatabaseHdrType *)gpbPrc;
 
     // Sneak "Pila" into the (most likely) unused app name space.
     *((ulong *)(&(dbHdr->name[28]))) = ntohl(MAKE4CC('P','i','l','a'));
@@ -223,8 +303,9 @@ boolean LayoutPrc(char *pszFilename, char *pszAppName)
 
     dbHdr->attributes = htons(dmHdrAttrResDB|dmHdrAttrBackup|dmHdrAttrBundle);
     dbHdr->version    = htons(1);
-    dbHdr->creationDate = ntohl(time(0L)+2082844800);
-    dbHdr->modificationDate = ntohl(time(0L)+2082844800);
+    PrcGetTimestamp(&lTime);
+    dbHdr->creationDate = ntohl(lTime+2082844800);
+    dbHdr->modificationDate = ntohl(lTime+2082844800);
     dbHdr->lastBackupDate = ntohl(0);
     dbHdr->modificationNumber = ntohl(0);
     dbHdr->appInfoID = ntohl(0);
@@ -237,10 +318,7 @@ boolean LayoutPrc(char *pszFilename, char *pszAppName)
     dbHdr->recordList.numRecords = htons(gcrme);
 
     resEntry  = &(dbHdr->recordList.firstEntry); // address of first entry in resource map
-    pbResData = (byte *)(&(resEntry[gcrme]));     // offset of first resource data-2
-
-    *pbResData++ = 0; // two null bytes following the resource map
-    *pbResData++ = 0;
+    pbResData = gpbPrc + cbMap;                  // first resource data
 
     prme = garme;
     for (i = 0; i < gcrme; i++, prme++)
@@ -254,16 +332,16 @@ boolean LayoutPrc(char *pszFilename, char *pszAppName)
         // Copy the offset to the resource data in the resource map
         resEntry->localChunkID = htonl(pbResData - gpbPrc);
 
-        // Copy the resource data to the appropriate offset
+        // Move the resource data to the appropriate offset
         memcpy(pbResData, prme->pbData, prme->cbData);
+        free(prme->pbData);
+        prme->pbData = NULL;
 
         // Point to the next available resource map and data destination.
         resEntry++;
         pbResData += prme->cbData;
     }
 
-    gcbPrc = pbResData - gpbPrc;
-
     return true;
 }
 
@@ -284,23 +362,151 @@ boolean LayoutPrc(char *pszFilename, char *pszAppName)
 // | char[]: compressed CODE 1 xrefs |<--+
 // +---------------------------------+
 
-boolean CompressData(byte *pbData, ulong cbData, ulong cbUninitData,
-                  byte **ppbCompData, ulong *pcbCompData)
+// Writes a literal run of cb (at most 0x80) bytes. Returns the new end of
+// the compressed data.
+
+static byte *FlushLiteral(byte *pbComp, byte *pbData, ulong cb)
 {
-    unsigned int i;
+    *pbComp++ = 0x80 + cb - 1;
+    memcpy(pbComp, pbData, cb);
+    return pbComp + cb;
+}
+
+// Checks if the data starts with one of the eight byte patterns that have
+// a code of their own (0x01 to 0x04). If so, stores the code and its
+// arguments in pbCode and returns the number of bytes covered (0 if none).
+
+static ulong DataPattern(byte *pb, ulong cb, byte *pbCode, ulong *pcbCode)
+{
+    static const byte abZeroFF[] = { 0x00, 0x00, 0x00, 0x00, 0xff, 0xff };
+
+    if (cb < 8) {
+        return 0;
+    }
+
+    if (memcmp(pb, abZeroFF, 6) == 0) {
+        pbCode[0] = 0x01;
+        pbCode[1] = pb[6];
+        pbCode[2] = pb[7];
+        *pcbCode = 3;
+    } else if (memcmp(pb, abZeroFF, 5) == 0) {
+        pbCode[0] = 0x02;
+        memcpy(pbCode + 1, pb + 5, 3);
+        *pcbCode = 4;
+    } else if (pb[0] == 0xa9 && pb[1] == 0xf0 && pb[2] == 0x00 && pb[6] == 0x00) {
+        if (pb[3] == 0x00) {
+            pbCode[0] = 0x03;
+            pbCode[1] = pb[4];
+            pbCode[2] = pb[5];
+            pbCode[3] = pb[7];
+            *pcbCode = 4;
+        } else {
+            pbCode[0] = 0x04;
+            memcpy(pbCode + 1, pb + 3, 3);
+            pbCode[4] = pb[7];
+            *pcbCode = 5;
+        }
+    } else {
+        return 0;
+    }
+
+    return 8;
+}
+
+// Compresses cbData bytes at pbData into a stream at pbComp (which has
+// to have room for twice as many bytes). Returns the end of the stream,
+// without the terminating 0.
+
+static byte *CompressStream(byte *pbComp, byte *pbData, ulong cbData)
+{
+    ulong i, cbIn, cbCode, cbLiteral;
+    byte abCode[5];
     unsigned char c;
+
+    // The stream is made of these codes:
+    //
+    //   1xxxxxxx           x+1 bytes follow literally
+    //   01xxxxxx           x+1 bytes of 0x00
+    //   001xxxxx b         x+2 bytes of b
+    //   0001xxxx           x+1 bytes of 0xFF
+    //   00000001 b1 b2     00 00 00 00 FF FF b1 b2
+    //   00000010 b1 b2 b3  00 00 00 00 FF b1 b2 b3
+    //   00000011 b1 b2 b3  A9 F0 00 00 b1 b2 00 b3
+    //   00000100 b1-b4     A9 F0 00 b1 b2 b3 00 b4
+    //   00000000           end of the stream
+    //
+    // The last four cover a long 0 followed by a small negative long and
+    // the jump table entries CodeWarrior puts in its data sections. Bytes
+    // go into a literal run until a pattern or a run comes along that is
+    // shorter than leaving them in there.
+
+    cbLiteral = 0;
+    while (cbData > 0) {
+        cbIn = DataPattern(pbData, cbData, abCode, &cbCode);
+        if (!cbIn) {
+            c = *pbData;
+            for (i = 1; i < cbData && pbData[i] == c; i++) {
+                ;
+            }
+            if (c == 0 && i >= (cbLiteral ? 2u : 1u)) {
+                cbIn = i < 0x40 ? i : 0x40;
+                abCode[0] = 0x40 + cbIn - 1;
+                cbCode = 1;
+            } else if (c == 0xff && i >= (cbLiteral ? 2u : 1u)) {
+                cbIn = i < 0x10 ? i : 0x10;
+                abCode[0] = 0x10 + cbIn - 1;
+                cbCode = 1;
+            } else if (c != 0 && c != 0xff && i >= (cbLiteral ? 3u : 2u)) {
+                cbIn = i < 0x21 ? i : 0x21;
+                abCode[0] = 0x20 + cbIn - 2;
+                abCode[1] = c;
+                cbCode = 2;
+            }
+        }
+
+        if (!cbIn) {
+            // keep the byte for a literal run
+            cbLiteral++;
+            pbData++;
+            cbData--;
+            if (cbLiteral == 0x80) {
+                pbComp = FlushLiteral(pbComp, pbData - cbLiteral, cbLiteral);
+                cbLiteral = 0;
+            }
+            continue;
+        }
+
+        if (cbLiteral) {
+            pbComp = FlushLiteral(pbComp, pbData - cbLiteral, cbLiteral);
+            cbLiteral = 0;
+        }
+        memcpy(pbComp, abCode, cbCode);
+        pbComp += cbCode;
+        pbData += cbIn;
+        cbData -= cbIn;
+    }
+    if (cbLiteral) {
+        pbComp = FlushLiteral(pbComp, pbData - cbLiteral, cbLiteral);
+    }
+
+    return pbComp;
+}
+
+boolean CompressData(byte *pbData, ulong cbData, byte *pbJump, ulong cbJump,
+                  byte **ppbCompData, ulong *pcbCompData)
+{
     long lOffset;
 
     // Allocate a temporary compression buffer.
 
     byte *pbCompBuffer = (byte *)xmalloc(
-            (cbData * 2) + (3 * 5) + (6 * sizeof(ulong)) + 40);   // +40 is just in case
+            (cbData * 2) + (cbJump * 2) + (3 * 5) + (6 * sizeof(ulong)) + 40);   // +40 is just in case
     byte *pbComp = pbCompBuffer;
 
     // The first ulong in a 'data' resource is an offset to the compressed
     // CODE 1 xrefs. In PalmOS 1.0 it appears to be unused by the loader.
 
-    *(ulong *)pbComp = htonl(cbData);
+    PutLong(pbComp, cbData);
     pbComp += 4;
 
     //
@@ -330,73 +536,35 @@ boolean CompressData(byte *pbData, ulong cbData, ulong cbUninitData,
     //
 
     lOffset = 4;    // skip first 4 bytes where SysAppInfo* will be stored
-    cbData -= 4;
-    pbData += 4;
+    if (cbData > 4) {
+        cbData -= 4;
+        pbData += 4;
+    } else {
+        cbData = 0; // nothing but a jump table
+    }
 
     // The second ulong in a 'data' resource is the offset from A5
     // (positive or negative) that the data should be stored at.
 
-    *(ulong *)pbComp = htonl(lOffset);
+    PutLong(pbComp, lOffset);
     pbComp += 4;
 
-    // Compress the data (only parts of the pilot's enhanced RLE implemented).
-
-    while (cbData > 0) {
-        if (cbData > 1) {
-            c = *pbData;
-            if (!c) {
-                for (i = 0; ( i < cbData ) && ( i < 0x40 ) && (*(pbData + i) == c); i++) {
-                    ;
-                }
-                if( i > 0 ) {
-                    *pbComp++ = 0x40 + i - 1;
-                    pbData += i;
-                    cbData -= i;
-                    continue;
-                }
-            } else if (c == 0xff) {
-                for (i = 0; i < cbData && i < 0x10 && (*(pbData + i) == c); i++) {
-                    ;
-                }
-                if( i > 0 ) {
-                    *pbComp++ = 0x10 + i - 1;
-                    pbData += i;
-                    cbData -= i;
-                    continue;
-                }
-            } else {
-                for (i = 0; i < cbData && i < 0x20 && (*(pbData + i) == c); i++) {
-                    ;
-                }
-                if( i > 1 ) {
-                    *pbComp++ = 0x20 + i - 2;
-                    *pbComp++ = c;
-                    pbData += i;
-                    cbData -= i;
-                    continue;
-                }
-            }
-        }
-        for (i = 0; i < cbData && i < 0x80 && (*(pbData + i + 1) != *(pbData + i)); i++) {
-            ;
-        }
-        if (!i) {
-            i = 1;
-        }
-        *pbComp++ = 0x80 + i - 1;
-        memcpy(pbComp, pbData, i);
-        pbComp += i;
-        pbData += i;
-        cbData -= i;
-    }
+    pbComp = CompressStream(pbComp, pbData, cbData);
 
     // The decompressor expects 3 groups of { a5offset, compressed stream }
-    // separated by a 0 byte. This code fills out the remainder.
+    // separated by a 0 byte. The second one is the jump table (if there is
+    // one), which goes right below A5. This code fills out the remainder.
 
     *pbComp++ = 0;
 
-    *(ulong *)pbComp = 0;
-    pbComp += sizeof(ulong);
+    if (cbJump) {
+        PutLong(pbComp, -(long)cbJump);
+        pbComp += 4;
+        pbComp = CompressStream(pbComp, pbJump, cbJump);
+    } else {
+        *(ulong *)pbComp = 0;
+        pbComp += sizeof(ulong);
+    }
     *pbComp++ = 0;
 
     *(ulong *)pbComp = 0;
@@ -430,123 +598,6 @@ boolean CompressData(byte *pbData, ulong cbData, ulong cbUninitData,
     return true;
 }
 
-/////////////////////////////////////////////////////////////////////////////
-
-// Test bit in a 1bpp bitmap
-
-boolean TestBit(int cx, int cy, byte *pb, int x, int y, int cBitsAlign)
-{
-    int cbRow = (cx + (cBitsAlign - 1)) & ~(cBitsAlign - 1);
-    pb += (cbRow >> 3) * y + (x >> 3);
-
-    return (*pb & (1 << (7 - (x & 7))));
-}
-
-// Set bit in a 1bpp bitmap
-
-void SetBit(int cx, int cy, byte *pb, int x, int y, int cBitsAlign)
-{
-    int cbRow = (cx + (cBitsAlign - 1)) & ~(cBitsAlign - 1);
-    pb += (cbRow >> 3) * y + (x >> 3);
-    *pb |= (1 << (7 - (x & 7)));
-}
-
-/////////////////////////////////////////////////////////////////////////////
-
-// Pilot bitmap resource format
-
-typedef struct _Bitmap { // bm
-    ushort cx;
-    ushort cy;
-    ushort cbRow;
-    ushort ff;
-    ushort ausUnk[4];
-    byte abBits[1];
-} Bitmap;
-
-
-boolean ConvertBitmapResource(byte *pbResData, ResourceMapEntry *prme)
-{
-    byte *pbSrc;
-    int cbDst, cbRow;
-    Bitmap *pbmDst;
-    int x, y;
-
-#ifndef unix
-    BITMAPINFO *pbmi = (BITMAPINFO *)(pbResData + sizeof(BITMAPFILEHEADER));
-#else
-    BITMAPINFO *pbmi = (BITMAPINFO *)(pbResData + 14);
-#endif
-    pbSrc = ((byte *)pbmi) + pbmi->bmiHeader.biSize + sizeof(RGBQUAD) * 2;
-
-    // If image not 1bpp, bail
-
-    if (pbmi->bmiHeader.biBitCount != 1) {
-        printf("Bitmap not 1 bpp!");
-        return false;
-    }
-
-    // Alloc what we need for image data
-    // Pilot images are word aligned
-
-    cbRow = ((pbmi->bmiHeader.biWidth + 15) & ~15) / 8;
-    cbDst = cbRow * pbmi->bmiHeader.biHeight + offsetof(Bitmap, abBits);
-    pbmDst = (Bitmap *)xmalloc(cbDst);
-
-    // Image data has been inverted for Macintosh, so invert back
-
-    memset(pbmDst, 0, cbDst);
-
-    // Convert from source bitmap format (dword aligned) to dst format (word
-    // aligned).
-
-    for (y = 0; y < pbmi->bmiHeader.biHeight; y++) {
-        for (x = 0; x < pbmi->bmiHeader.biWidth; x++) {
-            // Reverse bits so we get WYSIWYG in msdev (white
-            // pixels become background (0), black pixels become
-            // foreground (1)).
-
-            int yT = y;
-            if (pbmi->bmiHeader.biHeight > 0) {
-                yT = pbmi->bmiHeader.biHeight - y - 1;
-            }
-
-            if (!TestBit(pbmi->bmiHeader.biWidth, pbmi->bmiHeader.biHeight,
-                         pbSrc, x, yT, 32)) {
-                SetBit(pbmi->bmiHeader.biWidth, pbmi->bmiHeader.biHeight,
-                       &pbmDst->abBits[0], x, y, 16);
-            }
-        }
-    }
-    pbmDst->cx = htons((ushort)pbmi->bmiHeader.biWidth);
-    pbmDst->cy = htons((ushort)pbmi->bmiHeader.biHeight);
-    pbmDst->cbRow = htons((ushort)cbRow);
-
-    // Update resource entry with new pos / size
-
-    prme->pbData = (byte *)pbmDst;
-    prme->cbData = cbDst;
-
-    // Special case: if bitmap id is 7FFE, make it the app
-    // icon
-
-    if (prme->usId == 0x7FFE) {
-        prme->fcType = MAKE4CC('t','A','I','B');
-        prme->usId = 1000;
-
-        // Make sure it's the right size / height
-
-        if (abs(pbmi->bmiHeader.biHeight) !=32 || pbmi->bmiHeader.biWidth != 32) {
-            printf("Icon resource not 32x32!\n");
-            return false;
-        }
-    } else {
-        prme->fcType = MAKE4CC('T','b','m','p');
-    }
-
-    return true;
-}
-
 /////////////////////////////////////////////////////////////////////////////
 // - Compresses 'data' resource
 // - Converts 'WBMP' resources to either 'tBMP' or 'tAIB'
@@ -558,12 +609,12 @@ boolean ConvertResource(ulong ulTypeOriginal, byte *pbResData,
     case MAKE4CC('d','a','t','a'):
             // Compress the 'data' data before adding it.
 
-        CompressData(pbResData, prme->cbData, 0, &prme->pbData,
+        CompressData(pbResData, prme->cbData, gpbJumpTable, gcbJumpTable, &prme->pbData,
                      &prme->cbData);
         break;
 
     case MAKE4CC('W','B','M','P'):
-        if (!ConvertBitmapResource(pbResData, prme)) {
+        if (!BitmapConvert(pbResData, prme)) {
             return false;
         }
         break;
@@ -112,9 +112,13 @@ typedef struct _ResourceMapEntry { // rme
     ulong cbData;
 } ResourceMapEntry;
 
+void PrcInitialize();
 boolean AddResource(FourCC fcType, ushort usId, byte *pbData, ulong cbData,
                  boolean fHead);
-long WritePrc(char *pszFileName, char *pszAppName, byte *pbCode, long cbCode,
-              byte *pbData, long cbData);
+long MakePrc(char *pszFileName, char *pszAppName, byte *pbCode, long cbCode,
+             byte *pbData, long cbData, byte **ppbPrc);
+long WritePrc(char *pszFileName, byte *pbPrc, long cbPrc);
+boolean PrcGetTimestamp(long *plTime);
+long PrcGetResources(ResourceMapEntry **parme);
 
 #endif // ndef __PRC_H__
@@ -0,0 +1,273 @@
+/**********************************************************************************
+ *
+ *      PROCGRAPH.C
+ *
+ *      The graph of references between procedures and global variables,
+ *      used to drop what nothing uses.
+ *
+ *      See procgraph.h for a description of the functions.
+ *
+ *********************************************************************************/
+
+#include "pila.h"
+#include "asm.h"
+#include "options.h"
+#include "libiberty.h"
+#include "segment.h"
+#include "procgraph.h"
+
+extern PILA_STATE int  giPass;
+extern PILA_STATE long gulDataLoc;
+
+#define kcGraphBuckets 1024
+
+typedef struct _GraphNode
+{
+  struct _GraphNode  *next;       // next in the same hash bucket
+  struct _GraphNode  *nextAll;    // next in the order the nodes were made
+  SymbolDef          *symbol;
+  boolean             defined;    // a procedure or global variable of this file
+  boolean             used;
+  struct _GraphNode **refs;       // what it refers to
+  int                 refCount;
+  int                 refAlloc;
+} GraphNode;
+
+static PILA_STATE GraphNode **graphBuckets = NULL;
+static PILA_STATE GraphNode  *graphFirst = NULL;
+static PILA_STATE GraphNode  *graphLast = NULL;
+static PILA_STATE GraphNode  *graphRoot = NULL;      // stands for what is outside of procedures
+static PILA_STATE boolean     graphRecording = false;
+static PILA_STATE boolean     graphDone = false;     // used or not is known
+static PILA_STATE int         graphDroppedProcs = 0;
+static PILA_STATE int         graphDroppedGlobals = 0;
+static PILA_STATE long        graphBytesBefore = 0;
+static PILA_STATE long        graphBytesAfter = 0;
+
+
+void ProcGraphFlush()
+{
+  GraphNode *node, *next;
+
+  for (node = graphFirst; node; node = next)
+  {
+    next = node->nextAll;
+    free(node->refs);
+    free(node);
+  }
+  if (graphRoot)
+  {
+    free(graphRoot->refs);
+    free(graphRoot);
+  }
+  free(graphBuckets);
+  graphBuckets = NULL;
+  graphFirst = graphLast = graphRoot = NULL;
+  graphRecording = graphDone = false;
+  graphDroppedProcs = graphDroppedGlobals = 0;
+  graphBytesBefore = graphBytesAfter = 0;
+}
+
+
+void ProcGraphStartPass()
+{
+  graphRecording = OPTION(gc_procs) && giPass==1 && !graphDone;
+  if (graphRecording && !graphBuckets)
+  {
+    graphBuckets = xcalloc(kcGraphBuckets, sizeof(GraphNode *));
+    graphRoot = xcalloc(1, sizeof(GraphNode));
+  }
+}
+
+
+/* returns the node of symbol, making one if create is true and there is none */
+static GraphNode *ProcGraphNode(SymbolDef *symbol, boolean create)
+{
+  GraphNode **bucket, *node;
+
+  if (!graphBuckets)
+    return NULL;
+
+  bucket = &graphBuckets[SymbolHashCode(SymbolGetId(symbol)) % kcGraphBuckets];
+  for (node = *bucket; node; node = node->next)
+    if (node->symbol == symbol)
+      return node;
+
+  if (!create)
+    return NULL;
+
+  node = xcalloc(1, sizeof(GraphNode));
+  node->symbol = symbol;
+  node->next = *bucket;
+  *bucket = node;
+  if (graphLast)
+    graphLast->nextAll = node;
+  else
+    graphFirst = node;
+  graphLast = node;
+  return node;
+}
+
+
+/* notes that from refers to to */
+static void ProcGraphAddRef(GraphNode *from, GraphNode *to)
+{
+  int i;
+
+  for (i = 0; i < from->refCount; i++)
+    if (from->refs[i] == to)
+      return;
+
+  if (from->refCount == from->refAlloc)
+  {
+    from->refAlloc = 2 * from->refAlloc + 8;
+    from->refs = xrealloc(from->refs, from->refAlloc * sizeof(GraphNode *));
+  }
+  from->refs[from->refCount++] = to;
+}
+
+
+void ProcGraphDefine(SymbolDef *symbol)
+{
+  if (graphRecording && symbol)
+    ProcGraphNode(symbol, true)->defined = true;
+}
+
+
+void ProcGraphReference(SymbolDef *symbol)
+{
+  SymbolDef *from;
+  SymbolKind kind;
+
+  if (!graphRecording)
+    return;
+
+  kind = SymbolGetKind(symbol);
+  if (kind!=symbolKindProcEntry && kind!=symbolKindProxyEntry && kind!=symbolKindData)
+    return;
+
+  from = SymbolGetCurrentProc();
+  if (from == symbol)
+    return;
+  ProcGraphAddRef(from ? ProcGraphNode(from, true) : graphRoot, ProcGraphNode(symbol, true));
+}
+
+
+boolean ProcGraphIsRecording()
+{
+  return graphRecording;
+}
+
+
+/* marks node and everything it refers to as used */
+static void ProcGraphMarkUsed(GraphNode *node)
+{
+  GraphNode **stack;
+  int        i, cStack, cAlloc;
+
+  if (!node || node->used)
+    return;
+
+  cAlloc = 64;
+  stack = xmalloc(cAlloc * sizeof(GraphNode *));
+  node->used = true;
+  stack[0] = node;
+  cStack = 1;
+  while (cStack > 0)
+  {
+    node = stack[--cStack];
+    for (i = 0; i < node->refCount; i++)
+    {
+      if (node->refs[i]->used)
+        continue;
+      node->refs[i]->used = true;
+      if (cStack == cAlloc)
+      {
+        cAlloc *= 2;
+        stack = xrealloc(stack, cAlloc * sizeof(GraphNode *));
+      }
+      stack[cStack++] = node->refs[i];
+    }
+  }
+  free(stack);
+}
+
+
+/* marks the node of the symbol named id as used (if there is one) */
+static void ProcGraphMarkUsedId(char *id)
+{
+  SymbolDef *symbol = SymbolLookup(id);
+
+  if (symbol)
+    ProcGraphMarkUsed(ProcGraphNode(symbol, false));
+}
+
+
+boolean ProcGraphEndPass()
+{
+  GraphNode *node;
+
+  if (!graphRecording)
+  {
+    if (graphDone && giPass==2)
+      graphBytesAfter = SegmentCodeTotal() + gulDataLoc;
+    return false;
+  }
+
+  graphRecording = false;
+  graphDone = true;
+  graphBytesBefore = SegmentCodeTotal() + gulDataLoc;
+
+  ProcGraphMarkUsed(graphRoot);
+  ProcGraphMarkUsedId("__Startup__");
+  ProcGraphMarkUsedId("PilotMain");
+  for (node = graphFirst; node; node = node->nextAll)
+  {
+    // PalmOS starts the application at the start of code #1
+    if (node->defined && SymbolGetKind(node->symbol)!=symbolKindData &&
+        SymbolGetValue(node->symbol)==0)
+      ProcGraphMarkUsed(node);
+  }
+
+  for (node = graphFirst; node; node = node->nextAll)
+  {
+    if (!node->defined || node->used)
+      continue;
+    if (SymbolGetKind(node->symbol)==symbolKindData)
+      graphDroppedGlobals++;
+    else
+      graphDroppedProcs++;
+  }
+
+  return graphDroppedProcs + graphDroppedGlobals > 0;
+}
+
+
+boolean ProcGraphIsDropped(SymbolDef *symbol)
+{
+  GraphNode *node;
+
+  if (!graphDone || !symbol)
+    return false;
+
+  node = ProcGraphNode(symbol, false);
+  return node && node->defined && !node->used;
+}
+
+
+void ProcGraphPrintStatistics(FILE *pfil)
+{
+  GraphNode *node;
+
+  fprintf(pfil, "Dropped %d unused procedure%s and %d global variable%s (%ld bytes)\n",
+          graphDroppedProcs, graphDroppedProcs!=1 ? "s" : "",
+          graphDroppedGlobals, graphDroppedGlobals!=1 ? "s" : "",
+          graphBytesBefore - graphBytesAfter);
+
+  if (OPTION(verbose))
+  {
+    for (node = graphFirst; node; node = node->nextAll)
+      if (node->defined && !node->used)
+        fprintf(pfil, "  %s\n", SymbolGetId(node->symbol));
+  }
+}
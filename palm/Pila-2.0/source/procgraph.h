@@ -0,0 +1,70 @@
+/**********************************************************************************
+ *
+ *      PROCGRAPH.H
+ *
+ *      Dropping procedures and global variables nothing uses (--gc-procs).
+ *
+ *      The first run of pass 1 notes which procedures (proc, proxy) and
+ *      global variables (global) each procedure refers to, by name in an
+ *      expression or with call. What is referred to from outside of any
+ *      procedure (code, data or resource blocks) is used, and so are
+ *      __Startup__, PilotMain and the procedure at the start of code #1.
+ *      So is everything a used procedure refers to. The rest is dropped:
+ *      the following runs of pass 1 and pass 2 skip a dropped procedure
+ *      up to its endproc (or endproxy) like the false part of an if, and
+ *      a dropped global variable takes no room in the data.
+ *
+ *      Data defined with dc, ds or dcb always stays, since there is no
+ *      telling where it ends. A dropped procedure in another segment keeps
+ *      its jump table entry if the first run of pass 1 made one.
+ *
+ *      ProcGraphFlush()
+ *        Forgets about the procedures and global variables of the last
+ *        assembly.
+ *
+ *      ProcGraphStartPass()
+ *        Starts noting the references if this is the first run of pass 1
+ *        and --gc-procs was given.
+ *
+ *      ProcGraphDefine(SymbolDef *symbol)
+ *        Notes that symbol is a procedure or global variable defined here,
+ *        which could be dropped.
+ *
+ *      ProcGraphReference(SymbolDef *symbol)
+ *        Notes that the current procedure (or what is outside of any)
+ *        refers to symbol.
+ *
+ *      ProcGraphIsRecording()
+ *        Returns true while the references are noted, so everything that
+ *        refers to a symbol has to be looked at again (see eval.c).
+ *
+ *      ProcGraphEndPass()
+ *        Called at the end of each pass. At the end of the first run of
+ *        pass 1 it finds out what is used and returns true if anything is
+ *        dropped, so pass 1 has to be run again.
+ *
+ *      ProcGraphIsDropped(SymbolDef *symbol)
+ *        Returns true if the procedure or global variable symbol is to be
+ *        skipped (false for NULL).
+ *
+ *      ProcGraphPrintStatistics(FILE *pfil)
+ *        Prints what was dropped and how many bytes that saved (with -d
+ *        the names, too).
+ *
+ *********************************************************************************/
+
+#ifndef _PROCGRAPH_H_
+#define _PROCGRAPH_H_
+
+#include "symbol.h"
+
+void    ProcGraphFlush();
+void    ProcGraphStartPass();
+void    ProcGraphDefine(SymbolDef *symbol);
+void    ProcGraphReference(SymbolDef *symbol);
+boolean ProcGraphIsRecording();
+boolean ProcGraphEndPass();
+boolean ProcGraphIsDropped(SymbolDef *symbol);
+void    ProcGraphPrintStatistics(FILE *pfil);
+
+#endif
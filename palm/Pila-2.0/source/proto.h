@@ -30,6 +30,10 @@ int assemble(char *);
 
 int pickMask(int, flavor *);
 
+void BranchResetStatistics(void);
+
+void BranchPrintStatistics(FILE *);
+
 int output(long, int);
 
 int effAddr(opDescriptor *);
@@ -38,8 +42,16 @@ int extWords(opDescriptor *, int);
 
 char *evaluate(char *, Value *);
 
+void EvalSetLine(LineInfo *, char *);
+
+void EvalFlush(void);
+
+void EvalPrintStatistics(FILE *);
+
 char *instLookup(char *, instruction *(*), char *);
 
+instruction *instFind(char *);
+
 char *skipSpace(char *);
 
 void help(void);
@@ -54,6 +66,14 @@ int initObj(char *);
 
 int outputObj(long, long, int);
 
+void OutputInitialize(void);
+
+unsigned char *OutputReserve(long, long);
+
+unsigned char *OutputTakeCode(void);
+
+long OutputOffset(long);
+
 long checkValue(long);
 
 int finishObj(void);
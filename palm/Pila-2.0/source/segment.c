@@ -0,0 +1,209 @@
+/**********************************************************************************
+ *
+ *      SEGMENT.C
+ *
+ *      Code segments and the jump table between them.
+ *
+ *      See segment.h for a description of the functions.
+ *
+ *********************************************************************************/
+
+#include "pila.h"
+#include "asm.h"
+#include "prc.h"
+#include "options.h"
+#include "libiberty.h"
+#include "segment.h"
+
+extern PILA_STATE int giPass;
+
+// Segment n starts at (n-1)*kcbBlockMax, which has to fit into a long
+#define kMaxSegments 127
+
+typedef struct _SegmentCode
+{
+  unsigned char *pb;
+  long           cb;
+} SegmentCode;
+
+static PILA_STATE int          segCount = 1;       // code resources so far in this pass
+static PILA_STATE int          segCountLast = 1;   // code resources in the pass before
+static PILA_STATE long         segCodeTotal = 0;   // code bytes of the segments ended in this pass
+static PILA_STATE SegmentCode *segKept = NULL;     // code #1..n (only in pass 2)
+static PILA_STATE SymbolDef  **segJumps = NULL;    // procedures in the jump table
+static PILA_STATE int          segJumpCount = 0;
+static PILA_STATE int          segJumpAlloc = 0;
+
+
+static void SegmentFreeKept()
+{
+  int i;
+
+  if (segKept)
+  {
+    for (i = 0; i < kMaxSegments; i++)
+      free(segKept[i].pb);
+    free(segKept);
+    segKept = NULL;
+  }
+}
+
+
+void SegmentFlush()
+{
+  SegmentFreeKept();
+  free(segJumps);
+  segJumps = NULL;
+  segJumpCount = segJumpAlloc = 0;
+  segCount = segCountLast = 1;
+}
+
+
+void SegmentStartPass()
+{
+  SegmentFreeKept();
+  segCountLast = segCount;
+  segCount = 1;
+  segCodeTotal = 0;
+  gulCodeBase = 0;
+
+  // a precompiled include must not bring these along
+  if (!OPTION(precompile))
+  {
+    SymbolSetRedefineable(SymbolCreate("__Segments__", symbolKindConst, NULL,
+                                       segCountLast));
+    SymbolSetRedefineable(SymbolCreate("__JumpTableEntries__", symbolKindConst, NULL,
+                                       segJumpCount));
+  }
+}
+
+
+/* notes the code of the segment that just ended (pass 2 only) */
+static void SegmentKeep(unsigned char *pb, long cb)
+{
+  if (!segKept)
+    segKept = xcalloc(kMaxSegments, sizeof(SegmentCode));
+  segKept[segCount - 1].pb = pb;
+  segKept[segCount - 1].cb = cb;
+}
+
+
+boolean SegmentBegin()
+{
+  unsigned char *pb;
+
+  if (segCount == kMaxSegments)
+    return false;
+
+  pb = OutputTakeCode();
+  if (giPass == 2)
+    SegmentKeep(pb, gulCodeLoc - gulCodeBase);
+  else
+    free(pb);
+
+  segCodeTotal += gulCodeLoc - gulCodeBase;
+  segCount++;
+  gulCodeBase += kcbBlockMax;
+  gulCodeLoc = gulCodeBase;
+  return true;
+}
+
+
+int SegmentCurrent()
+{
+  return segCount;
+}
+
+
+long SegmentCodeTotal()
+{
+  return segCodeTotal + gulCodeLoc - gulCodeBase;
+}
+
+
+int SegmentOf(long lLoc)
+{
+  return lLoc / kcbBlockMax + 1;
+}
+
+
+long SegmentJumpEntry(SymbolDef *target)
+{
+  int i;
+
+  for (i = 0; i < segJumpCount; i++)
+    if (segJumps[i] == target)
+      break;
+
+  if (i == segJumpCount)
+  {
+    if (segJumpCount == segJumpAlloc)
+    {
+      segJumpAlloc = 2 * segJumpAlloc + 16;
+      segJumps = xrealloc(segJumps, segJumpAlloc * sizeof(SymbolDef *));
+    }
+    segJumps[segJumpCount++] = target;
+  }
+
+  return -8L * (i + 1);
+}
+
+
+void SegmentFinish()
+{
+  if (segCount == 1)
+    return;
+
+  SegmentKeep(gpbCode, gulCodeLoc - gulCodeBase);
+  gpbCode = segKept[0].pb;
+  gulCodeLoc = segKept[0].cb;
+  gulCodeBase = 0;
+  segKept[0].pb = NULL;
+}
+
+
+void SegmentAddResources()
+{
+  int i;
+
+  if (!segKept)
+    return;
+
+  // each one goes in front of the others, so code #2 comes last
+  for (i = segCount - 1; i >= 1; i--)
+  {
+    AddResource(MAKE4CC('c','o','d','e'), (ushort)(i + 1), segKept[i].pb,
+                segKept[i].cb, true);
+    if (OPTION(verbose))
+      fprintf(gpfilMsg, "Code #%d: %ld bytes\n", i + 1, segKept[i].cb);
+  }
+}
+
+
+long SegmentGetJumpTable(unsigned char **ppb)
+{
+  unsigned char *pb;
+  long           lLoc, lOffset;
+  int            i, iSegment;
+
+  *ppb = NULL;
+  if (segJumpCount == 0)
+    return 0;
+
+  // entry i is at -8*(i+1)(a5), so the last one comes first
+  *ppb = xcalloc(segJumpCount, 8);
+  for (i = 0; i < segJumpCount; i++)
+  {
+    pb = *ppb + 8 * (segJumpCount - 1 - i);
+    lLoc = SymbolGetValue(segJumps[i]);
+    iSegment = SegmentOf(lLoc);
+    lOffset = lLoc - (iSegment - 1) * kcbBlockMax;
+    pb[0] = (unsigned char)(iSegment >> 8);
+    pb[1] = (unsigned char)iSegment;
+    pb[2] = (unsigned char)(lOffset >> 24);
+    pb[3] = (unsigned char)(lOffset >> 16);
+    pb[4] = (unsigned char)(lOffset >> 8);
+    pb[5] = (unsigned char)lOffset;
+  }
+  return 8L * segJumpCount;
+}
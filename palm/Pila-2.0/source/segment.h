@@ -0,0 +1,81 @@
+/**********************************************************************************
+ *
+ *      SEGMENT.H
+ *
+ *      Code in more than one code resource. The segment directive ends the
+ *      code resource being assembled and starts the next one (code #2,
+ *      code #3, ...). Code #1 is the one PalmOS starts the application in.
+ *
+ *      Each segment gets a range of kcbBlockMax addresses of its own:
+ *      segment n starts at (n-1)*kcbBlockMax (see gulCodeBase). So code
+ *      labels tell which segment they are in, and PC relative references
+ *      from one segment to another fail the usual range checks.
+ *
+ *      A call to a procedure in another segment goes through the jump
+ *      table instead. It lies below A5 (8 bytes an entry, the first at
+ *      -8(a5)) and is part of the data resource, each entry as
+ *
+ *          dc.w segment, dc.l offset within the segment, dc.w 0
+ *
+ *      The startup code (__LoadSegments__ in startup.asm) locks the code
+ *      resources 1..n and turns every entry into a "jmp address". Pila
+ *      defines __Segments__ (the number of code resources) and
+ *      __JumpTableEntries__ for it, with the values of the pass before.
+ *
+ *      SegmentFlush()
+ *        Forgets about the segments and the jump table of the last
+ *        assembly.
+ *
+ *      SegmentStartPass()
+ *        Starts over with code #1 and defines __Segments__ and
+ *        __JumpTableEntries__.
+ *
+ *      SegmentBegin()
+ *        Ends the current code segment (gpbCode, gulCodeLoc) and starts the
+ *        next. Returns false if there are too many.
+ *
+ *      SegmentCurrent()
+ *        Returns the number of the code segment being assembled.
+ *
+ *      SegmentCodeTotal()
+ *        Returns the number of code bytes in all segments of this pass
+ *        so far.
+ *
+ *      SegmentOf(long lLoc)
+ *        Returns the number of the segment code location lLoc is in.
+ *
+ *      SegmentJumpEntry(SymbolDef *target)
+ *        Returns the A5 offset of the jump table entry for the procedure
+ *        target, which gets one if it doesn't have one yet.
+ *
+ *      SegmentFinish()
+ *        Called after the last pass. Keeps the last segment and puts code
+ *        #1 back into gpbCode and gulCodeLoc.
+ *
+ *      SegmentAddResources()
+ *        Adds code #2..n to the PRC (see AddResource).
+ *
+ *      SegmentGetJumpTable(unsigned char **ppb)
+ *        Puts the initial contents of the jump table into a buffer of its
+ *        own (*ppb, the caller frees it) and returns its size. Returns 0
+ *        (and NULL) if there is no jump table.
+ *
+ *********************************************************************************/
+
+#ifndef _SEGMENT_H_
+#define _SEGMENT_H_
+
+#include "symbol.h"
+
+void    SegmentFlush();
+void    SegmentStartPass();
+boolean SegmentBegin();
+int     SegmentCurrent();
+long    SegmentCodeTotal();
+int     SegmentOf(long lLoc);
+long    SegmentJumpEntry(SymbolDef *target);
+void    SegmentFinish();
+void    SegmentAddResources();
+long    SegmentGetJumpTable(unsigned char **ppb);
+
+#endif
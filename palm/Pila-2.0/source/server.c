@@ -0,0 +1,312 @@
+/**********************************************************************************
+ *
+ *      SERVER.C
+ *
+ *      Assembling on behalf of other pila processes.
+ *
+ *      See server.h for a description of the functions.
+ *
+ *********************************************************************************/
+
+#include "pila.h"
+#include "libiberty.h"
+#include "options.h"
+#include "srccache.h"
+#include "batch.h"
+#include "server.h"
+
+#ifdef unix
+
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define SERVER_READ_CHUNK 4096
+
+// The environment variables a request brings along
+static char *serverEnv[] = { "PILAINC", "SOURCE_DATE_EPOCH", NULL };
+
+
+static int ServerSocket(char *socketName, struct sockaddr_un *addr)
+{
+  if (strlen(socketName) >= sizeof(addr->sun_path))
+  {
+    fprintf(stdout, "Socket name %s is too long\n", socketName);
+    return -1;
+  }
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  strcpy(addr->sun_path, socketName);
+  return socket(AF_UNIX, SOCK_STREAM, 0);
+}
+
+
+static boolean ServerWrite(int fd, char *pb, size_t cb)
+{
+  ssize_t cbWritten;
+
+  while (cb > 0)
+  {
+    cbWritten = write(fd, pb, cb);
+    if (cbWritten < 0 && errno == EINTR)
+      continue;
+    if (cbWritten <= 0)
+      return false;
+    pb += cbWritten;
+    cb -= cbWritten;
+  }
+  return true;
+}
+
+
+/* reads everything up to the end of the connection (zero terminated) */
+static char *ServerReadAll(int fd, long *pcb)
+{
+  long    capacity = SERVER_READ_CHUNK;
+  char   *pb = xmalloc(capacity + 1);
+  ssize_t cb;
+
+  *pcb = 0;
+  while ((cb = read(fd, pb + *pcb, capacity - *pcb)) != 0)
+  {
+    if (cb < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    *pcb += cb;
+    if (*pcb == capacity)
+    {
+      capacity *= 2;
+      pb = xrealloc(pb, capacity + 1);
+    }
+  }
+  pb[*pcb] = 0;
+  return pb;
+}
+
+
+/* runs the request coming in on fd, with stdout going back to the client */
+static void ServerServe(int fd)
+{
+  char  *request, *pch, *pchValue, **apsz, szRc[16];
+  long   cb;
+  int    cpsz, i, rc, fdStdout;
+
+  // cwd, the environment and the command line, one string each
+  request = ServerReadAll(fd, &cb);
+  apsz = xmalloc((cb + 1) * sizeof(char *));
+  for (cpsz = 0, pch = request; pch < request + cb; pch += strlen(pch) + 1)
+    apsz[cpsz++] = pch;
+  for (i = 0; serverEnv[i]; i++)
+    ;
+  if (cpsz < 1 + i + 1)
+  {
+    free(apsz);
+    free(request);
+    return;
+  }
+
+  fflush(stdout);
+  fdStdout = dup(1);
+  dup2(fd, 1);
+
+  for (i = 0; serverEnv[i]; i++)
+  {
+    pchValue = strchr(apsz[1 + i], '=');
+    if (pchValue)
+      setenv(serverEnv[i], pchValue + 1, 1);
+    else
+      unsetenv(serverEnv[i]);
+  }
+
+  memset(&globalOptions, 0, sizeof(options));
+  if (chdir(apsz[0]) != 0)
+  {
+    fprintf(stdout, "The server can't change to %s\n", apsz[0]);
+    rc = 1;
+  }
+  else if (!SetArgFlags(cpsz - 1 - i, apsz + 1 + i) || !OPTION(in_fname))
+  {
+    fputs("The server can't handle this command line\n", stdout);
+    rc = 1;
+  }
+  else
+    rc = BatchAssemble(OPTION(in_fnames), OPTION(in_count), OPTION(jobs),
+                       &globalOptions);
+  free(OPTION(in_fnames));
+  memset(&globalOptions, 0, sizeof(options));
+
+  fflush(stdout);
+  dup2(fdStdout, 1);
+  close(fdStdout);
+
+  szRc[0] = 0;
+  sprintf(szRc + 1, "%d", rc);
+  ServerWrite(fd, szRc, 1 + strlen(szRc + 1));
+
+  free(apsz);
+  free(request);
+}
+
+
+int ServerRun(char *socketName)
+{
+  struct sockaddr_un addr;
+  char cwd[_MAX_PATH], *pszSocket;
+  int fd, fdConn;
+
+  // requests change the current directory
+  pszSocket = NULL;
+  if (socketName[0] != '/' && getcwd(cwd, sizeof(cwd)) != NULL)
+  {
+    pszSocket = xmalloc(strlen(cwd) + 1 + strlen(socketName) + 1);
+    sprintf(pszSocket, "%s/%s", cwd, socketName);
+    socketName = pszSocket;
+  }
+
+  fd = ServerSocket(socketName, &addr);
+  if (fd < 0)
+  {
+    free(pszSocket);
+    return 1;
+  }
+
+  // a socket nobody answers on is left over from an earlier server
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0)
+  {
+    fprintf(stdout, "There is a server on %s already\n", socketName);
+    close(fd);
+    free(pszSocket);
+    return 1;
+  }
+  close(fd);
+  unlink(socketName);
+
+  fd = ServerSocket(socketName, &addr);
+  if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+      listen(fd, 16) != 0)
+  {
+    fprintf(stdout, "Can't listen on %s\n", socketName);
+    if (fd >= 0)
+      close(fd);
+    free(pszSocket);
+    return 1;
+  }
+
+  // a client going away must not take the server with it
+  signal(SIGPIPE, SIG_IGN);
+
+  fprintf(stdout, "Waiting for requests on %s\n", socketName);
+  fflush(stdout);
+
+  SourceCacheShare(true);
+  for (;;)
+  {
+    fdConn = accept(fd, NULL, NULL);
+    if (fdConn < 0)
+    {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      break;
+    }
+    SourceCacheRefresh();
+    ServerServe(fdConn);
+    close(fdConn);
+  }
+  SourceCacheShare(false);
+
+  fprintf(stdout, "Can't accept requests on %s\n", socketName);
+  close(fd);
+  unlink(socketName);
+  free(pszSocket);
+  return 1;
+}
+
+
+int ServerRequest(char *socketName, int argc, char *argv[])
+{
+  struct sockaddr_un addr;
+  char    cwd[_MAX_PATH], buffer[SERVER_READ_CHUNK], szRc[16], *psz, *pch;
+  ssize_t cb;
+  int     fd, i, cchRc;
+  boolean fOk, fEnd;
+
+  if (getcwd(cwd, sizeof(cwd)) == NULL)
+    return -1;
+  fd = ServerSocket(socketName, &addr);
+  if (fd < 0)
+    return -1;
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+  {
+    close(fd);
+    return -1;
+  }
+
+  signal(SIGPIPE, SIG_IGN);
+  fOk = ServerWrite(fd, cwd, strlen(cwd) + 1);
+  for (i = 0; serverEnv[i]; i++)
+  {
+    psz = getenv(serverEnv[i]);
+    fOk = fOk && ServerWrite(fd, serverEnv[i], strlen(serverEnv[i]));
+    if (psz)
+      fOk = fOk && ServerWrite(fd, "=", 1) && ServerWrite(fd, psz, strlen(psz));
+    fOk = fOk && ServerWrite(fd, "", 1);
+  }
+  for (i = 0; i < argc; i++)
+    fOk = fOk && ServerWrite(fd, argv[i], strlen(argv[i]) + 1);
+  shutdown(fd, SHUT_WR);
+
+  // the messages, a zero byte and the exit code
+  fEnd = false;
+  cchRc = 0;
+  while (fOk && (cb = read(fd, buffer, sizeof(buffer))) != 0)
+  {
+    if (cb < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    pch = fEnd ? buffer : memchr(buffer, 0, cb);
+    if (!fEnd)
+      fwrite(buffer, 1, pch ? pch - buffer : cb, stdout);
+    if (pch)
+    {
+      if (!fEnd)
+        pch++;
+      fEnd = true;
+      while (pch < buffer + cb && cchRc < (int)sizeof(szRc) - 1)
+        szRc[cchRc++] = *pch++;
+    }
+  }
+  close(fd);
+  fflush(stdout);
+
+  if (!fOk || !fEnd)
+  {
+    fputs("Lost the connection to the pila server\n", stdout);
+    return 1;
+  }
+  szRc[cchRc] = 0;
+  return atoi(szRc);
+}
+
+#else
+
+int ServerRun(char *socketName)
+{
+  fputs("The pila server only runs on unix systems\n", stdout);
+  return 1;
+}
+
+
+int ServerRequest(char *socketName, int argc, char *argv[])
+{
+  return -1;
+}
+
+#endif
@@ -0,0 +1,36 @@
+/**********************************************************************************
+ *
+ *      SERVER.H
+ *
+ *      Pila as a server (pila --server SOCKET). The server keeps running
+ *      and assembles on behalf of "pila --connect SOCKET ..." clients, so
+ *      they neither pay for starting pila nor for reading the SDK include
+ *      files again: the texts of all files read stay in memory (see
+ *      SourceCacheShare) until they change on disk.
+ *
+ *      A client sends its current directory, $PILAINC, $SOURCE_DATE_EPOCH
+ *      and its command line, each terminated by a zero byte, and closes its
+ *      side of the connection. The server runs BatchAssemble in the
+ *      client's directory and environment and sends back everything pila
+ *      would have printed, a zero byte and the exit code as a decimal
+ *      number. Requests are served one after the other.
+ *
+ *      ServerRun(char *socketName)
+ *        Listens on the local (unix domain) socket socketName and serves
+ *        requests until the process is killed. Returns only if the socket
+ *        could not be set up (with the exit code for pila).
+ *
+ *      ServerRequest(char *socketName, int argc, char *argv[])
+ *        Has the server at socketName assemble with the given command
+ *        line, prints its messages to stdout and returns the exit code.
+ *        Returns -1 without printing anything if there is no server.
+ *
+ *********************************************************************************/
+
+#ifndef _SERVER_H_
+#define _SERVER_H_
+
+int ServerRun(char *socketName);
+int ServerRequest(char *socketName, int argc, char *argv[]);
+
+#endif
@@ -0,0 +1,273 @@
+/**********************************************************************************
+ *
+ *      SRCCACHE.C
+ *
+ *      In-memory cache of the source files read by the assembler. Every file
+ *      is read from disk only once (on the first pass that includes it) and
+ *      split into lines. All following passes are served from memory.
+ *
+ *      See srccache.h for a description of the functions.
+ *
+ *********************************************************************************/
+
+#include "pila.h"
+#include <sys/stat.h>
+#include <limits.h>
+#include <stdlib.h>
+#include "libiberty.h"
+#include "srccache.h"
+#include "inputs.h"
+
+#define SOURCE_READ_CHUNK 0x10000
+
+static PILA_STATE SourceFile *sourceCache = NULL;	// list of all files read so far
+
+static PILA_STATE long cachedBytesServed = 0;	// bytes served for files opened before
+static PILA_STATE long cachedLinesServed = 0;	// lines served for files opened before
+
+// With SourceCacheShare(true) the text of every file is read only once
+// for all threads. The threads keep their own SourceFile entries, which
+// just point to the shared text.
+static SourceFile *sharedCache = NULL;		// texts shared by all threads
+static int         sharedCacheEnabled = 0;	// nesting count of SourceCacheShare(true)
+static PilaLock    sharedCacheLock = PILA_LOCK_INIT;
+
+
+static SourceFile *SourceCacheRead(char *fileName)
+{
+  FILE       *pfil;
+  SourceFile *file;
+  long        capacity = SOURCE_READ_CHUNK;
+  long        cb;
+  long        i;
+  int         line;
+
+  pfil = fopen(fileName, "r");
+  if (pfil == NULL || pfil == (FILE *)-1)
+    return NULL;
+
+  file = xcalloc(1, sizeof(SourceFile));
+  file->name = xstrdup(fileName);
+  file->text = xmalloc(capacity+1);
+  file->size = 0;
+
+  // read the whole file (in text mode, so we can't trust its size on disk)
+  while ((cb = fread(file->text+file->size, 1, capacity-file->size, pfil)) > 0)
+  {
+    file->size += cb;
+    if (file->size == capacity)
+    {
+      capacity *= 2;
+      file->text = xrealloc(file->text, capacity+1);
+    }
+  }
+  fclose(pfil);
+  file->text[file->size] = '\0';
+
+  // count the lines (a last line without terminator counts as well)
+  file->lineCount = 0;
+  for (i = 0; i < file->size; i++)
+    if (file->text[i] == '\n')
+      file->lineCount++;
+  if (file->size > 0 && file->text[file->size-1] != '\n')
+    file->lineCount++;
+
+  // and remember where each of them starts
+  file->lineStart = xmalloc((file->lineCount+1)*sizeof(long));
+  file->lineStart[0] = 0;
+  for (i = 0, line = 1; i < file->size; i++)
+    if (file->text[i] == '\n' && line <= file->lineCount)
+      file->lineStart[line++] = i+1;
+  file->lineStart[file->lineCount] = file->size;
+
+  return file;
+}
+
+
+/* returns true if st is the file the shared text was read from */
+static boolean SourceCacheIsSame(SourceFile *text, struct stat *st)
+{
+  return st->st_dev == text->device && st->st_ino == text->inode &&
+         st->st_size == text->diskSize && st->st_mtime == text->modified &&
+         st->st_mtim.tv_nsec == text->modifiedNsec;
+}
+
+
+static SourceFile *SourceCacheLoad(char *fileName)
+{
+  SourceFile *file, *text;
+  struct stat st;
+  char        path[PATH_MAX];
+
+  if (!sharedCacheEnabled)
+    file = SourceCacheRead(fileName);
+  else
+  {
+    // the same name may be another file in another directory
+    if (realpath(fileName, path) == NULL || stat(path, &st) != 0)
+      return NULL;
+
+    PilaLockEnter(&sharedCacheLock);
+    text = sharedCache;
+    while (text && (strcmp(text->path, path) != 0 || !SourceCacheIsSame(text, &st)))
+      text = text->next;
+    // look at the file before reading it, so a change while it is read
+    // shows up in SourceCacheRefresh
+    if (!text && (text = SourceCacheRead(path)) != NULL)
+    {
+      text->path         = xstrdup(path);
+      text->device       = st.st_dev;
+      text->inode        = st.st_ino;
+      text->modified     = st.st_mtime;
+      text->modifiedNsec = st.st_mtim.tv_nsec;
+      text->diskSize     = st.st_size;
+      text->next = sharedCache;
+      sharedCache = text;
+    }
+    PilaLockLeave(&sharedCacheLock);
+
+    if (!text)
+      return NULL;
+
+    file = xcalloc(1, sizeof(SourceFile));
+    file->name      = xstrdup(fileName);
+    file->text      = text->text;
+    file->size      = text->size;
+    file->lineStart = text->lineStart;
+    file->lineCount = text->lineCount;
+    file->shared    = true;
+  }
+
+  if (file)
+  {
+    file->next = sourceCache;
+    sourceCache = file;
+    InputRecord(fileName, file->text, file->size);
+  }
+
+  return file;
+}
+
+
+SourceFile *SourceCacheOpen(char *fileName)
+{
+  SourceFile *file = sourceCache;
+
+  while (file && strcmp(file->name, fileName) != 0)
+    file = file->next;
+
+  if (!file)
+    file = SourceCacheLoad(fileName);
+
+  if (file)
+    file->useCount++;
+
+  return file;
+}
+
+
+int SourceCacheReadLine(SourceFile *file, int lineNo, char **line, size_t *capacity)
+{
+  long len;
+
+  if (lineNo >= file->lineCount)
+    return -1;
+
+  len = file->lineStart[lineNo+1] - file->lineStart[lineNo];
+  if (*line == NULL || *capacity < (size_t)len+1)
+  {
+    *capacity = len < 80 ? 81 : len+1;
+    *line = xrealloc(*line, *capacity);
+  }
+  memcpy(*line, file->text+file->lineStart[lineNo], len);
+  (*line)[len] = '\0';
+
+  if (file->useCount > 1)
+  {
+    cachedBytesServed += len;
+    cachedLinesServed++;
+  }
+
+  return len;
+}
+
+
+void SourceCacheGetStats(long *bytes, long *lines)
+{
+  *bytes = cachedBytesServed;
+  *lines = cachedLinesServed;
+}
+
+
+void SourceCacheFlush()
+{
+  SourceFile *file;
+
+  while (sourceCache)
+  {
+    file = sourceCache;
+    sourceCache = file->next;
+    free(file->name);
+    if (!file->shared)
+    {
+      free(file->text);
+      free(file->lineStart);
+    }
+    free(file->lineInfo);
+    free(file->guardLines);
+    free(file->guards);
+    free(file);
+  }
+  cachedBytesServed = 0;
+  cachedLinesServed = 0;
+}
+
+
+static void SourceCacheFreeShared(SourceFile *file)
+{
+  free(file->name);
+  free(file->path);
+  free(file->text);
+  free(file->lineStart);
+  free(file);
+}
+
+
+void SourceCacheShare(boolean share)
+{
+  SourceFile *file;
+
+  PilaLockEnter(&sharedCacheLock);
+  sharedCacheEnabled += share ? 1 : -1;
+  if (sharedCacheEnabled == 0)
+  {
+    while (sharedCache)
+    {
+      file = sharedCache;
+      sharedCache = file->next;
+      SourceCacheFreeShared(file);
+    }
+  }
+  PilaLockLeave(&sharedCacheLock);
+}
+
+
+void SourceCacheRefresh()
+{
+  SourceFile **pfile, *file;
+  struct stat  st;
+
+  PilaLockEnter(&sharedCacheLock);
+  pfile = &sharedCache;
+  while ((file = *pfile) != NULL)
+  {
+    if (stat(file->path, &st) != 0 || !SourceCacheIsSame(file, &st))
+    {
+      *pfile = file->next;
+      SourceCacheFreeShared(file);
+    }
+    else
+      pfile = &file->next;
+  }
+  PilaLockLeave(&sharedCacheLock);
+}
@@ -0,0 +1,88 @@
+/**********************************************************************************
+ *
+ *      SRCCACHE.H
+ *
+ *      In-memory cache of the source files read by the assembler. Every file
+ *      is read from disk only once (on the first pass that includes it) and
+ *      split into lines. All following passes are served from memory.
+ *
+ *      SourceCacheOpen(char *fileName)
+ *        Returns the cache entry for the given (already resolved) file name.
+ *        The file is read and split into lines the first time it is
+ *        requested. Returns NULL if the file can not be read.
+ *
+ *      SourceCacheReadLine(SourceFile *file, int lineNo, char **line, size_t *capacity)
+ *        Copies line number lineNo (counting from 0) including its line
+ *        terminator into the buffer pointed to by *line (growing it as
+ *        necessary). Returns the length of the line or -1 if lineNo is beyond
+ *        the end of the file. The copy is needed since the parser modifies
+ *        the line it is working on.
+ *
+ *      SourceCacheGetStats(long *bytes, long *lines)
+ *        Returns the number of bytes and lines that were served from memory
+ *        for files that had already been read before.
+ *
+ *      SourceCacheFlush()
+ *        Frees all cached files (including the lineInfo and guard arrays
+ *        the assembler attached to them).
+ *
+ *      SourceCacheShare(boolean share)
+ *        The cache normally belongs to the thread that filled it. Between
+ *        SourceCacheShare(true) and SourceCacheShare(false) the text of
+ *        each file is read only once and shared by all threads, which
+ *        saves reading the same include files over and over when many
+ *        files are assembled in one go. Calls may be nested; the last
+ *        SourceCacheShare(false) frees the shared texts. No thread may be
+ *        assembling at that time.
+ *
+ *      The shared texts are kept by the real path of each file (the
+ *      server changes the current directory for each request), and one is
+ *      only used while the file on disk is still the same: device, inode,
+ *      size and modification time (with nanoseconds).
+ *
+ *      SourceCacheRefresh()
+ *        Drops the shared texts of all files that changed (or vanished)
+ *        since they were read, so they are read again when needed. Like
+ *        SourceCacheShare(false) this must not be called while a thread
+ *        is assembling.
+ *
+ *********************************************************************************/
+
+#ifndef _SRCCACHE_H_
+#define _SRCCACHE_H_
+
+#include <stddef.h>
+#include <time.h>
+#include <sys/types.h>
+
+typedef struct _SourceFile
+{
+  struct _SourceFile *next;
+  char  *name;		// resolved file name (the cache key)
+  char  *text;		// complete file contents, '\0' terminated
+  long   size;		// number of bytes in text
+  long  *lineStart;	// offset of each line in text (lineCount+1 entries)
+  int    lineCount;	// number of lines in the file
+  int    useCount;	// number of times the file was opened
+  boolean shared;	// text and lineStart belong to the shared cache
+  char  *path;		// real path, device, inode, time and size of the
+  dev_t  device;	//   file on disk when it was read (only kept for
+  ino_t  inode;		//   the shared texts)
+  time_t modified;
+  long   modifiedNsec;
+  long   diskSize;
+  struct _LineInfo *lineInfo;	// per line parse results (see assemble.c)
+  struct _GuardLine *guardLines;	// per line index into guards (see guard.c)
+  struct _GuardEntry *guards;	// guards recorded for lines of this file
+  int    guardCount;	// number of entries used in guards
+  int    guardCapacity;	// number of entries allocated for guards
+} SourceFile;
+
+SourceFile *SourceCacheOpen(char *fileName);
+int         SourceCacheReadLine(SourceFile *file, int lineNo, char **line, size_t *capacity);
+void        SourceCacheGetStats(long *bytes, long *lines);
+void        SourceCacheFlush();
+void        SourceCacheShare(boolean share);
+void        SourceCacheRefresh();
+
+#endif
@@ -49,63 +49,70 @@
 #include "symbol.h"
 #include "safe-ctype.h"
 #include "libiberty.h"
+#include "obstack.h"
 
-extern int  giPass;         /* The assembler's pass counter */
-extern long gulOutLoc;      /* The assembler's location counter */
+extern PILA_STATE int  giPass;         /* The assembler's pass counter */
+extern PILA_STATE int  giPassRun;      /* Number of passes run so far */
+extern PILA_STATE long gulOutLoc;      /* The assembler's location counter */
 
-SymbolDef *symbolCurrentProcedure;
+PILA_STATE SymbolDef *symbolCurrentProcedure;
 
-#define MAXHASH 1024
-SymbolDef *symbolHashTable[MAXHASH+1];
-
-int tempLabelPass = -1;
-int tempLabelCounter[9];
-
-void breakpoint()
+// All symbol ids are interned in an open addressing hash table (using
+// linear probing) that doubles its size whenever it gets half full.
+// Each id is stored only once, so two ids are equal if their pointers
+// are. The entry of an id also holds the global symbol with that id.
+typedef struct _SymbolName
 {
-//  printf("\nbreakpoint\n");
-}
-
-long checkCounter = 0;
-SymbolDef *checkSymbol = NULL;
-SymbolDef *check(SymbolDef *symbol)
+  char          *id;		// the interned id
+  unsigned long  hash;		// SymbolHashCode(id)
+  SymbolDef     *global;	// global symbol with this id (NULL if none)
+  boolean        missed;	// SymbolLookup failed for this id (see SymbolRecordMisses)
+} SymbolName;
+
+#define SYMBOL_TABLE_MIN_SIZE 1024	// must be a power of two
+PILA_STATE SymbolName  **symbolHashTable = NULL;
+PILA_STATE unsigned long symbolHashSize  = 0;	// number of slots in symbolHashTable
+PILA_STATE unsigned long symbolHashCount = 0;	// number of slots in use
+
+// Symbols, ids and hash table entries are never freed one by one. They
+// all come from this obstack and are released together.
+#define obstack_chunk_alloc xmalloc
+#define obstack_chunk_free  free
+PILA_STATE struct obstack symbolStack;
+PILA_STATE boolean        symbolStackInitialized = false;
+
+// statistics for the --stats option
+PILA_STATE unsigned long symbolHashLookups = 0;	// number of searches in symbolHashTable
+PILA_STATE unsigned long symbolHashProbes  = 0;	// number of slots looked at by these searches
+PILA_STATE unsigned long symbolHashGrowths = 0;	// number of times the table was doubled
+PILA_STATE unsigned long symbolGlobalCount = 0;	// number of global symbols
+
+// number of symbols whose value changed during the current pass
+PILA_STATE long symbolChangeCount = 0;
+
+// counting up whenever an expression of constants could get a different
+// value (see SymbolGetChangeStamp)
+PILA_STATE long symbolConstStamp = 0;	// a constant or type changed
+PILA_STATE long symbolScopeStamp = 0;	// a procedure or type got a new member
+
+// true if SymbolLookup has to remember the ids it did not find
+PILA_STATE boolean symbolRecordMisses = false;
+
+// the simple types every symbol table starts out with
+#define SYMBOL_PREDEFINED_COUNT 9
+struct
 {
-  checkCounter++;
-  printf("%d-%ld ",giPass,checkCounter);
+  char *id;
+  long  size;
+} symbolPredefinedTypes[SYMBOL_PREDEFINED_COUNT] = {
+  {"void",0}, {"int",2}, {"float",4}, {"double",8}, {"char",1},
+  {"b",1}, {"w",2}, {"l",4}, {"d",8}
+};
+PILA_STATE SymbolDef *symbolPredefined[SYMBOL_PREDEFINED_COUNT];
 
-  if (checkCounter>=125957)
-    breakpoint();
+PILA_STATE int tempLabelPass = -1;
+PILA_STATE int tempLabelCounter[9];
 
-  if (symbol && symbol->id && strcmp(symbol->id,"DmNewHandle")==0)
-  {
-    printf("\n%d-%ld %s identified ",giPass,checkCounter,symbol->id);
-    if (checkSymbol && checkSymbol!=symbol)
-    {
-      printf("boom - redefined\n");
-      exit(2000);
-    }
-    if (checkSymbol && checkSymbol->value.type!=symbol->value.type)
-      printf("type redefined ");
-    checkSymbol = symbol;
-  }
-  
-  if (checkSymbol)
-  {
-    if (!checkSymbol->value.type)
-      printf("no type yet\n");
-    else if (!checkSymbol->value.type->id)
-      printf("no type id yet\n");
-    else if (strcmp(checkSymbol->value.type->id,"MemHandle")==0)
-      printf("passed\n");
-    else
-    {
-      printf("boom - invalid type\n");
-      exit(2000);
-    }
-  }
-  
-  return symbol;
-}
 #define check(x) x
 
 /**********************************************************************/
@@ -120,18 +127,99 @@ SymbolDef *check(SymbolDef *symbol)
 void SymbolInitialize()
 {
   int i;
+
+  SymbolTerminate();
   symbolCurrentProcedure = NULL;
-  for (i=0; i<=MAXHASH; i++)
-    symbolHashTable[i] = NULL;
-  SymbolCreate("void",symbolKindTypeSimple,NULL,0);
-  SymbolCreate("int",symbolKindTypeSimple,NULL,2);
-  SymbolCreate("float",symbolKindTypeSimple,NULL,4);
-  SymbolCreate("double",symbolKindTypeSimple,NULL,8);
-  SymbolCreate("char",symbolKindTypeSimple,NULL,1);
-  SymbolCreate("b",symbolKindTypeSimple,NULL,1);
-  SymbolCreate("w",symbolKindTypeSimple,NULL,2);
-  SymbolCreate("l",symbolKindTypeSimple,NULL,4);
-  SymbolCreate("d",symbolKindTypeSimple,NULL,8);
+  obstack_init(&symbolStack);
+  symbolStackInitialized = true;
+  symbolHashSize    = SYMBOL_TABLE_MIN_SIZE;
+  symbolHashCount   = 0;
+  symbolHashTable   = xcalloc(symbolHashSize,sizeof(SymbolName *));
+  symbolHashLookups = 0;
+  symbolHashProbes  = 0;
+  symbolHashGrowths = 0;
+  symbolGlobalCount = 0;
+  symbolChangeCount = 0;
+  symbolConstStamp  = 0;
+  symbolScopeStamp  = 0;
+  symbolRecordMisses = false;
+  tempLabelPass     = -1;
+  for (i=0; i<SYMBOL_PREDEFINED_COUNT; i++)
+    symbolPredefined[i] = SymbolCreate(symbolPredefinedTypes[i].id,symbolKindTypeSimple,
+                                       NULL,symbolPredefinedTypes[i].size);
+}
+
+
+/**********************************************************************/
+/* Routine: SymbolTerminate                                           */
+/*   Releasing all symbols at once                                    */
+/*--------------------------------------------------------------------*/
+/* Parameters:                                                        */
+/*     void                                                           */
+/* Returns:                                                           */
+/*     void                                                           */
+/**********************************************************************/
+void SymbolTerminate()
+{
+  if (symbolStackInitialized)
+    obstack_free(&symbolStack,NULL);
+  symbolStackInitialized = false;
+  free(symbolHashTable);
+  symbolHashTable = NULL;
+  symbolHashSize  = 0;
+  symbolHashCount = 0;
+  symbolCurrentProcedure = NULL;
+}
+
+
+/**********************************************************************/
+/* Routine: SymbolResetChangeCount                                    */
+/*   Starting to count the symbols whose value changes                */
+/*--------------------------------------------------------------------*/
+/* Parameters:                                                        */
+/*     void                                                           */
+/* Returns:                                                           */
+/*     void                                                           */
+/**********************************************************************/
+void SymbolResetChangeCount()
+{
+  symbolChangeCount = 0;
+}
+
+
+/**********************************************************************/
+/* Routine: SymbolGetChangeCount                                      */
+/*   Returns the number of times a (not redefineable) symbol got a    */
+/*   different value since the last call of SymbolResetChangeCount    */
+/*--------------------------------------------------------------------*/
+/* Parameters:                                                        */
+/*     void                                                           */
+/* Returns:                                                           */
+/*     number of changes                                              */
+/**********************************************************************/
+long SymbolGetChangeCount()
+{
+  return symbolChangeCount;
+}
+
+
+/**********************************************************************/
+/* Routine: SymbolGetChangeStamp                                      */
+/*   Returns a number that changes whenever an expression of (not     */
+/*   redefineable) constants could get a different value: one of     */
+/*   them or a type changed, or (inside of a procedure) a new local   */
+/*   symbol could hide a global one                                   */
+/*--------------------------------------------------------------------*/
+/* Parameters:                                                        */
+/*     void                                                           */
+/* Returns:                                                           */
+/*     the stamp                                                      */
+/**********************************************************************/
+long SymbolGetChangeStamp()
+{
+  if (symbolCurrentProcedure)
+    return symbolConstStamp+symbolScopeStamp;
+  return symbolConstStamp;
 }
 
 
@@ -169,6 +257,22 @@ boolean SymbolHasCurrentProc()
 }
 
 
+/**********************************************************************/
+/* Routine: SymbolGetCurrentProc                                      */
+/*   Returns the symbol of the currently worked on procedure (NULL    */
+/*   outside of procedures).                                          */
+/*--------------------------------------------------------------------*/
+/* Parameters:                                                        */
+/*     void                                                           */
+/* Returns:                                                           */
+/*     SymbolDef*                                                     */
+/**********************************************************************/
+SymbolDef *SymbolGetCurrentProc()
+{
+  return symbolCurrentProcedure;
+}
+
+
 /**********************************************************************/
 /* Routine: SymbolGetCategory                                         */
 /*   Returning category of a given kind                               */
@@ -190,22 +294,207 @@ SymbolCategory SymbolGetCategory(SymbolKind kind)
 		
 /**********************************************************************/
 /* Routine: SymbolHashCode                                            */
-/*   Calculates a hash code from the symbol id                        */ 
+/*   Calculates a hash code from the symbol id (32 bit FNV-1a)        */ 
 /*--------------------------------------------------------------------*/
 /* Parameters:                                                        */
-/*   symbol - pointer to symbol definition                            */
+/*       id - pointer to symbol name                                  */
 /* Returns:                                                           */
 /*     hash code                                                      */
 /**********************************************************************/
-int SymbolHashCode(char *id)
+unsigned long SymbolHashCode(char *id)
 {
-    short sum = 0;
+    unsigned long hash = 2166136261UL;
     while (*id)
     {
-        sum += (ISUPPER(*id)) ? (*id - 'A') : MAXHASH;
-        id++;
+        hash ^= (unsigned char)*id++;
+        hash  = (hash*16777619UL) & 0xffffffffUL;
+    }
+    return hash;
+}
+
+/**********************************************************************/
+/* Routine: SymbolHashSlot                                            */
+/*   Finds the slot of the hash table holding the given id or the     */
+/*   empty slot where it would have to be stored.                     */
+/*--------------------------------------------------------------------*/
+/* Parameters:                                                        */
+/*       id - pointer to symbol name                                  */
+/*     hash - SymbolHashCode(id)                                      */
+/* Returns:                                                           */
+/*     pointer to the slot                                            */
+/**********************************************************************/
+SymbolName **SymbolHashSlot(char *id, unsigned long hash)
+{
+    unsigned long mask = symbolHashSize-1;
+    unsigned long i    = hash & mask;
+    SymbolName   *name;
+
+    symbolHashLookups++;
+    symbolHashProbes++;
+    while ((name = symbolHashTable[i])!=NULL &&
+           (name->hash!=hash || strcmp(name->id,id)!=0))
+    {
+        i = (i+1) & mask;
+        symbolHashProbes++;
+    }
+    return &symbolHashTable[i];
+}
+
+/**********************************************************************/
+/* Routine: SymbolHashGrow                                            */
+/*   Doubles the size of the hash table and rehashes all ids.         */
+/*--------------------------------------------------------------------*/
+/* Parameters:                                                        */
+/*     void                                                           */
+/* Returns:                                                           */
+/*     void                                                           */
+/**********************************************************************/
+void SymbolHashGrow()
+{
+    SymbolName  **oldTable = symbolHashTable;
+    unsigned long oldSize  = symbolHashSize;
+    unsigned long mask, i, j;
+
+    symbolHashSize *= 2;
+    symbolHashTable = xcalloc(symbolHashSize,sizeof(SymbolName *));
+    symbolHashGrowths++;
+
+    mask = symbolHashSize-1;
+    for (i=0; i<oldSize; i++)
+    {
+        if (oldTable[i])
+        {
+            j = oldTable[i]->hash & mask;
+            while (symbolHashTable[j])
+                j = (j+1) & mask;
+            symbolHashTable[j] = oldTable[i];
+        }
     }
-    return sum%((short)(MAXHASH+1));
+    free(oldTable);
+}
+
+/**********************************************************************/
+/* Routine: SymbolIntern                                              */
+/*   Returns the hash table entry of an id (creating it if needed)    */
+/*--------------------------------------------------------------------*/
+/* Parameters:                                                        */
+/*       id - pointer to symbol name                                  */
+/* Returns:                                                           */
+/*     pointer to the entry holding the interned id                   */
+/**********************************************************************/
+SymbolName *SymbolIntern(char *id)
+{
+    unsigned long hash = SymbolHashCode(id);
+    SymbolName  **slot = SymbolHashSlot(id,hash);
+    SymbolName   *name = *slot;
+
+    if (!name)
+    {
+        name = obstack_alloc(&symbolStack,sizeof(SymbolName));
+        name->id     = obstack_copy0(&symbolStack,id,strlen(id));
+        name->hash   = hash;
+        name->global = NULL;
+        name->missed = false;
+        *slot = name;
+        if (++symbolHashCount*2 > symbolHashSize)
+            SymbolHashGrow();
+    }
+    return name;
+}
+
+/**********************************************************************/
+/* Routine: SymbolFindId                                              */
+/*   Returns the interned copy of an id without creating one          */
+/*--------------------------------------------------------------------*/
+/* Parameters:                                                        */
+/*       id - pointer to symbol name                                  */
+/* Returns:                                                           */
+/*     interned id, NULL if no symbol was ever created with that id   */
+/**********************************************************************/
+char *SymbolFindId(char *id)
+{
+    SymbolName *name = *SymbolHashSlot(id,SymbolHashCode(id));
+    return name ? name->id : NULL;
+}
+
+/**********************************************************************/
+/* Routine: SymbolPrintStatistics                                     */
+/*   Prints the fill level of the hash table, the distribution of     */
+/*   the probe lengths needed to find the stored ids and the          */
+/*   average number of probes of all searches done so far.            */
+/*--------------------------------------------------------------------*/
+/* Parameters:                                                        */
+/*     pfil - file to print to                                        */
+/* Returns:                                                           */
+/*     void                                                           */
+/**********************************************************************/
+#define PROBE_HISTOGRAM_SIZE 10
+
+void SymbolPrintStatistics(FILE *pfil)
+{
+    unsigned long histogram[PROBE_HISTOGRAM_SIZE];
+    unsigned long mask = symbolHashSize-1;
+    unsigned long i, probes, maxProbes = 0, totalProbes = 0;
+
+    memset(histogram,0,sizeof(histogram));
+    for (i=0; i<symbolHashSize; i++)
+    {
+        if (symbolHashTable[i])
+        {
+            // distance from the slot the id hashes to (plus the slot itself)
+            probes = ((i-symbolHashTable[i]->hash) & mask) + 1;
+            totalProbes += probes;
+            if (probes>maxProbes)
+                maxProbes = probes;
+            histogram[probes<PROBE_HISTOGRAM_SIZE ? probes-1 : PROBE_HISTOGRAM_SIZE-1]++;
+        }
+    }
+
+    fprintf(pfil, "Symbol table: %lu ids (%lu global symbols) in %lu slots (%lu%% used, grown %lu times)\n",
+            symbolHashCount, symbolGlobalCount, symbolHashSize,
+            symbolHashCount*100/symbolHashSize, symbolHashGrowths);
+    fprintf(pfil, "Symbol table: probes per stored id: average %.2f, maximum %lu\n",
+            symbolHashCount ? (double)totalProbes/symbolHashCount : 0.0, maxProbes);
+    for (i=0; i<PROBE_HISTOGRAM_SIZE; i++)
+        if (histogram[i])
+            fprintf(pfil, "Symbol table: %3lu%s probe%s: %lu ids\n", i+1,
+                    i==PROBE_HISTOGRAM_SIZE-1 ? "+" : " ", i ? "s" : " ", histogram[i]);
+    fprintf(pfil, "Symbol table: %lu searches with %.2f probes on average\n",
+            symbolHashLookups,
+            symbolHashLookups ? (double)symbolHashProbes/symbolHashLookups : 0.0);
+    fprintf(pfil, "Symbol table: %lu bytes of symbol memory\n",
+            (unsigned long)obstack_memory_used(&symbolStack));
+}
+
+/**********************************************************************/
+/* Routine: SymbolAllocate                                            */
+/*   Allocate and initialize symbol structure for an interned id      */ 
+/*--------------------------------------------------------------------*/
+/* Parameters:                                                        */
+/*       id - pointer to interned symbol name (can be NULL)           */
+/*     kind - kind spec of symbol                                     */
+/*     type - pointer to symbol representing this symbol's type       */
+/*            (can be NULL)                                           */
+/*    value - the symbol's value (not used for type symbols)          */
+/* Returns:                                                           */
+/*     SymbolDef * - Pointer to newly allocated structure             */
+/**********************************************************************/
+SymbolDef *SymbolAllocate(char        *id,
+                          SymbolKind kind,
+                          SymbolDef *type,
+                          long      value)
+{
+  SymbolDef *symbolPtr = obstack_alloc(&symbolStack,sizeof(SymbolDef));
+
+  symbolPtr->id           = id;
+  symbolPtr->next         = NULL;
+  symbolPtr->value.value  = value;
+  symbolPtr->value.kind   = kind;
+  symbolPtr->value.type   = check(type);
+  symbolPtr->derived      = NULL;
+  symbolPtr->redefineable = false;
+
+  return check(symbolPtr);
 }
 
 /**********************************************************************/
@@ -213,7 +502,7 @@ int SymbolHashCode(char *id)
 /*   Allocate and initialize symbol structure                         */ 
 /*--------------------------------------------------------------------*/
 /* Parameters:                                                        */
-/*       id - pointer to symbol name                                  */
+/*       id - pointer to symbol name (can be NULL)                    */
 /*     kind - kind spec of symbol                                     */
 /*     type - pointer to symbol representing this symbol's type       */
 /*            (can be NULL)                                           */
@@ -226,27 +515,91 @@ SymbolDef * SymbolFactory(char        *id,
                           SymbolDef *type,
                           long      value)
 {
-  SymbolDef *symbolPtr = xmalloc(sizeof(SymbolDef));
-
-  if (id && strcmp("DmNewHandle",id)==0)
-    breakpoint();
+  return SymbolAllocate(id ? SymbolIntern(id)->id : NULL,kind,type,value);
+}
 
-  if (symbolPtr)
+/**********************************************************************/
+/* Routine: SymbolRedefine                                            */
+/*   checking and updating an existing symbol that is being created   */
+/*   again (on a later pass or by a later statement)                  */
+/*--------------------------------------------------------------------*/
+/* Parameters:                                                        */
+/* symbolPtr - pointer to the existing symbol                         */
+/*       id - pointer to symbol name                                  */
+/*     kind - kind spec of symbol                                     */
+/*     type - pointer to symbol representing this symbol's type       */
+/*            (can be NULL)                                           */
+/*    value - the symbol's value (not used for type symbols)          */
+/* Returns:                                                           */
+/*     pointer to the symbol (or an unconnected dummy on error)       */
+/**********************************************************************/
+SymbolDef *SymbolRedefine(SymbolDef *symbolPtr,
+                          char            *id,
+                          SymbolKind     kind,
+                          SymbolDef     *type,
+                          long          value)
+{
+  if (kind==symbolKindProcDef || 	// any symbol that might have been created
+      kind==symbolKindProcEntry ||	// implicitly by a referencing call statement?
+      kind==symbolKindProxyEntry ||
+      kind==symbolKindTrapDef)
   {
-    if (id!=NULL)
-      symbolPtr->id = xstrdup(id);
+    SymbolKind symKind = symbolPtr->value.kind;
+    if (((kind==symbolKindProcDef || kind==symbolKindProcEntry)
+           && symKind!=symbolKindProcDef && symKind!=symbolKindProcEntry
+        ) ||
+        ((kind==symbolKindProxyEntry || kind==symbolKindTrapDef)
+           && symKind!=kind && symKind!=symbolKindProcDef
+        )
+       )
+    {
+      Error(KIND_DIFFERENT,id);
+      symbolPtr = SymbolFactory(id,kind,type,value); // return dummy, unconnected symbol
+    }
     else
-      symbolPtr->id = NULL;
+    {
+      if (giPass==2 && type && symbolPtr->value.type!=type)
+        Error(PHASE_ERROR,id);
+        
+      if (kind==symbolKindProcEntry || kind==symbolKindProxyEntry)
+      {
+        if (symbolPtr->value.value!=value)
+        {
+          if (giPass==2)
+            Error(PHASE_ERROR,id);
+          symbolChangeCount++;
+        }
+        symbolPtr->value.value = value;
+        symbolPtr->value.kind = kind;
+      }
       
-    symbolPtr->next         = NULL;
-    symbolPtr->value.value  = value;
-    symbolPtr->value.kind   = kind;
-    symbolPtr->value.type         = check(type);
-    symbolPtr->derived      = NULL;
-    symbolPtr->redefineable = false;
+      if (type)
+        symbolPtr->value.type = type;
+    }
   }
-    
-  return check(symbolPtr);
+  else if (symbolPtr->value.kind!=kind) // using the same id for two different symbol kinds?
+  {
+    Error(KIND_DIFFERENT,id);
+    symbolPtr = SymbolFactory(id,kind,type,value); // return dummy, unconnected symbol
+  }
+  else
+  {
+    if (!symbolPtr->redefineable &&
+        (symbolPtr->value.value!=value || (type && symbolPtr->value.type!=type)))
+    {
+      if (giPass==2)
+        Error(PHASE_ERROR,id);
+      symbolChangeCount++;
+      if (SymbolGetCategory(kind)==symbolCategoryConst ||
+          SymbolGetCategory(kind)==symbolCategoryType)
+        symbolConstStamp++;
+    }
+      
+    symbolPtr->value.value = value;
+    if (type)
+      symbolPtr->value.type = type;
+  }
+  return symbolPtr;
 }
 
 /**********************************************************************/
@@ -255,7 +608,6 @@ SymbolDef * SymbolFactory(char        *id,
 /*--------------------------------------------------------------------*/
 /* Parameters:                                                        */
 /*  listPtr - pointer to first symbol of list to add to               */
-/*   sorted - true if the list is sorted by symbol name               */
 /*       id - pointer to symbol name                                  */
 /*     kind - kind spec of symbol                                     */
 /*     type - pointer to symbol representing this symbol's type       */
@@ -265,25 +617,22 @@ SymbolDef * SymbolFactory(char        *id,
 /*     pointer to newly created symbol                                */
 /**********************************************************************/
 SymbolDef *SymbolAdd(SymbolDef **listPtr,
-                     boolean      sorted,
                      char            *id,
                      SymbolKind     kind,
                      SymbolDef     *type,
                      long          value)
 {
-  int cmp;
   SymbolDef *symbolPtr  = NULL;
   SymbolDef *lastSymbol = (SymbolDef *)listPtr; // THIS IS WHY NEXT MUST BE FIRST ENTRY IN SymbolDef!!!
   SymbolDef *listSymbol = check(*listPtr);
 
-  // now go off and look for the string pointed to by id as the symbol id
-  cmp = -1;
-  while (listSymbol && !symbolPtr && (!sorted || cmp<0))
+  // now go off and look for the symbol with the (interned) id
+  id = SymbolIntern(id)->id;
+  while (listSymbol && !symbolPtr)
   {
-    cmp = strcmp(listSymbol->id,id);
-    if (cmp==0)
+    if (listSymbol->id==id)
       symbolPtr = listSymbol;
-    else if (cmp<0 || !sorted)
+    else
     {
       lastSymbol = listSymbol;
       listSymbol = listSymbol->next;
@@ -291,62 +640,13 @@ SymbolDef *SymbolAdd(SymbolDef **listPtr,
   }
   
   if (symbolPtr)
-  {
-    if (kind==symbolKindProcDef || 	// any symbol that might have been created
-        kind==symbolKindProcEntry ||	// implicitly by a referencing call statement?
-        kind==symbolKindProxyEntry ||
-        kind==symbolKindTrapDef)
-    {
-      SymbolKind symKind = symbolPtr->value.kind;
-      if (((kind==symbolKindProcDef || kind==symbolKindProcEntry)
-             && symKind!=symbolKindProcDef && symKind!=symbolKindProcEntry
-          ) ||
-          ((kind==symbolKindProxyEntry || kind==symbolKindTrapDef)
-             && symKind!=kind && symKind!=symbolKindProcDef
-          )
-         )
-      {
-        Error(KIND_DIFFERENT,id);
-        symbolPtr = SymbolFactory(id,kind,type,value); // return dummy, unconnected symbol
-      }
-      else
-      {
-        if (giPass==2 && type && symbolPtr->value.type!=type)
-          Error(PHASE_ERROR,id);
-          
-        if (kind==symbolKindProcEntry || kind==symbolKindProxyEntry)
-        {
-          if (giPass==2 && symbolPtr->value.value!=value)
-            Error(PHASE_ERROR,id);
-          symbolPtr->value.value = value;
-          symbolPtr->value.kind = kind;
-        }
-        
-        if (type)
-          symbolPtr->value.type = type;
-      }
-    }
-    else if (symbolPtr->value.kind!=kind) // using the same id for two different symbol kinds?
-    {
-      Error(KIND_DIFFERENT,id);
-      symbolPtr = SymbolFactory(id,kind,type,value); // return dummy, unconnected symbol
-    }
-    else
-    {
-      if (giPass==2 && !symbolPtr->redefineable &&
-          (symbolPtr->value.value!=value || (type && symbolPtr->value.type!=type)))
-        Error(PHASE_ERROR,id);
-        
-      symbolPtr->value.value = value;
-      if (type)
-        symbolPtr->value.type = type;
-    }
-  }
+    symbolPtr = SymbolRedefine(symbolPtr,id,kind,type,value);
   else
   {
-    symbolPtr = SymbolFactory(id,kind,type,value);
+    symbolPtr = SymbolAllocate(id,kind,type,value);
     symbolPtr->next  = lastSymbol->next;
     lastSymbol->next = symbolPtr;
+    symbolScopeStamp++;
   }
   return symbolPtr;
 }
@@ -376,6 +676,7 @@ SymbolDef *SymbolCreateScopeProc(char         *id,
 
   if (symbolCurrentProcedure)
   {
+    id = SymbolIntern(id)->id;
     symbolPtr = symbolCurrentProcedure->value.type->next; // ptr to first of proc-member-symbols
     switch (kind)
     {
@@ -392,7 +693,7 @@ SymbolDef *SymbolCreateScopeProc(char         *id,
         if (check(type))
         {
           min = 0;
-          while (symbolPtr && strcmp(symbolPtr->id,id)!=0)
+          while (symbolPtr && symbolPtr->id!=id)
           {
             if (symbolPtr->value.kind==symbolKindProcLocal && symbolPtr->value.value<min)
               min = symbolPtr->value.value;
@@ -411,7 +712,7 @@ SymbolDef *SymbolCreateScopeProc(char         *id,
         
       case symbolKindRegList:
         symbolPtr = symbolCurrentProcedure->value.type;
-        symbolPtr->id = xstrdup(id);
+        symbolPtr->id = id;
         createSymbol = false;
         break;
       default:
@@ -421,7 +722,7 @@ SymbolDef *SymbolCreateScopeProc(char         *id,
     }
     
     if (createSymbol)
-      symbolPtr = SymbolAdd((SymbolDef **)(symbolCurrentProcedure->value.type),false,id,kind,type,value);
+      symbolPtr = SymbolAdd((SymbolDef **)(symbolCurrentProcedure->value.type),id,kind,type,value);
     else
       symbolPtr = NULL;
   }
@@ -478,13 +779,7 @@ SymbolDef *SymbolCreateParameter(SymbolDef *parmList,
     if (kind==symbolKindProcEntry || kind==symbolKindProxyEntry)
     {
       // update parameter names of symbols possibly created implicitly by call directive or via procdef
-      if (symbolPtr->id==NULL)
-        symbolPtr->id = xstrdup(id);
-      else if (strcmp(symbolPtr->id,id)!=0)
-      {
-        free(symbolPtr->id);
-        symbolPtr->id = xstrdup(id);
-      }
+      symbolPtr->id = SymbolIntern(id)->id;
     }
     if (giPass==2 && (symbolPtr->value.value!=value || symbolPtr->value.type!=type))
       Error(PHASE_ERROR,id);
@@ -503,7 +798,7 @@ SymbolDef *SymbolCreateParameter(SymbolDef *parmList,
         parmList->value.value++;
     }
       
-    return SymbolAdd((SymbolDef **)(parmList),false,id,symbolKindProcParm,type,value);
+    return SymbolAdd((SymbolDef **)(parmList),id,symbolKindProcParm,type,value);
   }
 }
 
@@ -538,7 +833,7 @@ SymbolDef *SymbolCreateDerivedType(SymbolDef *baseType,
     return NULL;
   }
 
-  return SymbolAdd(&(baseType->derived),false,typeId,kind,baseType,value);
+  return SymbolAdd(&(baseType->derived),typeId,kind,baseType,value);
 }
 
 
@@ -560,6 +855,9 @@ SymbolDef *SymbolCreate(char          *id,
                         SymbolDef   *type,
                         long        value)
 {
+  SymbolName *name = SymbolIntern(id);
+
+  id = name->id;
   if (kind==symbolKindLabel)
   {
     switch (gbt)
@@ -572,16 +870,20 @@ SymbolDef *SymbolCreate(char          *id,
   
   if (symbolCurrentProcedure &&
       ((SymbolGetCategory(kind)==symbolCategoryCode && 
-        strcmp(id,symbolCurrentProcedure->id)!=0) ||
+        id!=symbolCurrentProcedure->id) ||
        kind==symbolKindRegList
      ))
   {
     return SymbolCreateScopeProc(id,kind,check(type),value);
   }
+  else if (name->global)
+  {
+    return SymbolRedefine(name->global,id,kind,check(type),value);
+  }
   else
   {
-    int hash = SymbolHashCode(id);
-    return SymbolAdd(&symbolHashTable[hash],true,id,kind,check(type),value);
+    symbolGlobalCount++;
+    return name->global = SymbolAllocate(id,kind,check(type),value);
   }
 }
 
@@ -607,6 +909,7 @@ SymbolDef *SymbolCreateTypeMember(SymbolDef *target,
                                  )
 {
   int first = 1;
+  boolean created = false;
   SymbolKind targetKind = target->value.kind;
   SymbolDef *symbolPtr  = NULL;
   SymbolDef *lastSymbol = NULL;
@@ -631,11 +934,12 @@ SymbolDef *SymbolCreateTypeMember(SymbolDef *target,
   {
     listSymbol = lastSymbol->next;
     
-    // now go off and look for the string pointed to by id as the symbol id
+    // now go off and look for the symbol with the (interned) id
+    id = SymbolIntern(id)->id;
     while (listSymbol && !symbolPtr)
     {
       first = 0;
-      if (strcmp(listSymbol->id,id)==0)
+      if (listSymbol->id==id)
         symbolPtr = listSymbol;
       else
       {
@@ -649,12 +953,15 @@ SymbolDef *SymbolCreateTypeMember(SymbolDef *target,
       symbolPtr = SymbolFactory(id,symbolKindConst,type,value);
       symbolPtr->next  = lastSymbol->next;
       lastSymbol->next = symbolPtr;
+      created = true;
     }
     else
     {
       if (giPass==0)
         Error(MULTIPLE_DEFS,id);
       // symbol exists already... but it's type may have changed
+      if (symbolPtr->value.type!=type)
+        symbolConstStamp++;
       symbolPtr->value.type = type;
     }
     
@@ -694,8 +1001,12 @@ SymbolDef *SymbolCreateTypeMember(SymbolDef *target,
     else if (targetKind==symbolKindTypeUnion)
       value = 0; // in a union each member has offset 0
       
-    if (giPass==2 && symbolPtr->value.value!=value)
-      Error(PHASE_ERROR,id);
+    if (!created && symbolPtr->value.value!=value)
+    {
+      if (giPass==2)
+        Error(PHASE_ERROR,id);
+      symbolConstStamp++;
+    }
 
     symbolPtr->value.value = value;
   }
@@ -712,24 +1023,24 @@ SymbolDef *SymbolCreateTypeMember(SymbolDef *target,
 /*--------------------------------------------------------------------*/
 /* Parameters:                                                        */
 /*    first - pointer to first symbol in list                         */
-/*   sorted - true if list is sorted, false otherwise                 */
 /*       id - pointer to symbol name                                  */
 /* Returns:                                                           */
 /*     pointer to symbol if found, NULL otherwise                     */
 /**********************************************************************/
-SymbolDef *SymbolRetrieveFromList(SymbolDef *first, boolean sorted, char *id)
+SymbolDef *SymbolRetrieveFromList(SymbolDef *first, char *id)
 {
-  int cmp;
   SymbolDef *symbolPtr = NULL;
 
-  // now go off and look for the string pointed to by id as the symbol id
+  // an id that was never interned can't be the id of any symbol
+  id = SymbolFindId(id);
+  if (!id)
+    return NULL;
+
+  // now go off and look for the symbol with the (interned) id
   while (check(first) && !symbolPtr)
   {
-    cmp = strcmp(first->id,id);
-    if (cmp==0)
+    if (first->id==id)
       symbolPtr = first;
-    else if (cmp>0 && sorted)
-      first = NULL;
     else
       first = first->next;
   }
@@ -785,7 +1096,7 @@ SymbolDef *SymbolLookupScopeSymbol(SymbolDef *symbol, char *id)
         kind==symbolKindTypeBitmapMember ||
         kind==symbolKindTypeMemberList)
     {
-      return SymbolRetrieveFromList(symbol->next,false,id);
+      return SymbolRetrieveFromList(symbol->next,id);
     }
   }
   return NULL;
@@ -818,8 +1129,92 @@ SymbolDef *SymbolLookupScopeProc(char *id)
 /**********************************************************************/
 SymbolDef *SymbolLookup(char *id)
 {
-  // retrieve the symbol from the according hash-entry list
-  return SymbolRetrieveFromList(symbolHashTable[SymbolHashCode(id)],true,id);
+  // retrieve the symbol from the id's hash table entry
+  SymbolName *name = *SymbolHashSlot(id,SymbolHashCode(id));
+
+  if (symbolRecordMisses && (!name || !name->global))
+  {
+    if (!name)
+      name = SymbolIntern(id);
+    name->missed = true;
+  }
+  return name ? check(name->global) : NULL;
+}
+
+/**********************************************************************/
+/* Routine: SymbolRecordMisses                                        */
+/*   Switching on (or off) remembering the ids SymbolLookup could not */
+/*   find. SymbolForEachId reports them as missed.                    */
+/*--------------------------------------------------------------------*/
+/* Parameters:                                                        */
+/*   record - true to start remembering                               */
+/* Returns:                                                           */
+/*     void                                                           */
+/**********************************************************************/
+void SymbolRecordMisses(boolean record)
+{
+  symbolRecordMisses = record;
+}
+
+/**********************************************************************/
+/* Routine: SymbolForEachId                                           */
+/*   Calling a function for every interned id                         */
+/*--------------------------------------------------------------------*/
+/* Parameters:                                                        */
+/*   fn   - function getting the id, its global symbol (NULL if none) */
+/*          and whether SymbolLookup ever failed to find it           */
+/*   data - passed through to fn                                      */
+/* Returns:                                                           */
+/*     void                                                           */
+/**********************************************************************/
+void SymbolForEachId(void (*fn)(char *id, SymbolDef *global, boolean missed, void *data),
+                     void *data)
+{
+  unsigned long i;
+
+  for (i=0; i<symbolHashSize; i++)
+    if (symbolHashTable[i])
+      fn(symbolHashTable[i]->id,symbolHashTable[i]->global,symbolHashTable[i]->missed,data);
+}
+
+/**********************************************************************/
+/* Routine: SymbolIsPredefined                                        */
+/*   Telling if a symbol is one of the types SymbolInitialize creates */
+/*--------------------------------------------------------------------*/
+/* Parameters:                                                        */
+/*   symbol - pointer to symbol definition                            */
+/* Returns:                                                           */
+/*     true if symbol is predefined                                   */
+/**********************************************************************/
+boolean SymbolIsPredefined(SymbolDef *symbol)
+{
+  int i;
+
+  for (i=0; i<SYMBOL_PREDEFINED_COUNT; i++)
+    if (symbolPredefined[i]==symbol)
+      return true;
+  return false;
+}
+
+/**********************************************************************/
+/* Routine: SymbolInstallGlobal                                       */
+/*   Making a symbol built by SymbolFactory the global symbol of its  */
+/*   id (used when loading a precompiled include)                     */
+/*--------------------------------------------------------------------*/
+/* Parameters:                                                        */
+/*   symbol - pointer to symbol definition                            */
+/* Returns:                                                           */
+/*     false if there is a global symbol with that id already         */
+/**********************************************************************/
+boolean SymbolInstallGlobal(SymbolDef *symbol)
+{
+  SymbolName *name = SymbolIntern(symbol->id);
+
+  if (name->global)
+    return false;
+  symbolGlobalCount++;
+  name->global = symbol;
+  return true;
 }
 
 /**********************************************************************/
@@ -1071,11 +1466,7 @@ SymbolDef *SymbolGetType(SymbolDef *symbol)	// get symbol's type
 /**********************************************************************/
 void SymbolSetType(SymbolDef *symbol,SymbolDef *type)
 {
-  if (check(symbol) && symbol->id && strcmp("DmNewHandle",symbol->id)==0)
-    breakpoint();
   symbol->value.type = check(type);
-  if (check(symbol))
-    ;
 }
 
 /**********************************************************************/
@@ -1122,11 +1513,11 @@ void SymbolSetRedefineable(SymbolDef *symbol)
 SymbolDef *SymbolCreateTempLabel(char tempLabelId)
 {
   char idName[20];
-  if (tempLabelPass!=giPass)
+  if (tempLabelPass!=giPassRun)
   {
     int counter;
     for (counter=0; counter<9; counter++) tempLabelCounter[counter] = 0;
-    tempLabelPass = giPass;
+    tempLabelPass = giPassRun;
   }
   sprintf(idName,":temp:%c:%08lX",tempLabelId,(long)(++(tempLabelCounter[tempLabelId-'1'])));
   return SymbolCreate(idName,symbolKindCode,NULL,gulOutLoc);
@@ -1149,10 +1540,10 @@ SymbolDef *SymbolLookupTempLabel(char tempLabelId,char direction)
   int  counter;
   SymbolDef *symbol;
   
-  if (tempLabelPass!=giPass)
+  if (tempLabelPass!=giPassRun)
   {
     for (counter=0; counter<9; counter++) tempLabelCounter[counter] = 0;
-    tempLabelPass = giPass;
+    tempLabelPass = giPassRun;
   }
   
   if (direction=='B')
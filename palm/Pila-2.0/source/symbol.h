@@ -88,8 +88,13 @@ typedef struct _SymbolDef
 } SymbolDef;
 
 void       SymbolInitialize();
+void       SymbolTerminate();
+void       SymbolResetChangeCount();
+long       SymbolGetChangeCount();
+long       SymbolGetChangeStamp();
 SymbolDef *SymbolSetCurrentProc(SymbolDef *proc);
 boolean    SymbolHasCurrentProc();
+SymbolDef *SymbolGetCurrentProc();
 
 SymbolDef *SymbolFactory(char         *id,
                          SymbolKind  kind,
@@ -124,6 +129,13 @@ SymbolDef *SymbolCreateTypeMember(SymbolDef *target,
 SymbolDef     *SymbolLookupScopeSymbol(SymbolDef *symbol, char *id);
 SymbolDef     *SymbolLookupScopeProc(char *id);
 SymbolDef     *SymbolLookup(char *id);
+unsigned long  SymbolHashCode(char *id);
+
+void           SymbolRecordMisses(boolean record);
+void           SymbolForEachId(void (*fn)(char *id, SymbolDef *global, boolean missed, void *data),
+                               void *data);
+boolean        SymbolIsPredefined(SymbolDef *symbol);
+boolean        SymbolInstallGlobal(SymbolDef *symbol);
 
 SymbolDef     *SymbolCreateTempLabel(char id);
 SymbolDef     *SymbolLookupTempLabel(char id,char direction);
@@ -147,4 +159,6 @@ void           SymbolSetRedefineable(SymbolDef *symbol);
 
 /* void           SymbolDestroy(SymbolDef *symbol); */
 
+void           SymbolPrintStatistics(FILE *pfil);
+
 #endif // __SYMBOL3_H__